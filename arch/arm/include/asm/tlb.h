@@ -50,6 +50,10 @@ struct mmu_gather {
 	unsigned int		max;
 	struct page		**pages;
 	struct page		*local[MMU_GATHER_BUNDLE];
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	unsigned int		nr_tables;
+	struct page		*tables[MMU_GATHER_BUNDLE];
+#endif
 };
 
 DECLARE_PER_CPU(struct mmu_gather, mmu_gathers);
@@ -98,11 +102,29 @@ static inline void __tlb_alloc_page(struct mmu_gather *tlb)
 	}
 }
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+extern void tlb_table_free(struct page *page);
+
+static inline void tlb_free_tables(struct mmu_gather *tlb)
+{
+	unsigned int i;
+
+	for (i = 0; i < tlb->nr_tables; i++)
+		tlb_table_free(tlb->tables[i]);
+	tlb->nr_tables = 0;
+}
+#else
+static inline void tlb_free_tables(struct mmu_gather *tlb)
+{
+}
+#endif
+
 static inline void tlb_flush_mmu(struct mmu_gather *tlb)
 {
 	tlb_flush(tlb);
 	free_pages_and_swap_cache(tlb->pages, tlb->nr);
 	tlb->nr = 0;
+	tlb_free_tables(tlb);
 	if (tlb->pages == tlb->local)
 		__tlb_alloc_page(tlb);
 }
@@ -118,6 +140,9 @@ tlb_gather_mmu(struct mmu_gather *tlb, struct mm_struct *mm, unsigned long start
 	tlb->max = ARRAY_SIZE(tlb->local);
 	tlb->pages = tlb->local;
 	tlb->nr = 0;
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	tlb->nr_tables = 0;
+#endif
 	__tlb_alloc_page(tlb);
 }
 
@@ -178,6 +203,24 @@ static inline void tlb_remove_page(struct mmu_gather *tlb, struct page *page)
 		tlb_flush_mmu(tlb);
 }
 
+/*
+ * Page tables go through here.  With speculative page faults they may
+ * still be walked locklessly after the TLB flush, see tlb_table_free();
+ * the exit path has nobody left to fault.
+ */
+static inline void tlb_remove_table(struct mmu_gather *tlb, struct page *page)
+{
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	if (!tlb->fullmm) {
+		tlb->tables[tlb->nr_tables++] = page;
+		if (tlb->nr_tables == ARRAY_SIZE(tlb->tables))
+			tlb_flush_mmu(tlb);
+		return;
+	}
+#endif
+	tlb_remove_page(tlb, page);
+}
+
 static inline void __pte_free_tlb(struct mmu_gather *tlb, pgtable_t pte,
 	unsigned long addr)
 {
@@ -195,7 +238,7 @@ static inline void __pte_free_tlb(struct mmu_gather *tlb, pgtable_t pte,
 	tlb_add_flush(tlb, addr + SZ_1M);
 #endif
 
-	tlb_remove_page(tlb, pte);
+	tlb_remove_table(tlb, pte);
 #ifdef CONFIG_TIMA_RKP_DEBUG
 	/* with debug infrastructure, check if a page was 
 	 * unprotected after being freed. Scream if not.
@@ -215,7 +258,7 @@ static inline void __pmd_free_tlb(struct mmu_gather *tlb, pmd_t *pmdp,
 {
 #ifdef CONFIG_ARM_LPAE
 	tlb_add_flush(tlb, addr);
-	tlb_remove_page(tlb, virt_to_page(pmdp));
+	tlb_remove_table(tlb, virt_to_page(pmdp));
 #endif
 }
 
@@ -10,6 +10,7 @@
 #include <linux/mm.h>
 #include <linux/gfp.h>
 #include <linux/highmem.h>
+#include <linux/rcupdate.h>
 #include <linux/slab.h>
 
 #include <asm/cp15.h>
@@ -187,3 +188,21 @@ no_pgd:
 #endif
 	__pgd_free(pgd_base);
 }
+
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+static void tlb_table_free_rcu(struct rcu_head *head)
+{
+	__free_page(container_of((struct list_head *)head, struct page, lru));
+}
+
+/*
+ * Speculative page faults walk the page tables with interrupts disabled
+ * instead of holding mmap_sem, so a table unhooked by free_pgtables() is
+ * only freed after an RCU-sched grace period.  The TLB no longer refers
+ * to it by the time it gets here.
+ */
+void tlb_table_free(struct page *page)
+{
+	call_rcu_sched((struct rcu_head *)&page->lru, tlb_table_free_rcu);
+}
+#endif
@@ -18,6 +18,7 @@
  */
 
 #include <linux/device.h>
+#include <linux/debugfs.h>
 #include <linux/kallsyms.h>
 #include <linux/export.h>
 #include <linux/mutex.h>
@@ -30,6 +31,8 @@
 #include <linux/suspend.h>
 #include <linux/cpuidle.h>
 #include <linux/timer.h>
+#include <linux/seq_file.h>
+#include <linux/string.h>
 
 #include "../base.h"
 #include "power.h"
@@ -72,6 +75,8 @@ void device_pm_sleep_init(struct device *dev)
 {
 	dev->power.is_prepared = false;
 	dev->power.is_suspended = false;
+	dev->power.is_noirq_suspended = false;
+	dev->power.is_late_suspended = false;
 	init_completion(&dev->power.completion);
 	complete_all(&dev->power.completion);
 	dev->power.wakeup = NULL;
@@ -355,6 +360,164 @@ static void pm_dev_err(struct device *dev, pm_message_t state, char *info,
 		dev_name(dev), pm_verb(state.event), info, error);
 }
 
+/*
+ * Every device callback is timed and the slowest devices of each phase are
+ * kept for the last DPM_SLOW_CYCLES suspend/resume cycles, so that a slow
+ * driver can be found without booting with initcall_debug.  A new cycle
+ * starts with dpm_suspend().
+ */
+enum dpm_phase {
+	DPM_PHASE_SUSPEND,
+	DPM_PHASE_SUSPEND_LATE,
+	DPM_PHASE_SUSPEND_NOIRQ,
+	DPM_PHASE_RESUME_NOIRQ,
+	DPM_PHASE_RESUME_EARLY,
+	DPM_PHASE_RESUME,
+	DPM_PHASE_NR,
+};
+
+/* Phase being carried out, only changed with no callbacks in flight. */
+static enum dpm_phase dpm_phase;
+
+#ifdef CONFIG_DEBUG_FS
+
+#define DPM_SLOW_CYCLES	8
+#define DPM_SLOW_DEVS	5
+
+static const char * const dpm_phase_names[DPM_PHASE_NR] = {
+	[DPM_PHASE_SUSPEND]		= "suspend",
+	[DPM_PHASE_SUSPEND_LATE]	= "suspend_late",
+	[DPM_PHASE_SUSPEND_NOIRQ]	= "suspend_noirq",
+	[DPM_PHASE_RESUME_NOIRQ]	= "resume_noirq",
+	[DPM_PHASE_RESUME_EARLY]	= "resume_early",
+	[DPM_PHASE_RESUME]		= "resume",
+};
+
+struct dpm_slow_dev {
+	char		name[32];
+	unsigned long	usecs;
+};
+
+struct dpm_slow_cycle {
+	unsigned long		seq;
+	unsigned long		phase_usecs[DPM_PHASE_NR];
+	/* slowest first */
+	struct dpm_slow_dev	devs[DPM_PHASE_NR][DPM_SLOW_DEVS];
+};
+
+static struct dpm_slow_cycle dpm_slow_log[DPM_SLOW_CYCLES];
+static unsigned long dpm_slow_seq;
+static DEFINE_SPINLOCK(dpm_slow_lock);
+
+static struct dpm_slow_cycle *dpm_slow_slot(unsigned long seq)
+{
+	return &dpm_slow_log[seq % DPM_SLOW_CYCLES];
+}
+
+static void dpm_slow_new_cycle(void)
+{
+	struct dpm_slow_cycle *c;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dpm_slow_lock, flags);
+	c = dpm_slow_slot(++dpm_slow_seq);
+	memset(c, 0, sizeof(*c));
+	c->seq = dpm_slow_seq;
+	spin_unlock_irqrestore(&dpm_slow_lock, flags);
+}
+
+static void dpm_slow_record(struct device *dev, ktime_t starttime)
+{
+	unsigned long usecs = ktime_to_us(ktime_sub(ktime_get(), starttime));
+	struct dpm_slow_dev *devs;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&dpm_slow_lock, flags);
+	devs = dpm_slow_slot(dpm_slow_seq)->devs[dpm_phase];
+	for (i = 0; i < DPM_SLOW_DEVS; i++)
+		if (devs[i].usecs < usecs)
+			break;
+	if (i < DPM_SLOW_DEVS) {
+		memmove(&devs[i + 1], &devs[i],
+			(DPM_SLOW_DEVS - i - 1) * sizeof(*devs));
+		strlcpy(devs[i].name, dev_name(dev), sizeof(devs[i].name));
+		devs[i].usecs = usecs;
+	}
+	spin_unlock_irqrestore(&dpm_slow_lock, flags);
+}
+
+static void dpm_slow_phase_time(unsigned long usecs)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&dpm_slow_lock, flags);
+	dpm_slow_slot(dpm_slow_seq)->phase_usecs[dpm_phase] = usecs;
+	spin_unlock_irqrestore(&dpm_slow_lock, flags);
+}
+
+static int dpm_slow_show(struct seq_file *s, void *unused)
+{
+	struct dpm_slow_cycle *c;
+	struct dpm_slow_dev *d;
+	unsigned long seq;
+	int p, i;
+
+	spin_lock_irq(&dpm_slow_lock);
+	for (seq = dpm_slow_seq;
+	     seq && seq + DPM_SLOW_CYCLES > dpm_slow_seq; seq--) {
+		c = dpm_slow_slot(seq);
+		seq_printf(s, "cycle %lu\n", c->seq);
+		for (p = 0; p < DPM_PHASE_NR; p++) {
+			seq_printf(s, "  %-14s %6lu.%03lu msecs\n",
+				   dpm_phase_names[p],
+				   c->phase_usecs[p] / USEC_PER_MSEC,
+				   c->phase_usecs[p] % USEC_PER_MSEC);
+			for (i = 0; i < DPM_SLOW_DEVS; i++) {
+				d = &c->devs[p][i];
+				if (!d->usecs)
+					break;
+				seq_printf(s, "    %6lu.%03lu msecs  %s\n",
+					   d->usecs / USEC_PER_MSEC,
+					   d->usecs % USEC_PER_MSEC, d->name);
+			}
+		}
+	}
+	spin_unlock_irq(&dpm_slow_lock);
+
+	return 0;
+}
+
+static int dpm_slow_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dpm_slow_show, NULL);
+}
+
+static const struct file_operations dpm_slow_fops = {
+	.owner = THIS_MODULE,
+	.open = dpm_slow_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init dpm_slow_debugfs_init(void)
+{
+	debugfs_create_file("suspend_slowest_devices", S_IRUGO, NULL, NULL,
+			    &dpm_slow_fops);
+	return 0;
+}
+
+postcore_initcall(dpm_slow_debugfs_init);
+
+#else /* !CONFIG_DEBUG_FS */
+
+static inline void dpm_slow_new_cycle(void) {}
+static inline void dpm_slow_record(struct device *dev, ktime_t starttime) {}
+static inline void dpm_slow_phase_time(unsigned long usecs) {}
+
+#endif /* !CONFIG_DEBUG_FS */
+
 static void dpm_show_time(ktime_t starttime, pm_message_t state, char *info)
 {
 	ktime_t calltime;
@@ -367,6 +530,7 @@ static void dpm_show_time(ktime_t starttime, pm_message_t state, char *info)
 	usecs = usecs64;
 	if (usecs == 0)
 		usecs = 1;
+	dpm_slow_phase_time(usecs);
 	pr_info("PM: %s%s%s of devices complete after %ld.%03ld msecs\n",
 		info ?: "", info ? " " : "", pm_verb(state.event),
 		usecs / USEC_PER_MSEC, usecs % USEC_PER_MSEC);
@@ -375,18 +539,20 @@ static void dpm_show_time(ktime_t starttime, pm_message_t state, char *info)
 static int dpm_run_callback(pm_callback_t cb, struct device *dev,
 			    pm_message_t state, char *info)
 {
-	ktime_t calltime;
+	ktime_t calltime, starttime;
 	int error;
 
 	if (!cb)
 		return 0;
 
 	calltime = initcall_debug_start(dev);
+	starttime = ktime_get();
 
 	pm_dev_dbg(dev, state, info);
 	error = cb(dev);
 	suspend_report_result(cb, error);
 
+	dpm_slow_record(dev, starttime);
 	initcall_debug_report(dev, calltime, error);
 
 	return error;
@@ -442,17 +608,25 @@ static void dpm_wd_clear(struct dpm_watchdog *wd)
 	destroy_timer_on_stack(timer);
 }
 
+static bool is_async(struct device *dev)
+{
+	return dev->power.async_suspend && pm_async_enabled
+		&& !pm_trace_is_enabled();
+}
+
 /*------------------------- Resume routines -------------------------*/
 
 /**
  * device_resume_noirq - Execute an "early resume" callback for given device.
  * @dev: Device to handle.
  * @state: PM transition of the system being carried out.
+ * @async: If true, the device is being resumed asynchronously.
  *
  * The driver of @dev will not receive interrupts while this function is being
  * executed.
  */
-static int device_resume_noirq(struct device *dev, pm_message_t state)
+static int device_resume_noirq(struct device *dev, pm_message_t state,
+			       bool async)
 {
 	pm_callback_t callback = NULL;
 	char *info = NULL;
@@ -464,6 +638,11 @@ static int device_resume_noirq(struct device *dev, pm_message_t state)
 	if (dev->power.syscore)
 		goto Out;
 
+	if (!dev->power.is_noirq_suspended)
+		goto Out;
+
+	dpm_wait(dev->parent, async);
+
 	if (dev->pm_domain) {
 		info = "noirq power domain ";
 		callback = pm_noirq_op(&dev->pm_domain->ops, state);
@@ -484,12 +663,26 @@ static int device_resume_noirq(struct device *dev, pm_message_t state)
 	}
 
 	error = dpm_run_callback(callback, dev, state, info);
+	dev->power.is_noirq_suspended = false;
 
  Out:
+	complete_all(&dev->power.completion);
 	TRACE_RESUME(error);
 	return error;
 }
 
+static void async_resume_noirq(void *data, async_cookie_t cookie)
+{
+	struct device *dev = (struct device *)data;
+	int error;
+
+	error = device_resume_noirq(dev, pm_transition, true);
+	if (error)
+		pm_dev_err(dev, pm_transition, " async", error);
+
+	put_device(dev);
+}
+
 /**
  * dpm_resume_noirq - Execute "noirq resume" callbacks for all devices.
  * @state: PM transition of the system being carried out.
@@ -499,29 +692,48 @@ static int device_resume_noirq(struct device *dev, pm_message_t state)
  */
 static void dpm_resume_noirq(pm_message_t state)
 {
+	struct device *dev;
 	ktime_t starttime = ktime_get();
 
 	mutex_lock(&dpm_list_mtx);
-	while (!list_empty(&dpm_noirq_list)) {
-		struct device *dev = to_device(dpm_noirq_list.next);
-		int error;
+	pm_transition = state;
+	dpm_phase = DPM_PHASE_RESUME_NOIRQ;
 
+	/*
+	 * Start the async threads upfront, so that they are not held up
+	 * behind the devices resumed synchronously below.
+	 */
+	list_for_each_entry(dev, &dpm_noirq_list, power.entry) {
+		INIT_COMPLETION(dev->power.completion);
+		if (is_async(dev)) {
+			get_device(dev);
+			async_schedule(async_resume_noirq, dev);
+		}
+	}
+
+	while (!list_empty(&dpm_noirq_list)) {
+		dev = to_device(dpm_noirq_list.next);
 		get_device(dev);
 		list_move_tail(&dev->power.entry, &dpm_late_early_list);
 		mutex_unlock(&dpm_list_mtx);
 
-		error = device_resume_noirq(dev, state);
-		if (error) {
-			suspend_stats.failed_resume_noirq++;
-			dpm_save_failed_step(SUSPEND_RESUME_NOIRQ);
-			dpm_save_failed_dev(dev_name(dev));
-			pm_dev_err(dev, state, " noirq", error);
+		if (!is_async(dev)) {
+			int error;
+
+			error = device_resume_noirq(dev, state, false);
+			if (error) {
+				suspend_stats.failed_resume_noirq++;
+				dpm_save_failed_step(SUSPEND_RESUME_NOIRQ);
+				dpm_save_failed_dev(dev_name(dev));
+				pm_dev_err(dev, state, " noirq", error);
+			}
 		}
 
 		mutex_lock(&dpm_list_mtx);
 		put_device(dev);
 	}
 	mutex_unlock(&dpm_list_mtx);
+	async_synchronize_full();
 	dpm_show_time(starttime, state, "noirq");
 	resume_device_irqs();
 	cpuidle_resume();
@@ -531,10 +743,12 @@ static void dpm_resume_noirq(pm_message_t state)
  * device_resume_early - Execute an "early resume" callback for given device.
  * @dev: Device to handle.
  * @state: PM transition of the system being carried out.
+ * @async: If true, the device is being resumed asynchronously.
  *
  * Runtime PM is disabled for @dev while this function is being executed.
  */
-static int device_resume_early(struct device *dev, pm_message_t state)
+static int device_resume_early(struct device *dev, pm_message_t state,
+			       bool async)
 {
 	pm_callback_t callback = NULL;
 	char *info = NULL;
@@ -546,6 +760,11 @@ static int device_resume_early(struct device *dev, pm_message_t state)
 	if (dev->power.syscore)
 		goto Out;
 
+	if (!dev->power.is_late_suspended)
+		goto Out;
+
+	dpm_wait(dev->parent, async);
+
 	if (dev->pm_domain) {
 		info = "early power domain ";
 		callback = pm_late_early_op(&dev->pm_domain->ops, state);
@@ -566,43 +785,72 @@ static int device_resume_early(struct device *dev, pm_message_t state)
 	}
 
 	error = dpm_run_callback(callback, dev, state, info);
+	dev->power.is_late_suspended = false;
 
  Out:
 	TRACE_RESUME(error);
 
 	pm_runtime_enable(dev);
+	complete_all(&dev->power.completion);
 	return error;
 }
 
+static void async_resume_early(void *data, async_cookie_t cookie)
+{
+	struct device *dev = (struct device *)data;
+	int error;
+
+	error = device_resume_early(dev, pm_transition, true);
+	if (error)
+		pm_dev_err(dev, pm_transition, " async", error);
+
+	put_device(dev);
+}
+
 /**
  * dpm_resume_early - Execute "early resume" callbacks for all devices.
  * @state: PM transition of the system being carried out.
  */
 static void dpm_resume_early(pm_message_t state)
 {
+	struct device *dev;
 	ktime_t starttime = ktime_get();
 
 	mutex_lock(&dpm_list_mtx);
-	while (!list_empty(&dpm_late_early_list)) {
-		struct device *dev = to_device(dpm_late_early_list.next);
-		int error;
+	pm_transition = state;
+	dpm_phase = DPM_PHASE_RESUME_EARLY;
 
+	list_for_each_entry(dev, &dpm_late_early_list, power.entry) {
+		INIT_COMPLETION(dev->power.completion);
+		if (is_async(dev)) {
+			get_device(dev);
+			async_schedule(async_resume_early, dev);
+		}
+	}
+
+	while (!list_empty(&dpm_late_early_list)) {
+		dev = to_device(dpm_late_early_list.next);
 		get_device(dev);
 		list_move_tail(&dev->power.entry, &dpm_suspended_list);
 		mutex_unlock(&dpm_list_mtx);
 
-		error = device_resume_early(dev, state);
-		if (error) {
-			suspend_stats.failed_resume_early++;
-			dpm_save_failed_step(SUSPEND_RESUME_EARLY);
-			dpm_save_failed_dev(dev_name(dev));
-			pm_dev_err(dev, state, " early", error);
+		if (!is_async(dev)) {
+			int error;
+
+			error = device_resume_early(dev, state, false);
+			if (error) {
+				suspend_stats.failed_resume_early++;
+				dpm_save_failed_step(SUSPEND_RESUME_EARLY);
+				dpm_save_failed_dev(dev_name(dev));
+				pm_dev_err(dev, state, " early", error);
+			}
 		}
 
 		mutex_lock(&dpm_list_mtx);
 		put_device(dev);
 	}
 	mutex_unlock(&dpm_list_mtx);
+	async_synchronize_full();
 	dpm_show_time(starttime, state, "early");
 }
 
@@ -717,12 +965,6 @@ static void async_resume(void *data, async_cookie_t cookie)
 	put_device(dev);
 }
 
-static bool is_async(struct device *dev)
-{
-	return dev->power.async_suspend && pm_async_enabled
-		&& !pm_trace_is_enabled();
-}
-
 /**
  * dpm_resume - Execute "resume" callbacks for non-sysdev devices.
  * @state: PM transition of the system being carried out.
@@ -739,6 +981,7 @@ void dpm_resume(pm_message_t state)
 
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
+	dpm_phase = DPM_PHASE_RESUME;
 	async_error = 0;
 
 	list_for_each_entry(dev, &dpm_suspended_list, power.entry) {
@@ -891,20 +1134,33 @@ static pm_message_t resume_event(pm_message_t sleep_state)
 }
 
 /**
- * device_suspend_noirq - Execute a "late suspend" callback for given device.
+ * __device_suspend_noirq - Execute a "late suspend" callback for given device.
  * @dev: Device to handle.
  * @state: PM transition of the system being carried out.
+ * @async: If true, the device is being suspended asynchronously.
  *
  * The driver of @dev will not receive interrupts while this function is being
  * executed.
  */
-static int device_suspend_noirq(struct device *dev, pm_message_t state)
+static int __device_suspend_noirq(struct device *dev, pm_message_t state,
+				  bool async)
 {
 	pm_callback_t callback = NULL;
 	char *info = NULL;
+	int error = 0;
+
+	dpm_wait_for_children(dev, async);
+
+	if (async_error)
+		goto Complete;
+
+	if (pm_wakeup_pending()) {
+		async_error = -EBUSY;
+		goto Complete;
+	}
 
 	if (dev->power.syscore)
-		return 0;
+		goto Complete;
 
 	if (dev->pm_domain) {
 		info = "noirq power domain ";
@@ -925,7 +1181,42 @@ static int device_suspend_noirq(struct device *dev, pm_message_t state)
 		callback = pm_noirq_op(dev->driver->pm, state);
 	}
 
-	return dpm_run_callback(callback, dev, state, info);
+	error = dpm_run_callback(callback, dev, state, info);
+	if (error)
+		async_error = error;
+	else
+		dev->power.is_noirq_suspended = true;
+
+ Complete:
+	complete_all(&dev->power.completion);
+	return error;
+}
+
+static void async_suspend_noirq(void *data, async_cookie_t cookie)
+{
+	struct device *dev = (struct device *)data;
+	int error;
+
+	error = __device_suspend_noirq(dev, pm_transition, true);
+	if (error) {
+		dpm_save_failed_dev(dev_name(dev));
+		pm_dev_err(dev, pm_transition, " async", error);
+	}
+
+	put_device(dev);
+}
+
+static int device_suspend_noirq(struct device *dev)
+{
+	INIT_COMPLETION(dev->power.completion);
+
+	if (is_async(dev)) {
+		get_device(dev);
+		async_schedule(async_suspend_noirq, dev);
+		return 0;
+	}
+
+	return __device_suspend_noirq(dev, pm_transition, false);
 }
 
 /**
@@ -943,19 +1234,20 @@ static int dpm_suspend_noirq(pm_message_t state)
 	cpuidle_pause();
 	suspend_device_irqs();
 	mutex_lock(&dpm_list_mtx);
+	pm_transition = state;
+	dpm_phase = DPM_PHASE_SUSPEND_NOIRQ;
+	async_error = 0;
 	while (!list_empty(&dpm_late_early_list)) {
 		struct device *dev = to_device(dpm_late_early_list.prev);
 
 		get_device(dev);
 		mutex_unlock(&dpm_list_mtx);
 
-		error = device_suspend_noirq(dev, state);
+		error = device_suspend_noirq(dev);
 
 		mutex_lock(&dpm_list_mtx);
 		if (error) {
 			pm_dev_err(dev, state, " noirq", error);
-			suspend_stats.failed_suspend_noirq++;
-			dpm_save_failed_step(SUSPEND_SUSPEND_NOIRQ);
 			dpm_save_failed_dev(dev_name(dev));
 			put_device(dev);
 			break;
@@ -964,27 +1256,33 @@ static int dpm_suspend_noirq(pm_message_t state)
 			list_move(&dev->power.entry, &dpm_noirq_list);
 		put_device(dev);
 
-		if (pm_wakeup_pending()) {
-			error = -EBUSY;
+		if (async_error)
 			break;
-		}
 	}
 	mutex_unlock(&dpm_list_mtx);
-	if (error)
+	async_synchronize_full();
+	if (!error)
+		error = async_error;
+	if (error) {
+		suspend_stats.failed_suspend_noirq++;
+		dpm_save_failed_step(SUSPEND_SUSPEND_NOIRQ);
 		dpm_resume_noirq(resume_event(state));
-	else
+	} else {
 		dpm_show_time(starttime, state, "noirq");
+	}
 	return error;
 }
 
 /**
- * device_suspend_late - Execute a "late suspend" callback for given device.
+ * __device_suspend_late - Execute a "late suspend" callback for given device.
  * @dev: Device to handle.
  * @state: PM transition of the system being carried out.
+ * @async: If true, the device is being suspended asynchronously.
  *
  * Runtime PM is disabled for @dev while this function is being executed.
  */
-static int device_suspend_late(struct device *dev, pm_message_t state)
+static int __device_suspend_late(struct device *dev, pm_message_t state,
+				 bool async)
 {
 	pm_callback_t callback = NULL;
 	char *info = NULL;
@@ -992,8 +1290,18 @@ static int device_suspend_late(struct device *dev, pm_message_t state)
 
 	__pm_runtime_disable(dev, false);
 
+	dpm_wait_for_children(dev, async);
+
+	if (async_error)
+		goto Complete;
+
+	if (pm_wakeup_pending()) {
+		async_error = -EBUSY;
+		goto Complete;
+	}
+
 	if (dev->power.syscore)
-		return 0;
+		goto Complete;
 
 	if (dev->pm_domain) {
 		info = "late power domain ";
@@ -1016,11 +1324,42 @@ static int device_suspend_late(struct device *dev, pm_message_t state)
 
 	error = dpm_run_callback(callback, dev, state, info);
 	if (error)
-		pm_runtime_enable(dev);
+		async_error = error;
+	else
+		dev->power.is_late_suspended = true;
 
+ Complete:
+	complete_all(&dev->power.completion);
 	return error;
 }
 
+static void async_suspend_late(void *data, async_cookie_t cookie)
+{
+	struct device *dev = (struct device *)data;
+	int error;
+
+	error = __device_suspend_late(dev, pm_transition, true);
+	if (error) {
+		dpm_save_failed_dev(dev_name(dev));
+		pm_dev_err(dev, pm_transition, " async", error);
+	}
+
+	put_device(dev);
+}
+
+static int device_suspend_late(struct device *dev)
+{
+	INIT_COMPLETION(dev->power.completion);
+
+	if (is_async(dev)) {
+		get_device(dev);
+		async_schedule(async_suspend_late, dev);
+		return 0;
+	}
+
+	return __device_suspend_late(dev, pm_transition, false);
+}
+
 /**
  * dpm_suspend_late - Execute "late suspend" callbacks for all devices.
  * @state: PM transition of the system being carried out.
@@ -1031,20 +1370,23 @@ static int dpm_suspend_late(pm_message_t state)
 	int error = 0;
 
 	mutex_lock(&dpm_list_mtx);
+	pm_transition = state;
+	dpm_phase = DPM_PHASE_SUSPEND_LATE;
+	async_error = 0;
 	while (!list_empty(&dpm_suspended_list)) {
 		struct device *dev = to_device(dpm_suspended_list.prev);
 
 		get_device(dev);
 		mutex_unlock(&dpm_list_mtx);
 
-		error = device_suspend_late(dev, state);
+		error = device_suspend_late(dev);
 
 		mutex_lock(&dpm_list_mtx);
 		if (error) {
 			pm_dev_err(dev, state, " late", error);
-			suspend_stats.failed_suspend_late++;
-			dpm_save_failed_step(SUSPEND_SUSPEND_LATE);
 			dpm_save_failed_dev(dev_name(dev));
+			/* not on dpm_late_early_list, so not resumed early */
+			pm_runtime_enable(dev);
 			put_device(dev);
 			break;
 		}
@@ -1052,16 +1394,20 @@ static int dpm_suspend_late(pm_message_t state)
 			list_move(&dev->power.entry, &dpm_late_early_list);
 		put_device(dev);
 
-		if (pm_wakeup_pending()) {
-			error = -EBUSY;
+		if (async_error)
 			break;
-		}
 	}
 	mutex_unlock(&dpm_list_mtx);
-	if (error)
+	async_synchronize_full();
+	if (!error)
+		error = async_error;
+	if (error) {
+		suspend_stats.failed_suspend_late++;
+		dpm_save_failed_step(SUSPEND_SUSPEND_LATE);
 		dpm_resume_early(resume_event(state));
-	else
+	} else {
 		dpm_show_time(starttime, state, "late");
+	}
 
 	return error;
 }
@@ -1096,13 +1442,15 @@ static int legacy_suspend(struct device *dev, pm_message_t state,
 			  int (*cb)(struct device *dev, pm_message_t state))
 {
 	int error;
-	ktime_t calltime;
+	ktime_t calltime, starttime;
 
 	calltime = initcall_debug_start(dev);
+	starttime = ktime_get();
 
 	error = cb(dev, state);
 	suspend_report_result(cb, error);
 
+	dpm_slow_record(dev, starttime);
 	initcall_debug_report(dev, calltime, error);
 
 	return error;
@@ -1248,8 +1596,11 @@ int dpm_suspend(pm_message_t state)
 
 	might_sleep();
 
+	dpm_slow_new_cycle();
+
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
+	dpm_phase = DPM_PHASE_SUSPEND;
 	async_error = 0;
 	while (!list_empty(&dpm_prepared_list)) {
 		struct device *dev = to_device(dpm_prepared_list.prev);
@@ -14,6 +14,9 @@
 #include <linux/suspend.h>
 #include <linux/seq_file.h>
 #include <linux/debugfs.h>
+#include <linux/log2.h>
+#include <linux/user_namespace.h>
+#include <linux/wakeup_stats.h>
 #include <trace/events/power.h>
 #include <linux/moduleparam.h>
 
@@ -139,6 +142,7 @@ void wakeup_source_add(struct wakeup_source *ws)
 		return;
 
 	spin_lock_init(&ws->lock);
+	seqcount_init(&ws->seq);
 	setup_timer(&ws->timer, pm_wakeup_timer_fn, (unsigned long)ws);
 	ws->active = false;
 	ws->last_time = ktime_get();
@@ -445,11 +449,13 @@ void __pm_stay_awake(struct wakeup_source *ws)
 		return;
 
 	spin_lock_irqsave(&ws->lock, flags);
+	write_seqcount_begin(&ws->seq);
 
 	wakeup_source_report_event(ws);
 	del_timer(&ws->timer);
 	ws->timer_expires = 0;
 
+	write_seqcount_end(&ws->seq);
 	spin_unlock_irqrestore(&ws->lock, flags);
 }
 EXPORT_SYMBOL_GPL(__pm_stay_awake);
@@ -489,6 +495,17 @@ static inline void update_prevent_sleep_time(struct wakeup_source *ws,
 					     ktime_t now) {}
 #endif
 
+static void update_hold_hist(struct wakeup_source *ws, ktime_t duration)
+{
+	s64 msecs = ktime_to_ms(duration);
+	int bucket = 0;
+
+	if (msecs > 0)
+		bucket = min_t(int, ilog2(msecs) + 1,
+			       WAKEUP_STATS_HIST_BUCKETS - 1);
+	ws->hold_hist[bucket]++;
+}
+
 /**
  * wakup_source_deactivate - Mark given wakeup source as inactive.
  * @ws: Wakeup source to handle.
@@ -525,6 +542,7 @@ static void wakeup_source_deactivate(struct wakeup_source *ws)
 	ws->total_time = ktime_add(ws->total_time, duration);
 	if (ktime_to_ns(duration) > ktime_to_ns(ws->max_time))
 		ws->max_time = duration;
+	update_hold_hist(ws, duration);
 
 	ws->last_time = now;
 	del_timer(&ws->timer);
@@ -562,8 +580,11 @@ void __pm_relax(struct wakeup_source *ws)
 		return;
 
 	spin_lock_irqsave(&ws->lock, flags);
-	if (ws->active)
+	if (ws->active) {
+		write_seqcount_begin(&ws->seq);
 		wakeup_source_deactivate(ws);
+		write_seqcount_end(&ws->seq);
+	}
 	spin_unlock_irqrestore(&ws->lock, flags);
 }
 EXPORT_SYMBOL_GPL(__pm_relax);
@@ -604,8 +625,10 @@ static void pm_wakeup_timer_fn(unsigned long data)
 
 	if (ws->active && ws->timer_expires
 	    && time_after_eq(jiffies, ws->timer_expires)) {
+		write_seqcount_begin(&ws->seq);
 		wakeup_source_deactivate(ws);
 		ws->expire_count++;
+		write_seqcount_end(&ws->seq);
 	}
 
 	spin_unlock_irqrestore(&ws->lock, flags);
@@ -632,6 +655,7 @@ void __pm_wakeup_event(struct wakeup_source *ws, unsigned int msec)
 		return;
 
 	spin_lock_irqsave(&ws->lock, flags);
+	write_seqcount_begin(&ws->seq);
 
 	wakeup_source_report_event(ws);
 
@@ -650,6 +674,7 @@ void __pm_wakeup_event(struct wakeup_source *ws, unsigned int msec)
 	}
 
  unlock:
+	write_seqcount_end(&ws->seq);
 	spin_unlock_irqrestore(&ws->lock, flags);
 }
 EXPORT_SYMBOL_GPL(__pm_wakeup_event);
@@ -804,6 +829,7 @@ void pm_wakep_autosleep_enabled(bool set)
 	rcu_read_lock();
 	list_for_each_entry_rcu(ws, &wakeup_sources, entry) {
 		spin_lock_irq(&ws->lock);
+		write_seqcount_begin(&ws->seq);
 		if (ws->autosleep_enabled != set) {
 			ws->autosleep_enabled = set;
 			if (ws->active) {
@@ -813,6 +839,7 @@ void pm_wakep_autosleep_enabled(bool set)
 					update_prevent_sleep_time(ws, now);
 			}
 		}
+		write_seqcount_end(&ws->seq);
 		spin_unlock_irq(&ws->lock);
 	}
 	rcu_read_unlock();
@@ -821,54 +848,87 @@ void pm_wakep_autosleep_enabled(bool set)
 
 static struct dentry *wakeup_sources_stats_dentry;
 
-/**
- * print_wakeup_source_stats - Print wakeup source statistics information.
- * @m: seq_file to print the statistics into.
- * @ws: Wakeup source object to print the statistics for.
- */
-static int print_wakeup_source_stats(struct seq_file *m,
-				     struct wakeup_source *ws)
-{
-	unsigned long flags;
+/* A consistent copy of the statistics of a wakeup source. */
+struct wakeup_source_stats {
 	ktime_t total_time;
 	ktime_t max_time;
-	unsigned long active_count;
+	ktime_t last_time;
 	ktime_t active_time;
 	ktime_t prevent_sleep_time;
-	int ret;
-
-	spin_lock_irqsave(&ws->lock, flags);
+	unsigned long event_count;
+	unsigned long active_count;
+	unsigned long wakeup_count;
+	unsigned long expire_count;
+	unsigned long hold_hist[WAKEUP_STATS_HIST_BUCKETS];
+	bool active;
+};
 
-	total_time = ws->total_time;
-	max_time = ws->max_time;
-	prevent_sleep_time = ws->prevent_sleep_time;
-	active_count = ws->active_count;
-	if (ws->active) {
+/**
+ * wakeup_source_get_stats - Take a snapshot of wakeup source statistics.
+ * @ws: Wakeup source object to read the statistics of.
+ * @st: Where to put them.
+ *
+ * Lockless, so that reading the statistics does not contend with the users
+ * of @ws; the numbers are retried if @ws changes while they are copied.
+ */
+static void wakeup_source_get_stats(struct wakeup_source *ws,
+				    struct wakeup_source_stats *st)
+{
+	ktime_t start_prevent_time;
+	bool autosleep_enabled;
+	unsigned int seq;
+
+	do {
+		seq = read_seqcount_begin(&ws->seq);
+		st->total_time = ws->total_time;
+		st->max_time = ws->max_time;
+		st->last_time = ws->last_time;
+		st->prevent_sleep_time = ws->prevent_sleep_time;
+		st->event_count = ws->event_count;
+		st->active_count = ws->active_count;
+		st->wakeup_count = ws->wakeup_count;
+		st->expire_count = ws->expire_count;
+		memcpy(st->hold_hist, ws->hold_hist, sizeof(st->hold_hist));
+		st->active = ws->active;
+		autosleep_enabled = ws->autosleep_enabled;
+		start_prevent_time = ws->start_prevent_time;
+	} while (read_seqcount_retry(&ws->seq, seq));
+
+	if (st->active) {
 		ktime_t now = ktime_get();
 
-		active_time = ktime_sub(now, ws->last_time);
-		total_time = ktime_add(total_time, active_time);
-		if (active_time.tv64 > max_time.tv64)
-			max_time = active_time;
+		st->active_time = ktime_sub(now, st->last_time);
+		st->total_time = ktime_add(st->total_time, st->active_time);
+		if (st->active_time.tv64 > st->max_time.tv64)
+			st->max_time = st->active_time;
 
-		if (ws->autosleep_enabled)
-			prevent_sleep_time = ktime_add(prevent_sleep_time,
-				ktime_sub(now, ws->start_prevent_time));
+		if (autosleep_enabled)
+			st->prevent_sleep_time = ktime_add(st->prevent_sleep_time,
+				ktime_sub(now, start_prevent_time));
 	} else {
-		active_time = ktime_set(0, 0);
+		st->active_time = ktime_set(0, 0);
 	}
+}
 
-	ret = seq_printf(m, "%-12s\t%lu\t\t%lu\t\t%lu\t\t%lu\t\t"
-			"%lld\t\t%lld\t\t%lld\t\t%lld\t\t%lld\n",
-			ws->name, active_count, ws->event_count,
-			ws->wakeup_count, ws->expire_count,
-			ktime_to_ms(active_time), ktime_to_ms(total_time),
-			ktime_to_ms(max_time), ktime_to_ms(ws->last_time),
-			ktime_to_ms(prevent_sleep_time));
+/**
+ * print_wakeup_source_stats - Print wakeup source statistics information.
+ * @m: seq_file to print the statistics into.
+ * @ws: Wakeup source object to print the statistics for.
+ */
+static int print_wakeup_source_stats(struct seq_file *m,
+				     struct wakeup_source *ws)
+{
+	struct wakeup_source_stats st;
 
-	spin_unlock_irqrestore(&ws->lock, flags);
+	wakeup_source_get_stats(ws, &st);
 
-	return ret;
+	return seq_printf(m, "%-12s\t%lu\t\t%lu\t\t%lu\t\t%lu\t\t"
+			"%lld\t\t%lld\t\t%lld\t\t%lld\t\t%lld\n",
+			ws->name, st.active_count, st.event_count,
+			st.wakeup_count, st.expire_count,
+			ktime_to_ms(st.active_time), ktime_to_ms(st.total_time),
+			ktime_to_ms(st.max_time), ktime_to_ms(st.last_time),
+			ktime_to_ms(st.prevent_sleep_time));
 }
 
 /**
@@ -960,10 +1020,119 @@ static const struct file_operations wakeup_sources_stats_fops = {
 	.release = single_release,
 };
 
+/**
+ * wakeup_sources_hist_show - Print hold time histograms of wakeup sources.
+ * @m: seq_file to print the histograms into.
+ */
+static int wakeup_sources_hist_show(struct seq_file *m, void *unused)
+{
+	struct user_namespace *ns = seq_user_ns(m);
+	struct wakeup_source_stats st;
+	struct wakeup_source *ws;
+	int i;
+
+	seq_puts(m, "name\t\tuid\t<1ms");
+	for (i = 1; i < WAKEUP_STATS_HIST_BUCKETS; i++)
+		seq_printf(m, "\t%lums", 1UL << (i - 1));
+	seq_putc(m, '\n');
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(ws, &wakeup_sources, entry) {
+		wakeup_source_get_stats(ws, &st);
+		seq_printf(m, "%-12s\t%u", ws->name,
+			   from_kuid_munged(ns, ws->uid));
+		for (i = 0; i < WAKEUP_STATS_HIST_BUCKETS; i++)
+			seq_printf(m, "\t%lu", st.hold_hist[i]);
+		seq_putc(m, '\n');
+	}
+	rcu_read_unlock();
+
+	return 0;
+}
+
+static int wakeup_sources_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wakeup_sources_hist_show, NULL);
+}
+
+static const struct file_operations wakeup_sources_hist_fops = {
+	.owner = THIS_MODULE,
+	.open = wakeup_sources_hist_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/**
+ * wakeup_sources_bin_show - Dump wakeup source statistics in binary form.
+ * @m: seq_file to write the records into.
+ *
+ * See include/uapi/linux/wakeup_stats.h for the format.
+ */
+static int wakeup_sources_bin_show(struct seq_file *m, void *unused)
+{
+	struct wakeup_stats_header hdr = {
+		.magic		= WAKEUP_STATS_MAGIC,
+		.version	= WAKEUP_STATS_VERSION,
+		.record_size	= sizeof(struct wakeup_stats_record),
+		.hist_buckets	= WAKEUP_STATS_HIST_BUCKETS,
+		.now_ms		= ktime_to_ms(ktime_get()),
+	};
+	struct wakeup_stats_record rec;
+	struct wakeup_source_stats st;
+	struct wakeup_source *ws;
+	int i;
+
+	seq_write(m, &hdr, sizeof(hdr));
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(ws, &wakeup_sources, entry) {
+		wakeup_source_get_stats(ws, &st);
+
+		memset(&rec, 0, sizeof(rec));
+		strlcpy(rec.name, ws->name ?: "", sizeof(rec.name));
+		rec.uid = from_kuid_munged(&init_user_ns, ws->uid);
+		rec.active = st.active;
+		rec.active_count = st.active_count;
+		rec.event_count = st.event_count;
+		rec.wakeup_count = st.wakeup_count;
+		rec.expire_count = st.expire_count;
+		rec.active_time_ms = ktime_to_ms(st.active_time);
+		rec.total_time_ms = ktime_to_ms(st.total_time);
+		rec.max_time_ms = ktime_to_ms(st.max_time);
+		rec.last_change_ms = ktime_to_ms(st.last_time);
+		rec.prevent_sleep_time_ms = ktime_to_ms(st.prevent_sleep_time);
+		for (i = 0; i < WAKEUP_STATS_HIST_BUCKETS; i++)
+			rec.hold_hist[i] = st.hold_hist[i];
+
+		seq_write(m, &rec, sizeof(rec));
+	}
+	rcu_read_unlock();
+
+	return 0;
+}
+
+static int wakeup_sources_bin_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wakeup_sources_bin_show, NULL);
+}
+
+static const struct file_operations wakeup_sources_bin_fops = {
+	.owner = THIS_MODULE,
+	.open = wakeup_sources_bin_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int __init wakeup_sources_debugfs_init(void)
 {
 	wakeup_sources_stats_dentry = debugfs_create_file("wakeup_sources",
 			S_IRUGO, NULL, NULL, &wakeup_sources_stats_fops);
+	debugfs_create_file("wakeup_sources_hist", S_IRUGO, NULL, NULL,
+			    &wakeup_sources_hist_fops);
+	debugfs_create_file("wakeup_sources_bin", S_IRUGO, NULL, NULL,
+			    &wakeup_sources_bin_fops);
 	return 0;
 }
 
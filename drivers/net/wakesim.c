@@ -0,0 +1,206 @@
+/*
+ * wakesim.c: simulated wake-capable network device
+ *
+ * A raw IP point-to-point device whose "hardware" is a debugfs file: each
+ * write to /sys/kernel/debug/wakesim/inject is received as one IPv4 or
+ * IPv6 packet, as if the radio had woken the host to deliver it. The
+ * packet goes through the receive batching layer and the driver holds
+ * its wakeup source only when the packet was delivered at once, like a
+ * real driver would. Counters in /sys/kernel/debug/wakesim/stats show
+ * how many simulated wakeups were avoided.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/debugfs.h>
+#include <linux/if_arp.h>
+#include <linux/init.h>
+#include <linux/netdevice.h>
+#include <linux/pm_wakeup.h>
+#include <linux/seq_file.h>
+#include <linux/skbuff.h>
+#include <linux/uaccess.h>
+#include <net/wake_batch.h>
+
+/* how long a real driver would hold the system for one wake packet */
+#define WAKESIM_HOLD_MS	1000
+
+struct wakesim_priv {
+	struct net_wake_batch	batch;
+	struct wakeup_source	*ws;
+	struct dentry		*dir;
+	u32			priority;
+	unsigned long		injected;
+	unsigned long		wakeups;
+	unsigned long		deferred;
+};
+
+static struct net_device *wakesim_dev;
+
+static netdev_tx_t wakesim_xmit(struct sk_buff *skb, struct net_device *dev)
+{
+	dev->stats.tx_packets++;
+	dev->stats.tx_bytes += skb->len;
+	dev_kfree_skb(skb);
+	return NETDEV_TX_OK;
+}
+
+static const struct net_device_ops wakesim_netdev_ops = {
+	.ndo_start_xmit		= wakesim_xmit,
+};
+
+static void wakesim_setup(struct net_device *dev)
+{
+	dev->netdev_ops = &wakesim_netdev_ops;
+	dev->type = ARPHRD_NONE;
+	dev->hard_header_len = 0;
+	dev->addr_len = 0;
+	dev->mtu = 1500;
+	dev->tx_queue_len = 0;
+	dev->flags = IFF_POINTOPOINT | IFF_NOARP;
+	dev->features |= NETIF_F_LLTX;
+}
+
+static ssize_t wakesim_inject_write(struct file *file, const char __user *buf,
+				    size_t len, loff_t *ppos)
+{
+	struct net_device *dev = file->private_data;
+	struct wakesim_priv *priv = netdev_priv(dev);
+	struct sk_buff *skb;
+
+	if (!(dev->flags & IFF_UP))
+		return -ENETDOWN;
+	if (len < 1 || len > dev->mtu)
+		return -EINVAL;
+
+	skb = netdev_alloc_skb_ip_align(dev, len);
+	if (!skb)
+		return -ENOMEM;
+	if (copy_from_user(skb_put(skb, len), buf, len)) {
+		kfree_skb(skb);
+		return -EFAULT;
+	}
+
+	switch (skb->data[0] >> 4) {
+	case 4:
+		skb->protocol = htons(ETH_P_IP);
+		break;
+	case 6:
+		skb->protocol = htons(ETH_P_IPV6);
+		break;
+	default:
+		kfree_skb(skb);
+		return -EINVAL;
+	}
+	skb_reset_mac_header(skb);
+	skb_reset_network_header(skb);
+	/* the simulated hardware verified the checksums */
+	skb->ip_summed = CHECKSUM_UNNECESSARY;
+	skb->priority = priv->priority;
+
+	dev->stats.rx_packets++;
+	dev->stats.rx_bytes += len;
+	priv->injected++;
+
+	if (net_wake_batch_rx(&priv->batch, skb)) {
+		__pm_wakeup_event(priv->ws, WAKESIM_HOLD_MS);
+		priv->wakeups++;
+	} else {
+		priv->deferred++;
+	}
+	return len;
+}
+
+static const struct file_operations wakesim_inject_fops = {
+	.owner	= THIS_MODULE,
+	.open	= simple_open,
+	.write	= wakesim_inject_write,
+	.llseek	= noop_llseek,
+};
+
+static int wakesim_stats_show(struct seq_file *s, void *unused)
+{
+	struct wakesim_priv *priv = netdev_priv(s->private);
+
+	seq_printf(s, "injected %lu\nwakeups %lu\ndeferred %lu\n",
+		   priv->injected, priv->wakeups, priv->deferred);
+	return 0;
+}
+
+static int wakesim_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wakesim_stats_show, inode->i_private);
+}
+
+static const struct file_operations wakesim_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= wakesim_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init wakesim_init(void)
+{
+	struct wakesim_priv *priv;
+	struct net_device *dev;
+	int err = -ENOMEM;
+
+	dev = alloc_netdev(sizeof(*priv), "wakesim%d", wakesim_setup);
+	if (!dev)
+		return -ENOMEM;
+	priv = netdev_priv(dev);
+
+	priv->ws = wakeup_source_register("wakesim");
+	if (!priv->ws)
+		goto err_free;
+
+	priv->dir = debugfs_create_dir("wakesim", NULL);
+	if (!priv->dir)
+		goto err_ws;
+	debugfs_create_file("inject", S_IWUSR, priv->dir, dev,
+			    &wakesim_inject_fops);
+	debugfs_create_file("stats", S_IRUGO, priv->dir, dev,
+			    &wakesim_stats_fops);
+	debugfs_create_u32("priority", S_IRUGO | S_IWUSR, priv->dir,
+			   &priv->priority);
+
+	net_wake_batch_register(&priv->batch, dev);
+	err = register_netdev(dev);
+	if (err)
+		goto err_batch;
+
+	wakesim_dev = dev;
+	return 0;
+
+err_batch:
+	net_wake_batch_unregister(&priv->batch);
+	debugfs_remove_recursive(priv->dir);
+err_ws:
+	wakeup_source_unregister(priv->ws);
+err_free:
+	free_netdev(dev);
+	return err;
+}
+
+static void __exit wakesim_exit(void)
+{
+	struct wakesim_priv *priv = netdev_priv(wakesim_dev);
+
+	/* no more injections once the files are gone */
+	debugfs_remove_recursive(priv->dir);
+	net_wake_batch_unregister(&priv->batch);
+	unregister_netdev(wakesim_dev);
+	wakeup_source_unregister(priv->ws);
+	free_netdev(wakesim_dev);
+}
+
+module_init(wakesim_init);
+module_exit(wakesim_exit);
+MODULE_DESCRIPTION("Simulated wake-capable network device");
+MODULE_LICENSE("GPL");
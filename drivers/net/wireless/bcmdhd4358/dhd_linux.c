@@ -51,6 +51,9 @@
 #include <linux/reboot.h>
 #include <linux/notifier.h>
 #include <net/addrconf.h>
+#ifdef CONFIG_NET_WAKE_BATCH
+#include <net/wake_batch.h>
+#endif /* CONFIG_NET_WAKE_BATCH */
 #ifdef ENABLE_ADAPTIVE_SCHED
 #include <linux/cpufreq.h>
 #endif /* ENABLE_ADAPTIVE_SCHED */
@@ -424,6 +427,10 @@ typedef struct dhd_info {
 	void *adapter;			/* adapter information, interrupt, fw path etc. */
 	char fw_path[PATH_MAX];		/* path to firmware image */
 	char nv_path[PATH_MAX];		/* path to nvram vars file */
+#ifdef CONFIG_NET_WAKE_BATCH
+	struct net_wake_batch wake_batch;	/* screen-off rx batching, wlan0 */
+	bool wake_batch_on;
+#endif /* CONFIG_NET_WAKE_BATCH */
 
 	struct semaphore proto_sem;
 #ifdef PROP_TXSTATUS
@@ -2824,6 +2831,9 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 	int tout_ctrl = 0;
 	void *skbhead = NULL;
 	void *skbprev = NULL;
+#ifdef CONFIG_NET_WAKE_BATCH
+	int rx_data = 0, rx_parked = 0;
+#endif /* CONFIG_NET_WAKE_BATCH */
 #if defined(DHD_RX_DUMP) || defined(DHD_8021X_DUMP)
 	char *dump_data;
 	uint16 protocol;
@@ -3058,6 +3068,9 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 #endif /* DHD_DONOT_FORWARD_BCMEVENT_AS_NETWORK_PKT */
 		} else {
 			tout_rx = DHD_PACKET_TIMEOUT_MS;
+#ifdef CONFIG_NET_WAKE_BATCH
+			rx_data++;
+#endif /* CONFIG_NET_WAKE_BATCH */
 
 #ifdef PROP_TXSTATUS
 			dhd_wlfc_save_rxpath_ac_time(dhdp, (uint8)PKTPRIO(skb));
@@ -3077,6 +3090,17 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 			ifp->stats.rx_packets++;
 		}
 
+#ifdef CONFIG_NET_WAKE_BATCH
+		/* EAPOL is never held back, the handshake has timeouts */
+		if (dhd->wake_batch_on && ifidx == 0 &&
+			ntoh16(skb->protocol) != ETHER_TYPE_BRCM &&
+			ntoh16(skb->protocol) != ETHER_TYPE_802_1X) {
+			if (!net_wake_batch_rx(&dhd->wake_batch, skb))
+				rx_parked++;
+			continue;
+		}
+#endif /* CONFIG_NET_WAKE_BATCH */
+
 #ifndef RXFRAME_THREAD
 		if (in_interrupt()) {
 			netif_rx(skb);
@@ -3114,6 +3138,11 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 	if (dhd->rxthread_enabled && skbhead)
 		dhd_sched_rxf(dhdp, skbhead);
 
+#ifdef CONFIG_NET_WAKE_BATCH
+	/* every data frame was parked: nothing to stay awake for */
+	if (rx_data && rx_data == rx_parked)
+		tout_rx = 0;
+#endif /* CONFIG_NET_WAKE_BATCH */
 	DHD_OS_WAKE_LOCK_RX_TIMEOUT_ENABLE(dhdp, tout_rx);
 	DHD_OS_WAKE_LOCK_CTRL_TIMEOUT_ENABLE(dhdp, tout_ctrl);
 }
@@ -7226,6 +7255,13 @@ dhd_register_if(dhd_pub_t *dhdp, int ifidx, bool need_rtnl_lock)
 		goto fail;
 	}
 
+#ifdef CONFIG_NET_WAKE_BATCH
+	if (ifidx == 0 && !dhd->wake_batch_on) {
+		net_wake_batch_register(&dhd->wake_batch, net);
+		dhd->wake_batch_on = TRUE;
+	}
+#endif /* CONFIG_NET_WAKE_BATCH */
+
 
 
 	printf("Register interface [%s]  MAC: "MACDBG"\n\n", net->name,
@@ -7389,6 +7425,12 @@ void dhd_detach(dhd_pub_t *dhdp)
 		ifp = dhd->iflist[0];
 		ASSERT(ifp && ifp->net);
 		if (ifp && ifp->net) {
+#ifdef CONFIG_NET_WAKE_BATCH
+			if (dhd->wake_batch_on) {
+				dhd->wake_batch_on = FALSE;
+				net_wake_batch_unregister(&dhd->wake_batch);
+			}
+#endif /* CONFIG_NET_WAKE_BATCH */
 
 
 
@@ -275,6 +275,7 @@ static int __bprm_mm_init(struct linux_binprm *bprm)
 
 	down_write(&mm->mmap_sem);
 	vma->vm_mm = mm;
+	vma_spf_init(vma);
 
 	/*
 	 * Place the stack at the largest stack address the architecture
@@ -865,6 +866,7 @@ static int exec_mmap(struct mm_struct *mm)
 	activate_mm(active_mm, mm);
 	task_unlock(tsk);
 	arch_pick_mmap_layout(mm);
+	lru_gen_add_mm(mm);
 	if (old_mm) {
 		up_read(&old_mm->mmap_sem);
 		BUG_ON(active_mm != old_mm);
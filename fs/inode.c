@@ -350,6 +350,7 @@ void address_space_init_once(struct address_space *mapping)
 	spin_lock_init(&mapping->tree_lock);
 	mutex_init(&mapping->i_mmap_mutex);
 	INIT_LIST_HEAD(&mapping->private_list);
+	INIT_LIST_HEAD(&mapping->shadow_list);
 	spin_lock_init(&mapping->private_lock);
 	mapping->i_mmap = RB_ROOT;
 	INIT_LIST_HEAD(&mapping->i_mmap_nonlinear);
@@ -556,9 +557,14 @@ static void evict(struct inode *inode)
 
 	if (op->evict_inode) {
 		op->evict_inode(inode);
+		/*
+		 * Filesystems truncate with truncate_inode_pages(), which
+		 * does not keep reclaim from leaving a shadow entry behind
+		 * it.  Sweep up whatever is left before the mapping goes.
+		 */
+		truncate_inode_pages_final(&inode->i_data);
 	} else {
-		if (inode->i_data.nrpages)
-			truncate_inode_pages(&inode->i_data, 0);
+		truncate_inode_pages_final(&inode->i_data);
 		clear_inode(inode);
 	}
 	if (S_ISBLK(inode->i_mode) && inode->i_bdev)
@@ -2749,6 +2749,52 @@ static int proc_pid_personality(struct seq_file *m, struct pid_namespace *ns,
 	return err;
 }
 
+#ifdef CONFIG_KSM
+static int proc_pid_ksm_stat(struct seq_file *m, struct pid_namespace *ns,
+			     struct pid *pid, struct task_struct *task)
+{
+	struct mm_struct *mm;
+
+	mm = get_task_mm(task);
+	if (mm) {
+		seq_printf(m, "ksm_rmap_items %lu\n", mm->ksm_rmap_items);
+		seq_printf(m, "ksm_merging_pages %lu\n",
+			   mm->ksm_merging_pages);
+		seq_printf(m, "ksm_zero_pages_merged %lu\n",
+			   mm->ksm_zero_pages_merged);
+		mmput(mm);
+	}
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_RECLAIM_LATENCY_HIST
+static int proc_pid_reclaim_latency(struct seq_file *m, struct pid_namespace *ns,
+				    struct pid *pid, struct task_struct *task)
+{
+	struct reclaim_latency *lat = &task->signal->reclaim_lat;
+	char range[24];
+	int i;
+
+	seq_printf(m, "%-16s %10s\n", "usecs", "count");
+	for (i = 0; i < RECLAIM_LAT_BUCKETS; i++) {
+		unsigned long lo = i ? 64UL << i : 0;
+
+		if (i == RECLAIM_LAT_BUCKETS - 1)
+			snprintf(range, sizeof(range), "%lu-", lo);
+		else
+			snprintf(range, sizeof(range), "%lu-%lu", lo,
+				 (128UL << i) - 1);
+		seq_printf(m, "%-16s %10u\n", range,
+			   atomic_read(&lat->count[i]));
+	}
+	seq_printf(m, "total_us %llu\nmax_us %u\n",
+		   (unsigned long long)atomic64_read(&lat->total_us),
+		   ACCESS_ONCE(lat->max_us));
+	return 0;
+}
+#endif
+
 /*
  * Thread groups
  */
@@ -2801,6 +2847,15 @@ static const struct pid_entry tgid_base_stuff[] = {
 	REG("smaps_simple", S_IRUGO, proc_pid_smaps_simple_operations),
 	REG("pagemap",    S_IRUGO, proc_pagemap_operations),
 #endif
+#ifdef CONFIG_PROCESS_RECLAIM
+	REG("reclaim",    S_IWUSR, proc_reclaim_operations),
+#endif
+#ifdef CONFIG_RECLAIM_LATENCY_HIST
+	ONE("reclaim_latency", S_IRUGO, proc_pid_reclaim_latency),
+#endif
+#ifdef CONFIG_KSM
+	ONE("ksm_stat",   S_IRUGO, proc_pid_ksm_stat),
+#endif
 #ifdef CONFIG_SECURITY
 	DIR("attr",       S_IRUGO|S_IXUGO, proc_attr_dir_inode_operations, proc_attr_dir_operations),
 #endif
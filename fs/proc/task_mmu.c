@@ -11,6 +11,7 @@
 #include <linux/rmap.h>
 #include <linux/swap.h>
 #include <linux/swapops.h>
+#include <linux/mm_inline.h>
 
 #include <asm/elf.h>
 #include <asm/uaccess.h>
@@ -1198,6 +1199,169 @@ const struct file_operations proc_pagemap_operations = {
 };
 #endif /* CONFIG_PROC_PAGE_MONITOR */
 
+#ifdef CONFIG_PROCESS_RECLAIM
+struct reclaim_param {
+	struct vm_area_struct *vma;
+	unsigned long nr_reclaimed;
+};
+
+static int reclaim_pte_range(pmd_t *pmd, unsigned long addr,
+				unsigned long end, struct mm_walk *walk)
+{
+	struct reclaim_param *rp = walk->private;
+	struct vm_area_struct *vma = rp->vma;
+	pte_t *pte, ptent;
+	spinlock_t *ptl;
+	struct page *page;
+	LIST_HEAD(page_list);
+
+	split_huge_page_pmd(vma, addr, pmd);
+	if (pmd_trans_unstable(pmd))
+		return 0;
+
+	pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		ptent = *pte;
+		if (!pte_present(ptent))
+			continue;
+
+		page = vm_normal_page(vma, addr, ptent);
+		if (!page)
+			continue;
+
+		/* Leave pages that other processes map as well. */
+		if (page_mapcount(page) != 1)
+			continue;
+
+		if (isolate_lru_page(page))
+			continue;
+
+		list_add(&page->lru, &page_list);
+		inc_zone_page_state(page, NR_ISOLATED_ANON +
+				    page_is_file_cache(page));
+	}
+	pte_unmap_unlock(pte - 1, ptl);
+
+	if (!list_empty(&page_list))
+		rp->nr_reclaimed += reclaim_pages_from_list(&page_list);
+	cond_resched();
+	return 0;
+}
+
+enum reclaim_type {
+	RECLAIM_FILE,
+	RECLAIM_ANON,
+	RECLAIM_ALL,
+};
+
+static int parse_reclaim_type(const char *s, enum reclaim_type *type)
+{
+	if (!strcmp(s, "file"))
+		*type = RECLAIM_FILE;
+	else if (!strcmp(s, "anon"))
+		*type = RECLAIM_ANON;
+	else if (!strcmp(s, "all"))
+		*type = RECLAIM_ALL;
+	else
+		return -EINVAL;
+	return 0;
+}
+
+/*
+ * Writing "file", "anon" or "all" to /proc/<pid>/reclaim reclaims that
+ * kind of private page from the whole address space; "<addr> <size>"
+ * optionally followed by the kind limits it to a range.
+ */
+static ssize_t reclaim_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct task_struct *task;
+	char buffer[64], *p, *tok;
+	struct mm_struct *mm;
+	struct vm_area_struct *vma;
+	enum reclaim_type type = RECLAIM_ALL;
+	unsigned long start = 0, end = TASK_SIZE;
+	struct reclaim_param rp = { .nr_reclaimed = 0 };
+	int rv;
+
+	memset(buffer, 0, sizeof(buffer));
+	if (count > sizeof(buffer) - 1)
+		count = sizeof(buffer) - 1;
+	if (copy_from_user(buffer, buf, count))
+		return -EFAULT;
+
+	p = strstrip(buffer);
+	tok = strsep(&p, " ");
+	if (!tok || !*tok)
+		return -EINVAL;
+	if (parse_reclaim_type(tok, &type)) {
+		unsigned long size;
+		char *endp;
+
+		rv = kstrtoul(tok, 0, &start);
+		if (rv < 0)
+			return rv;
+		tok = strsep(&p, " ");
+		if (!tok)
+			return -EINVAL;
+		size = memparse(tok, &endp);
+		if (*endp || !size)
+			return -EINVAL;
+		end = PAGE_ALIGN(start + size);
+		start &= PAGE_MASK;
+		if (end <= start || end > TASK_SIZE)
+			return -EINVAL;
+		tok = strsep(&p, " ");
+		if (tok && parse_reclaim_type(tok, &type))
+			return -EINVAL;
+	}
+	if (p)
+		return -EINVAL;
+
+	task = get_proc_task(file_inode(file));
+	if (!task)
+		return -ESRCH;
+	mm = get_task_mm(task);
+	if (mm) {
+		struct mm_walk reclaim_walk = {
+			.pmd_entry = reclaim_pte_range,
+			.mm = mm,
+			.private = &rp,
+		};
+
+		down_read(&mm->mmap_sem);
+		for (vma = find_vma(mm, start); vma && vma->vm_start < end;
+		     vma = vma->vm_next) {
+			if (is_vm_hugetlb_page(vma))
+				continue;
+			if (vma->vm_flags & (VM_LOCKED | VM_PFNMAP | VM_IO))
+				continue;
+			if (type == RECLAIM_ANON && vma->vm_file)
+				continue;
+			if (type == RECLAIM_FILE && !vma->vm_file)
+				continue;
+
+			rp.vma = vma;
+			walk_page_range(max(vma->vm_start, start),
+					min(vma->vm_end, end), &reclaim_walk);
+			if (fatal_signal_pending(current))
+				break;
+		}
+		flush_tlb_mm(mm);
+		up_read(&mm->mmap_sem);
+		mmput(mm);
+	}
+	put_task_struct(task);
+
+	return count;
+}
+
+const struct file_operations proc_reclaim_operations = {
+	.write		= reclaim_write,
+	.llseek		= noop_llseek,
+};
+#endif /* CONFIG_PROCESS_RECLAIM */
+
 #ifdef CONFIG_NUMA
 
 struct numa_maps {
@@ -49,6 +49,12 @@ SUBSYS(freezer)
 
 /* */
 
+#if IS_SUBSYS_ENABLED(CONFIG_CGROUP_TIMER_SLACK)
+SUBSYS(timer_slack)
+#endif
+
+/* */
+
 #if IS_SUBSYS_ENABLED(CONFIG_NET_CLS_CGROUP)
 SUBSYS(net_cls)
 #endif
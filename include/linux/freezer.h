@@ -74,11 +74,18 @@ extern bool set_freezable(void);
 
 #ifdef CONFIG_CGROUP_FREEZER
 extern bool cgroup_freezing(struct task_struct *task);
+extern bool cgroup_freezer_walk_unfrozen(void (*fn)(struct task_struct *, void *),
+					 void *data);
 #else /* !CONFIG_CGROUP_FREEZER */
 static inline bool cgroup_freezing(struct task_struct *task)
 {
 	return false;
 }
+static inline bool cgroup_freezer_walk_unfrozen(
+		void (*fn)(struct task_struct *, void *), void *data)
+{
+	return false;
+}
 #endif /* !CONFIG_CGROUP_FREEZER */
 
 /*
@@ -46,7 +46,8 @@ struct decode_context {
  * ipc_log_context_create: Create a debug log context
  *                         Should not be called from atomic context
  *
- * @max_num_pages: Number of pages of logging space required (max. 10)
+ * @max_num_pages: Number of pages of logging space required (max. 10),
+ *                 shared out among the per-CPU rings, at least one each
  * @mod_name     : Name of the directory entry under DEBUGFS
  *
  * returns context id on success, NULL on failure
@@ -112,6 +113,9 @@ void ipc_log_write(void *ctxt, struct encode_context *ectxt);
  *
  * @ilctxt: Debug Log Context created using ipc_log_context_create()
  * @fmt:    Data specified using format specifiers
+ *
+ * When @fmt is a literal in the kernel image, only the arguments are
+ * saved and the string is formatted when the log is read.
  */
 int ipc_log_string(void *ilctxt, const char *fmt, ...) __printf(2, 3);
 
@@ -123,9 +127,9 @@ int ipc_log_string(void *ilctxt, const char *fmt, ...) __printf(2, 3);
  * @size:    size of the buffer
  * @returns: 0 if no data read; >0 number of bytes read; < 0 error
  *
- * If no data is available to be read, then the ilctxt::read_avail
- * completion is reinitialized.  This allows clients to block
- * until new log data is save.
+ * Messages logged on different CPUs are merged in the order they were
+ * logged.  Clients can sleep on ilctxt::read_wait until new log data
+ * is saved.
  */
 int ipc_log_extract(void *ilctxt, char *buff, int size);
 
@@ -24,6 +24,10 @@ void __ksm_exit(struct mm_struct *mm);
 
 static inline int ksm_fork(struct mm_struct *mm, struct mm_struct *oldmm)
 {
+	/* dup_mm() copied the parent's counters: nothing is merged yet */
+	mm->ksm_rmap_items = 0;
+	mm->ksm_merging_pages = 0;
+	mm->ksm_zero_pages_merged = 0;
 	if (test_bit(MMF_VM_MERGEABLE, &oldmm->flags))
 		return __ksm_enter(mm);
 	return 0;
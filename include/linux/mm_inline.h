@@ -25,10 +25,203 @@ static inline int page_is_file_cache(struct page *page)
 	return !PageSwapBacked(page);
 }
 
+#ifdef CONFIG_LRU_GEN
+
+static inline int lru_gen_from_seq(unsigned long seq)
+{
+	return seq % MAX_NR_GENS;
+}
+
+/* returns -1 if @page is not on a generation list */
+static inline int page_lru_gen(struct page *page)
+{
+	return (int)((ACCESS_ONCE(page->flags) & LRU_GEN_MASK) >>
+		     LRU_GEN_PGOFF) - 1;
+}
+
+/* other page flags change without zone->lru_lock, so update atomically */
+static inline void set_page_lru_gen(struct page *page, int gen)
+{
+	unsigned long old_flags, flags;
+
+	do {
+		old_flags = ACCESS_ONCE(page->flags);
+		flags = (old_flags & ~LRU_GEN_MASK) |
+			((gen + 1UL) << LRU_GEN_PGOFF);
+	} while (cmpxchg(&page->flags, old_flags, flags) != old_flags);
+}
+
+static inline bool lru_gen_is_active(struct lruvec *lruvec, int gen)
+{
+	unsigned long max_seq = lruvec->lrugen.max_seq;
+
+	return gen == lru_gen_from_seq(max_seq) ||
+	       gen == lru_gen_from_seq(max_seq - 1);
+}
+
+static inline void lru_gen_update_lru_size(struct lruvec *lruvec,
+					   enum lru_list lru, int nr_pages)
+{
+	mem_cgroup_update_lru_size(lruvec, lru, nr_pages);
+	__mod_zone_page_state(lruvec_zone(lruvec), NR_LRU_BASE + lru, nr_pages);
+}
+
+/*
+ * Move the accounting of @page from generation @old_gen to @new_gen, -1
+ * meaning "not on a generation list". Called with zone->lru_lock held.
+ */
+static inline void lru_gen_update_size(struct lruvec *lruvec,
+				       struct page *page,
+				       int old_gen, int new_gen)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int type = page_is_file_cache(page);
+	int nr_pages = hpage_nr_pages(page);
+	enum lru_list lru = type ? LRU_INACTIVE_FILE : LRU_INACTIVE_ANON;
+	bool old_active = old_gen >= 0 && lru_gen_is_active(lruvec, old_gen);
+	bool new_active = new_gen >= 0 && lru_gen_is_active(lruvec, new_gen);
+
+	if (old_gen >= 0)
+		lrugen->nr_pages[old_gen][type] -= nr_pages;
+	if (new_gen >= 0)
+		lrugen->nr_pages[new_gen][type] += nr_pages;
+
+	if (old_gen >= 0 && new_gen >= 0 && old_active == new_active)
+		return;
+	if (old_gen >= 0)
+		lru_gen_update_lru_size(lruvec, lru + old_active, -nr_pages);
+	if (new_gen >= 0)
+		lru_gen_update_lru_size(lruvec, lru + new_active, nr_pages);
+}
+
+/* generation pages are counted as inactive, whatever their age */
+static inline void lru_gen_count_cma(struct page *page, int delta)
+{
+#if defined(CONFIG_CMA_PAGE_COUNTING)
+	enum lru_list lru = page_is_file_cache(page) ? LRU_INACTIVE_FILE :
+						       LRU_INACTIVE_ANON;
+
+	if (is_cma_pageblock(page))
+		__mod_zone_page_state(page_zone(page),
+				      NR_FREE_CMA_PAGES + 1 + lru, delta);
+#endif
+}
+
+/*
+ * Pages activated on their way to the LRU, e.g. freshly faulted anon
+ * pages or pages found referenced by reclaim, start in the youngest
+ * generation. Pages reclaim wants to see again soon go to the tail of
+ * the oldest generation and everything else to the second oldest one.
+ */
+static inline void __lru_gen_add_page(struct lruvec *lruvec,
+				      struct page *page, bool reclaiming)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int type = page_is_file_cache(page);
+	unsigned long seq;
+	int gen;
+
+	VM_BUG_ON(page_lru_gen(page) != -1);
+
+#ifdef CONFIG_SCFS_LOWER_PAGECACHE_INVALIDATION
+	if (PageNocache(page))
+		reclaiming = true;
+#endif
+	if (PageActive(page)) {
+		ClearPageActive(page);
+		seq = lrugen->max_seq;
+	} else if (reclaiming) {
+		seq = lrugen->min_seq[type];
+	} else {
+		seq = lrugen->min_seq[type] + 1;
+	}
+	gen = lru_gen_from_seq(seq);
+	set_page_lru_gen(page, gen);
+	lru_gen_update_size(lruvec, page, -1, gen);
+	if (reclaiming)
+		list_add_tail(&page->lru, &lrugen->lists[gen][type]);
+	else
+		list_add(&page->lru, &lrugen->lists[gen][type]);
+	lru_gen_count_cma(page, 1);
+}
+
+static inline bool lru_gen_add_page(struct lruvec *lruvec, struct page *page)
+{
+	if (!lruvec->lrugen.enabled || PageUnevictable(page))
+		return false;
+
+	__lru_gen_add_page(lruvec, page, false);
+	return true;
+}
+
+static inline bool lru_gen_del_page(struct lruvec *lruvec, struct page *page)
+{
+	int gen = page_lru_gen(page);
+
+	if (gen < 0)
+		return false;
+
+	list_del(&page->lru);
+	lru_gen_update_size(lruvec, page, gen, -1);
+	set_page_lru_gen(page, -1);
+	lru_gen_count_cma(page, -1);
+	return true;
+}
+
+/* the equivalent of moving @page to the tail of its inactive list */
+static inline bool lru_gen_rotate_page(struct lruvec *lruvec,
+				       struct page *page)
+{
+	if (!lru_gen_del_page(lruvec, page))
+		return false;
+
+	__lru_gen_add_page(lruvec, page, true);
+	return true;
+}
+
+/* a THP tail page inherits the generation of its head page */
+static inline void lru_gen_add_page_tail(struct page *page,
+					 struct page *page_tail)
+{
+	int gen = page_lru_gen(page);
+
+	if (gen >= 0)
+		set_page_lru_gen(page_tail, gen);
+}
+
+#else /* CONFIG_LRU_GEN */
+
+static inline bool lru_gen_add_page(struct lruvec *lruvec, struct page *page)
+{
+	return false;
+}
+
+static inline bool lru_gen_del_page(struct lruvec *lruvec, struct page *page)
+{
+	return false;
+}
+
+static inline bool lru_gen_rotate_page(struct lruvec *lruvec,
+				       struct page *page)
+{
+	return false;
+}
+
+static inline void lru_gen_add_page_tail(struct page *page,
+					 struct page *page_tail)
+{
+}
+
+#endif /* CONFIG_LRU_GEN */
+
 static __always_inline void add_page_to_lru_list(struct page *page,
 				struct lruvec *lruvec, enum lru_list lru)
 {
 	int nr_pages = hpage_nr_pages(page);
+
+	if (lru_gen_add_page(lruvec, page))
+		return;
+
 	mem_cgroup_update_lru_size(lruvec, lru, nr_pages);
 #ifdef CONFIG_SCFS_LOWER_PAGECACHE_INVALIDATION
 	if (PageNocache(page))
@@ -50,6 +243,10 @@ static __always_inline void del_page_from_lru_list(struct page *page,
 				struct lruvec *lruvec, enum lru_list lru)
 {
 	int nr_pages = hpage_nr_pages(page);
+
+	if (lru_gen_del_page(lruvec, page))
+		return;
+
 	mem_cgroup_update_lru_size(lruvec, lru, -nr_pages);
 	list_del(&page->lru);
 	__mod_zone_page_state(lruvec_zone(lruvec), NR_LRU_BASE + lru, -nr_pages);
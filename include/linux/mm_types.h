@@ -8,6 +8,7 @@
 #include <linux/spinlock.h>
 #include <linux/rbtree.h>
 #include <linux/rwsem.h>
+#include <linux/seqlock.h>
 #include <linux/stacktrace.h>
 #include <linux/completion.h>
 #include <linux/cpumask.h>
@@ -289,6 +290,9 @@ struct vm_area_struct {
 					   units, *not* PAGE_CACHE_SIZE */
 	struct file * vm_file;		/* File we map to (can be NULL). */
 	void * vm_private_data;		/* was vm_pte (shared mem) */
+#ifdef CONFIG_SWAP
+	atomic_long_t swap_readahead_info;	/* see mm/swap_state.c */
+#endif
 
 #ifndef CONFIG_MMU
 	struct vm_region *vm_region;	/* NOMMU mapping region */
@@ -296,6 +300,11 @@ struct vm_area_struct {
 #ifdef CONFIG_NUMA
 	struct mempolicy *vm_policy;	/* NUMA policy for the VMA */
 #endif
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	seqcount_t vm_sequence;		/* bumped around changes seen by
+					 * speculative faults */
+	atomic_t vm_ref_count;		/* see get_vma() */
+#endif
 };
 
 struct core_thread {
@@ -332,6 +341,9 @@ struct mm_rss_stat {
 struct mm_struct {
 	struct vm_area_struct * mmap;		/* list of VMAs */
 	struct rb_root mm_rb;
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	rwlock_t mm_rb_lock;			/* mm_rb against get_vma() */
+#endif
 	struct vm_area_struct * mmap_cache;	/* last find_vma result */
 #ifdef CONFIG_MMU
 	unsigned long (*get_unmapped_area) (struct file *filp,
@@ -357,6 +369,15 @@ struct mm_struct {
 						 * together off init_mm.mmlist, and are protected
 						 * by mmlist_lock
 						 */
+#ifdef CONFIG_LRU_GEN
+	struct list_head lru_gen_list;		/* mm's walked by LRU aging */
+#endif
+#ifdef CONFIG_KSM
+	/* Serialized by ksm_thread_mutex, see /proc/<pid>/ksm_stat */
+	unsigned long ksm_rmap_items;		/* pages tracked by ksmd */
+	unsigned long ksm_merging_pages;	/* pages mapping a ksm page */
+	unsigned long ksm_zero_pages_merged;	/* pages merged into zero page */
+#endif
 
 
 	unsigned long hiwater_rss;	/* High-watermark of RSS usage */
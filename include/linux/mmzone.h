@@ -151,6 +151,8 @@ enum zone_stat_item {
 	NUMA_LOCAL,		/* allocation from local node */
 	NUMA_OTHER,		/* allocation from other node */
 #endif
+	WORKINGSET_REFAULT,	/* evicted file pages faulted back in */
+	WORKINGSET_ACTIVATE,	/* refaults activated, see mm/workingset.c */
 	NR_ANON_TRANSPARENT_HUGEPAGES,
 	NR_FREE_CMA_PAGES,
 #if defined(CONFIG_CMA_PAGE_COUNTING)
@@ -216,9 +218,51 @@ struct zone_reclaim_stat {
 	unsigned long		recent_scanned[2];
 };
 
+#ifdef CONFIG_LRU_GEN
+/*
+ * The multi-generational LRU sorts the evictable pages of a lruvec into
+ * generations by the time they were last found to be accessed, instead
+ * of keeping them on the active and inactive lists. Aging creates a new
+ * youngest generation after harvesting the accessed bits of the page
+ * tables; eviction takes pages from the oldest generation. A page's
+ * generation is stored in page->flags (see LRU_GEN_MASK), and the oldest
+ * generation may only be retired once its list is empty.
+ *
+ * The two youngest generations are reported as active, the rest as
+ * inactive, so that NR_ACTIVE_* and NR_INACTIVE_* keep their meaning.
+ */
+#define MIN_NR_GENS		2U
+#define MAX_NR_GENS		4U
+
+struct lru_gen_struct {
+	/* the sequence number of the youngest generation */
+	unsigned long		max_seq;
+	/* the sequence numbers of the oldest anon and file generations */
+	unsigned long		min_seq[2];
+	/* pages by generation (seq % MAX_NR_GENS) and type (anon, file) */
+	struct list_head	lists[MAX_NR_GENS][2];
+	long			nr_pages[MAX_NR_GENS][2];
+	/*
+	 * Eviction feedback: pages reclaimed from the oldest generation and
+	 * pages that had to be protected because they turned out to be in
+	 * use, for the current and as a decaying average of the previous
+	 * oldest generations.
+	 */
+	unsigned long		evicted[2];
+	unsigned long		protected[2];
+	unsigned long		avg_evicted[2];
+	unsigned long		avg_protected[2];
+	/* whether evictable pages of this lruvec go on the lists above */
+	bool			enabled;
+};
+#endif
+
 struct lruvec {
 	struct list_head lists[NR_LRU_LISTS];
 	struct zone_reclaim_stat reclaim_stat;
+#ifdef CONFIG_LRU_GEN
+	struct lru_gen_struct lrugen;
+#endif
 #ifdef CONFIG_MEMCG
 	struct zone *zone;
 #endif
@@ -414,6 +458,9 @@ struct zone {
 	unsigned long		pages_scanned;	   /* since last reclaim */
 	unsigned long		flags;		   /* zone flags, see below */
 
+	/* Evictions & activations on the inactive file list */
+	atomic_long_t		inactive_age;
+
 	/* Zone statistics */
 	atomic_long_t		vm_stat[NR_VM_ZONE_STAT_ITEMS];
 
@@ -716,6 +763,10 @@ extern struct page *mem_map;
  * per-zone basis.
  */
 struct bootmem_data;
+
+/* upper limit for vm.kswapd_threads */
+#define MAX_KSWAPD_THREADS	16
+
 typedef struct pglist_data {
 	struct zone node_zones[MAX_NR_ZONES];
 	struct zonelist node_zonelists[MAX_ZONELISTS];
@@ -747,7 +798,9 @@ typedef struct pglist_data {
 	nodemask_t reclaim_nodes;	/* Nodes allowed to reclaim from */
 	wait_queue_head_t kswapd_wait;
 	wait_queue_head_t pfmemalloc_wait;
-	struct task_struct *kswapd;	/* Protected by lock_memory_hotplug() */
+	/* Protected by kswapd_threads_lock in mm/vmscan.c */
+	struct task_struct *kswapd[MAX_KSWAPD_THREADS];
+	/* taken by whichever kswapd thread wakes up first */
 	int kswapd_max_order;
 	enum zone_type classzone_idx;
 #ifdef CONFIG_NUMA_BALANCING
@@ -805,6 +858,9 @@ extern int init_currently_empty_zone(struct zone *zone, unsigned long start_pfn,
 				     enum memmap_context context);
 
 extern void lruvec_init(struct lruvec *lruvec);
+#ifdef CONFIG_LRU_GEN
+extern void lru_gen_init_lruvec(struct lruvec *lruvec);
+#endif
 
 static inline struct zone *lruvec_zone(struct lruvec *lruvec)
 {
@@ -912,6 +968,12 @@ static inline int is_dma(struct zone *zone)
 struct ctl_table;
 int min_free_kbytes_sysctl_handler(struct ctl_table *, int,
 					void __user *, size_t *, loff_t *);
+extern int watermark_scale_factor;
+int watermark_scale_factor_sysctl_handler(struct ctl_table *, int,
+					void __user *, size_t *, loff_t *);
+extern int kswapd_threads;
+int kswapd_threads_sysctl_handler(struct ctl_table *, int,
+					void __user *, size_t *, loff_t *);
 extern int sysctl_lowmem_reserve_ratio[MAX_NR_ZONES-1];
 int lowmem_reserve_ratio_sysctl_handler(struct ctl_table *, int,
 					void __user *, size_t *, loff_t *);
@@ -27,6 +27,9 @@
 #endif
 
 #include <linux/types.h>
+#include <linux/seqlock.h>
+#include <linux/uidgid.h>
+#include <linux/wakeup_stats.h>
 
 /**
  * struct wakeup_source - Representation of wakeup sources
@@ -40,6 +43,9 @@
  * @relax_count: Number of times the wakeup sorce was deactivated.
  * @expire_count: Number of times the wakeup source's timeout has expired.
  * @wakeup_count: Number of times the wakeup source might abort suspend.
+ * @seq: Lets the statistics be read without taking @lock.
+ * @uid: UID that takes a user space wakelock, each UID has its own source.
+ * @hold_hist: Histogram of the durations the source was held active for.
  * @active: Status of the wakeup source.
  * @has_timeout: The wakeup source has been activated with a timeout.
  */
@@ -59,6 +65,9 @@ struct wakeup_source {
 	unsigned long		relax_count;
 	unsigned long		expire_count;
 	unsigned long		wakeup_count;
+	seqcount_t		seq;
+	kuid_t			uid;
+	unsigned long		hold_hist[WAKEUP_STATS_HIST_BUCKETS];
 	bool			active:1;
 	bool			autosleep_enabled:1;
 };
@@ -29,6 +29,7 @@
 #define _LINUX_POWERSUSPEND_H
 
 #include <linux/list.h>
+#include <linux/workqueue.h>
 
 #define POWER_SUSPEND_INACTIVE	0
 #define POWER_SUSPEND_ACTIVE	1
@@ -36,10 +37,29 @@
 #define POWER_SUSPEND_USERSPACE	1	// Use fauxclock as trigger
 #define POWER_SUSPEND_PANEL	2	// Use display panel state as hook
 
+/*
+ * Handlers run by increasing level on suspend and by decreasing level on
+ * resume; a level only starts once all handlers of the previous one are
+ * done.  Within a level, handlers that set parallel run concurrently on
+ * the power_suspend worker threads, the others one after the other in
+ * registration order (reversed on resume).
+ */
+#define POWER_SUSPEND_LEVEL_DEFAULT	0
+
 struct power_suspend {
 	struct list_head link;
+	int level;
+	bool parallel;
+	const char *name;	/* shown in power_suspend_stats */
 	void (*suspend)(struct power_suspend *h);
 	void (*resume)(struct power_suspend *h);
+
+	/* owned by the power_suspend core */
+	struct work_struct work;
+	unsigned int last_suspend_us;
+	unsigned int max_suspend_us;
+	unsigned int last_resume_us;
+	unsigned int max_resume_us;
 };
 
 void register_power_suspend(struct power_suspend *handler);
@@ -471,6 +471,22 @@ struct thread_group_cputimer {
 #include <linux/rwsem.h>
 struct autogroup;
 
+#ifdef CONFIG_RECLAIM_LATENCY_HIST
+/*
+ * Direct reclaim stalls of a thread group: count[0] covers stalls under
+ * 128us, count[i] those in [64us << i, 128us << i) and the last bucket
+ * everything longer.  Shown in /proc/<pid>/reclaim_latency.
+ */
+#define RECLAIM_LAT_BUCKETS	12
+#define RECLAIM_LAT_MIN_SHIFT	7
+
+struct reclaim_latency {
+	atomic_t	count[RECLAIM_LAT_BUCKETS];
+	atomic64_t	total_us;
+	unsigned int	max_us;
+};
+#endif
+
 /*
  * NOTE! "signal_struct" does not have its own
  * locking, because a shared signal_struct always
@@ -572,6 +588,9 @@ struct signal_struct {
 	unsigned long inblock, oublock, cinblock, coublock;
 	unsigned long maxrss, cmaxrss;
 	struct task_io_accounting ioac;
+#ifdef CONFIG_RECLAIM_LATENCY_HIST
+	struct reclaim_latency reclaim_lat;
+#endif
 
 	/*
 	 * Cumulative ns of schedule CPU time fo dead threads in the
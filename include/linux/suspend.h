@@ -69,6 +69,19 @@ struct suspend_stats {
 	int	errno[REC_FAILED_NUM];
 	int	last_failed_step;
 	enum suspend_stat_step	failed_steps[REC_FAILED_NUM];
+	/* freezing and thawing of tasks, last cycle and all cycles */
+	unsigned int	last_freeze_usecs;
+	unsigned int	last_thaw_usecs;
+	u64	total_freeze_usecs;
+	u64	total_thaw_usecs;
+	/* tasks that were not frozen after the first pass, last cycle */
+#define	REC_FREEZE_LAGGARDS	4
+	int	nr_freeze_laggards;
+	struct {
+		pid_t		pid;
+		char		comm[16];
+		unsigned int	usecs;	/* still not frozen after this long */
+	} freeze_laggards[REC_FREEZE_LAGGARDS];
 };
 
 extern struct suspend_stats suspend_stats;
@@ -63,7 +63,8 @@ struct udp_sock {
 #define UDPLITE_SEND_CC  0x2  		/* set via udplite setsockopt         */
 #define UDPLITE_RECV_CC  0x4		/* set via udplite setsocktopt        */
 	__u8		 pcflag;        /* marks socket as UDP-Lite if > 0    */
-	__u8		 unused[3];
+	__u8		 gro_enabled;	/* Can accept GRO packets             */
+	__u16		 gso_size;	/* UDP_SEGMENT size, 0 if disabled    */
 	/*
 	 * For encapsulation sockets.
 	 */
@@ -71,6 +72,8 @@ struct udp_sock {
 	void (*encap_destroy)(struct sock *sk);
 };
 
+#define UDP_MAX_SEGMENTS	(1 << 6UL)
+
 static inline struct udp_sock *udp_sk(const struct sock *sk)
 {
 	return (struct udp_sock *)sk;
@@ -33,6 +33,16 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		PGSCAN_DIRECT_THROTTLE,
 #ifdef CONFIG_NUMA
 		PGSCAN_ZONE_RECLAIM_FAILED,
+#endif
+#ifdef CONFIG_PROCESS_RECLAIM
+		PGSCAN_PROCESS, PGSTEAL_PROCESS,
+#endif
+#ifdef CONFIG_LRU_GEN
+		LRU_GEN_AGING,		/* new generations created */
+		LRU_GEN_WALK_PTE,	/* ptes looked at by aging */
+		LRU_GEN_WALK_YOUNG,	/* pages aging moved to the youngest gen */
+		LRU_GEN_EVICT_ANON, LRU_GEN_EVICT_FILE,
+		LRU_GEN_PROTECTED,	/* pages found in use at eviction */
 #endif
 		PGINODESTEAL, SLABS_SCANNED, KSWAPD_INODESTEAL,
 		KSWAPD_LOW_WMARK_HIT_QUICKLY, KSWAPD_HIGH_WMARK_HIT_QUICKLY,
@@ -51,6 +61,7 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		COMPACTMIGRATE_SCANNED, COMPACTFREE_SCANNED,
 		COMPACTISOLATED,
 		COMPACTSTALL, COMPACTFAIL, COMPACTSUCCESS,
+		KCOMPACTD_WAKE, COMPACTPROACTIVE, COMPACTPROACTIVESUCCESS,
 #endif
 #ifdef CONFIG_HUGETLB_PAGE
 		HTLB_BUDDY_PGALLOC, HTLB_BUDDY_PGALLOC_FAIL,
@@ -70,6 +81,16 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		THP_SPLIT,
 		THP_ZERO_PAGE_ALLOC,
 		THP_ZERO_PAGE_ALLOC_FAILED,
+#endif
+#ifdef CONFIG_SWAP
+		SWAP_RA,
+		SWAP_RA_HIT,
+#endif
+		VMAP_PURGE, VMAP_PURGE_PAGES,
+		VMAP_PURGE_FLUSH, VMAP_PURGE_FLUSH_RANGED, VMAP_PURGE_FLUSH_PAGES,
+		VMAP_CACHE_HIT,
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+		SPECULATIVE_PGFAULT, SPECULATIVE_PGFAULT_ABORT,
 #endif
 		NR_VM_EVENT_ITEMS
 };
@@ -18,6 +18,9 @@
 #ifndef _LINUX_WAKEUP_REASON_H
 #define _LINUX_WAKEUP_REASON_H
 
+#include <linux/uidgid.h>
+
 void log_wakeup_reason(int irq);
+void log_wakeup_reason_uid(const char *source, kuid_t uid);
 
 #endif /* _LINUX_WAKEUP_REASON_H */
@@ -105,6 +105,9 @@ struct work_struct {
 #ifdef CONFIG_LOCKDEP
 	struct lockdep_map lockdep_map;
 #endif
+#ifdef CONFIG_WQ_LATENCY_STATS
+	u64 queue_time;		/* local_clock() when last queued */
+#endif
 };
 
 #define WORK_DATA_INIT()	ATOMIC_LONG_INIT(WORK_STRUCT_NO_POOL)
@@ -202,6 +205,12 @@ static inline void destroy_work_on_stack(struct work_struct *work) { }
 static inline unsigned int work_static(struct work_struct *work) { return 0; }
 #endif
 
+#ifdef CONFIG_WQ_LATENCY_STATS
+#define __INIT_WORK_QUEUE_TIME(_work)	((_work)->queue_time = 0)
+#else
+#define __INIT_WORK_QUEUE_TIME(_work)	do { } while (0)
+#endif
+
 /*
  * initialize all of a work item in one go
  *
@@ -217,6 +226,7 @@ static inline unsigned int work_static(struct work_struct *work) { return 0; }
 		__init_work((_work), _onstack);				\
 		(_work)->data = (atomic_long_t) WORK_DATA_INIT();	\
 		lockdep_init_map(&(_work)->lockdep_map, #_work, &__key, 0); \
+		__INIT_WORK_QUEUE_TIME(_work);				\
 		INIT_LIST_HEAD(&(_work)->entry);			\
 		PREPARE_WORK((_work), (_func));				\
 	} while (0)
@@ -225,6 +235,7 @@ static inline unsigned int work_static(struct work_struct *work) { return 0; }
 	do {								\
 		__init_work((_work), _onstack);				\
 		(_work)->data = (atomic_long_t) WORK_DATA_INIT();	\
+		__INIT_WORK_QUEUE_TIME(_work);				\
 		INIT_LIST_HEAD(&(_work)->entry);			\
 		PREPARE_WORK((_work), (_func));				\
 	} while (0)
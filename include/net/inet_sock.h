@@ -113,6 +113,7 @@ struct inet_cork {
 	int			length; /* Total length of all frames */
 	struct dst_entry	*dst;
 	u8			tx_flags;
+	u16			gso_size;
 };
 
 struct inet_cork_full {
@@ -0,0 +1,84 @@
+/*
+ * Wakeup-aware receive batching
+ *
+ * While the device is in its screen-off power state, low priority frames
+ * received by a participating driver are parked on a per-device queue
+ * instead of being handed to the stack. The queue is delivered in one go
+ * when the batching window expires, when it fills up, when a high
+ * priority frame arrives on the same device or when the screen comes back
+ * on, so that a burst of push traffic costs one full resume instead of
+ * one per packet.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+#ifndef _NET_WAKE_BATCH_H
+#define _NET_WAKE_BATCH_H
+
+#include <linux/list.h>
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+
+struct sock;
+
+struct net_wake_batch {
+	struct sk_buff_head	queue;
+	struct list_head	list;
+	struct net_device	*dev;
+	/* statistics, reported through /proc/net/wake_batch */
+	unsigned long		queued;
+	unsigned long		direct;
+	unsigned long		flushes;
+};
+
+#ifdef CONFIG_NET_WAKE_BATCH
+
+extern unsigned int sysctl_net_wake_batch_ms;
+extern unsigned int sysctl_net_wake_batch_pkts;
+extern unsigned int sysctl_net_wake_batch_prio;
+
+extern void net_wake_batch_register(struct net_wake_batch *wb,
+				    struct net_device *dev);
+extern void net_wake_batch_unregister(struct net_wake_batch *wb);
+extern bool net_wake_batch_rx(struct net_wake_batch *wb, struct sk_buff *skb);
+extern void __net_wake_batch_attribute(struct sock *sk, struct sk_buff *skb);
+
+/* called when a received skb is charged to its socket */
+static inline void net_wake_batch_attribute(struct sock *sk,
+					    struct sk_buff *skb)
+{
+	if (unlikely(skb->wake_batch))
+		__net_wake_batch_attribute(sk, skb);
+}
+
+#else /* CONFIG_NET_WAKE_BATCH */
+
+static inline void net_wake_batch_register(struct net_wake_batch *wb,
+					   struct net_device *dev)
+{
+}
+
+static inline void net_wake_batch_unregister(struct net_wake_batch *wb)
+{
+}
+
+static inline bool net_wake_batch_rx(struct net_wake_batch *wb,
+				     struct sk_buff *skb)
+{
+	if (in_interrupt())
+		netif_rx(skb);
+	else
+		netif_rx_ni(skb);
+	return true;
+}
+
+static inline void net_wake_batch_attribute(struct sock *sk,
+					    struct sk_buff *skb)
+{
+}
+
+#endif /* CONFIG_NET_WAKE_BATCH */
+#endif /* _NET_WAKE_BATCH_H */
@@ -0,0 +1,43 @@
+#ifndef _UAPI_TRACE_MMAP_H_
+#define _UAPI_TRACE_MMAP_H_
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/*
+ * Layout of a mapped per_cpu/cpuN/trace_pipe_raw file: page 0 is the
+ * struct trace_buffer_meta below, followed by nr_subbufs pages of ring
+ * buffer data, each starting with the usual buffer_data_page header
+ * (timestamp, commit) as described in events/header_page. Sub-buffer N
+ * lives at offset (N + 1) * meta_page_size.
+ *
+ * The kernel hands one sub-buffer at a time to the reader. Calling
+ * TRACE_MMAP_IOCTL_GET_READER marks the current reader sub-buffer as
+ * consumed and publishes the next one in reader.{id,read,commit}: the
+ * events between offsets read and commit of its data are new. The
+ * previous reader sub-buffer goes back to the writer and must not be
+ * looked at anymore. An empty buffer leaves reader.read == reader.commit.
+ */
+struct trace_buffer_meta {
+	__u32	meta_page_size;
+	__u32	meta_struct_len;
+
+	__u32	subbuf_size;
+	__u32	nr_subbufs;
+
+	struct {
+		__u64	lost_events;
+		__u32	id;
+		__u32	read;
+		__u32	commit;
+		__u32	__reserved;
+	} reader;
+
+	__u64	entries;
+	__u64	overrun;
+	__u64	read;
+};
+
+#define TRACE_MMAP_IOCTL_GET_READER	_IO('R', 0x20)
+
+#endif /* _UAPI_TRACE_MMAP_H_ */
@@ -0,0 +1,49 @@
+#ifndef _UAPI_LINUX_WAKEUP_STATS_H
+#define _UAPI_LINUX_WAKEUP_STATS_H
+
+#include <linux/types.h>
+
+/*
+ * Binary form of the wakeup source statistics, as read from
+ * /sys/kernel/debug/wakeup_sources_bin: one header followed by one
+ * record per wakeup source until the end of the file.  Readers must use
+ * record_size to step over records, fields may be added at the end.
+ */
+
+#define WAKEUP_STATS_MAGIC		0x57534254	/* "WSBT" */
+#define WAKEUP_STATS_VERSION		1
+
+#define WAKEUP_STATS_NAME_LEN		32
+
+/*
+ * Hold durations are counted in power of two buckets: bucket 0 counts
+ * holds shorter than 1 ms, bucket n holds of [2^(n-1), 2^n) ms and the
+ * last one everything longer.
+ */
+#define WAKEUP_STATS_HIST_BUCKETS	16
+
+struct wakeup_stats_header {
+	__u32	magic;
+	__u32	version;
+	__u32	record_size;
+	__u32	hist_buckets;
+	__u64	now_ms;			/* monotonic clock at the time of reading */
+};
+
+struct wakeup_stats_record {
+	char	name[WAKEUP_STATS_NAME_LEN];
+	__u32	uid;			/* last locker of a user space wakelock */
+	__u32	active;
+	__u64	active_count;
+	__u64	event_count;
+	__u64	wakeup_count;
+	__u64	expire_count;
+	__u64	active_time_ms;
+	__u64	total_time_ms;
+	__u64	max_time_ms;
+	__u64	last_change_ms;
+	__u64	prevent_sleep_time_ms;
+	__u64	hold_hist[WAKEUP_STATS_HIST_BUCKETS];
+};
+
+#endif /* _UAPI_LINUX_WAKEUP_STATS_H */
@@ -336,6 +336,58 @@ static void freeze_cgroup(struct freezer *freezer)
 	cgroup_iter_end(cgroup, &it);
 }
 
+/**
+ * cgroup_freezer_walk_unfrozen - call a function on tasks of unfrozen cgroups
+ * @fn: function to call for each task, must not sleep
+ * @data: argument passed to @fn
+ *
+ * Used by the system freezer to skip the tasks of FROZEN cgroups, which
+ * stay in the refrigerator whatever the system freezer does.  Returns
+ * %false without calling @fn if the freezer hierarchy has no cgroups
+ * besides the root, in which case walking the task list is just as good.
+ *
+ * FROZEN is only updated when freezer.state is read, so a cgroup that has
+ * finished freezing but has not been looked at since is still walked.
+ *
+ * css_set_lock is only held for one cgroup at a time, so a task moving
+ * from a cgroup not walked yet to one already walked is missed.  Callers
+ * that need to see every task must confirm with a walk of the task list.
+ */
+bool cgroup_freezer_walk_unfrozen(void (*fn)(struct task_struct *, void *),
+				  void *data)
+{
+	struct cgroup *root, *pos;
+	struct cgroup_iter it;
+	struct task_struct *task;
+
+	rcu_read_lock();
+	root = task_freezer(&init_task)->css.cgroup;
+	if (list_empty(&root->children)) {
+		rcu_read_unlock();
+		return false;
+	}
+
+	pos = root;
+	while (pos) {
+		if (cgroup_freezer(pos)->state & CGROUP_FROZEN) {
+			/* FROZEN covers the descendants too */
+			pos = cgroup_rightmost_descendant(pos);
+			pos = cgroup_next_descendant_pre(pos, root);
+			continue;
+		}
+
+		cgroup_iter_start(pos, &it);
+		while ((task = cgroup_iter_next(pos, &it)))
+			fn(task, data);
+		cgroup_iter_end(pos, &it);
+
+		pos = cgroup_next_descendant_pre(pos, root);
+	}
+	rcu_read_unlock();
+
+	return true;
+}
+
 static void unfreeze_cgroup(struct freezer *freezer)
 {
 	struct cgroup *cgroup = freezer->css.cgroup;
@@ -0,0 +1,114 @@
+/*
+ * cgroup_timer_slack.c - control group timer slack subsystem
+ *
+ * Tasks attached to a cgroup get its timer_slack.timer_slack_ns as both
+ * their current and default timer slack, the value PR_SET_TIMERSLACK
+ * would otherwise set. That slack is applied to their nanosleep(),
+ * poll()/select(), epoll and futex timeouts and to their
+ * schedule_timeout() sleeps, so putting background tasks in a cgroup with a slack
+ * of some milliseconds lets their timers expire together instead of
+ * waking idle CPUs one by one.
+ *
+ * A new cgroup starts with the slack of its parent. Changing the value
+ * applies it to the tasks in the cgroup, but not to those in its
+ * children. Tasks may still change their own slack with prctl().
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/cgroup.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+struct timer_slack_cgroup {
+	struct cgroup_subsys_state	css;
+	unsigned long			timer_slack_ns;
+};
+
+static inline struct timer_slack_cgroup *cgroup_timer_slack(struct cgroup *cgrp)
+{
+	return container_of(cgroup_subsys_state(cgrp, timer_slack_subsys_id),
+			    struct timer_slack_cgroup, css);
+}
+
+static void timer_slack_set_task(struct task_struct *task, unsigned long slack)
+{
+	task->timer_slack_ns = slack;
+	task->default_timer_slack_ns = slack;
+}
+
+static struct cgroup_subsys_state *timer_slack_css_alloc(struct cgroup *cgrp)
+{
+	struct timer_slack_cgroup *tslack;
+
+	tslack = kzalloc(sizeof(*tslack), GFP_KERNEL);
+	if (!tslack)
+		return ERR_PTR(-ENOMEM);
+
+	if (cgrp->parent)
+		tslack->timer_slack_ns =
+			cgroup_timer_slack(cgrp->parent)->timer_slack_ns;
+	else
+		tslack->timer_slack_ns = init_task.timer_slack_ns;
+
+	return &tslack->css;
+}
+
+static void timer_slack_css_free(struct cgroup *cgrp)
+{
+	kfree(cgroup_timer_slack(cgrp));
+}
+
+static void timer_slack_attach(struct cgroup *cgrp,
+			       struct cgroup_taskset *tset)
+{
+	struct timer_slack_cgroup *tslack = cgroup_timer_slack(cgrp);
+	unsigned long slack = ACCESS_ONCE(tslack->timer_slack_ns);
+	struct task_struct *task;
+
+	cgroup_taskset_for_each(task, cgrp, tset)
+		timer_slack_set_task(task, slack);
+}
+
+static u64 timer_slack_read(struct cgroup *cgrp, struct cftype *cft)
+{
+	return cgroup_timer_slack(cgrp)->timer_slack_ns;
+}
+
+static int timer_slack_write(struct cgroup *cgrp, struct cftype *cft, u64 val)
+{
+	struct cgroup_iter it;
+	struct task_struct *task;
+
+	if (val > ULONG_MAX)
+		return -EINVAL;
+
+	ACCESS_ONCE(cgroup_timer_slack(cgrp)->timer_slack_ns) = val;
+
+	cgroup_iter_start(cgrp, &it);
+	while ((task = cgroup_iter_next(cgrp, &it)))
+		timer_slack_set_task(task, val);
+	cgroup_iter_end(cgrp, &it);
+
+	return 0;
+}
+
+static struct cftype files[] = {
+	{
+		.name = "timer_slack_ns",
+		.read_u64 = timer_slack_read,
+		.write_u64 = timer_slack_write,
+	},
+	{ }	/* terminate */
+};
+
+struct cgroup_subsys timer_slack_subsys = {
+	.name		= "timer_slack",
+	.css_alloc	= timer_slack_css_alloc,
+	.css_free	= timer_slack_css_free,
+	.subsys_id	= timer_slack_subsys_id,
+	.attach		= timer_slack_attach,
+	.base_cftypes	= files,
+};
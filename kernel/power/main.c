@@ -219,6 +219,20 @@ static int suspend_stats_show(struct seq_file *s, void *unused)
 			suspend_step_name(
 				suspend_stats.failed_steps[index]));
 	}
+	seq_printf(s, "freezer:\n  last_freeze_usecs:\t%u\n"
+			"  last_thaw_usecs:\t%u\n"
+			"  total_freeze_usecs:\t%llu\n"
+			"  total_thaw_usecs:\t%llu\n",
+			suspend_stats.last_freeze_usecs,
+			suspend_stats.last_thaw_usecs,
+			suspend_stats.total_freeze_usecs,
+			suspend_stats.total_thaw_usecs);
+	seq_puts(s, "  freeze_laggards:\n");
+	for (i = 0; i < suspend_stats.nr_freeze_laggards; i++)
+		seq_printf(s, "\t\t\t%s (%d) %u usecs\n",
+			suspend_stats.freeze_laggards[i].comm,
+			suspend_stats.freeze_laggards[i].pid,
+			suspend_stats.freeze_laggards[i].usecs);
 
 	return 0;
 }
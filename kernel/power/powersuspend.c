@@ -20,6 +20,9 @@
  *
  *  v1.7 - do only run state change if change actually requests a new state
  *
+ *  v1.8 - order handlers by level, run parallel handlers concurrently,
+ *         per-handler latency statistics
+ *
  * This software is licensed under the terms of the GNU General Public
  * License version 2, as published by the Free Software Foundation, and
  * may be copied, distributed, and modified under those terms.
@@ -35,14 +38,21 @@
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/workqueue.h>
+#include <linux/ktime.h>
+#include <linux/kallsyms.h>
 
 #define MAJOR_VERSION	1
-#define MINOR_VERSION	7
+#define MINOR_VERSION	8
 
 bool flg_power_suspended = false;
 struct timeval time_power_suspended;
 struct timeval time_power_resumed;
 struct workqueue_struct *suspend_work_queue;
+/* runs the parallel handlers of a level */
+static struct workqueue_struct *power_suspend_par_wq;
+static bool par_suspending;
+static unsigned int last_suspend_total_us;
+static unsigned int last_resume_total_us;
 
 static DEFINE_MUTEX(power_suspend_lock);
 static LIST_HEAD(power_suspend_handlers);
@@ -55,14 +65,47 @@ static DEFINE_SPINLOCK(state_lock);
 static int state; // Yank555.lu : Current powersave state (screen on / off)
 static int mode;  // Yank555.lu : Current powersave mode  (userspace / panel)
 
+static void power_suspend_run(struct power_suspend *h, bool suspend)
+{
+	ktime_t start = ktime_get();
+	unsigned int usecs;
+
+	if (suspend)
+		h->suspend(h);
+	else
+		h->resume(h);
+
+	usecs = ktime_us_delta(ktime_get(), start);
+	if (suspend) {
+		h->last_suspend_us = usecs;
+		if (usecs > h->max_suspend_us)
+			h->max_suspend_us = usecs;
+	} else {
+		h->last_resume_us = usecs;
+		if (usecs > h->max_resume_us)
+			h->max_resume_us = usecs;
+	}
+}
+
+static void power_suspend_par_work(struct work_struct *work)
+{
+	struct power_suspend *h = container_of(work, struct power_suspend, work);
+
+	power_suspend_run(h, par_suspending);
+}
+
 void register_power_suspend(struct power_suspend *handler)
 {
 	struct list_head *pos;
 
+	INIT_WORK(&handler->work, power_suspend_par_work);
+
 	mutex_lock(&power_suspend_lock);
 	list_for_each(pos, &power_suspend_handlers) {
 		struct power_suspend *p;
 		p = list_entry(pos, struct power_suspend, link);
+		if (p->level > handler->level)
+			break;
 	}
 	list_add_tail(&handler->link, pos);
 	mutex_unlock(&power_suspend_lock);
@@ -81,6 +124,7 @@ static void power_suspend(struct work_struct *work)
 {
 	struct power_suspend *pos;
 	unsigned long irqflags;
+	ktime_t start;
 	int abort = 0;
 
 	#ifdef CONFIG_POWERSUSPEND_DEBUG
@@ -100,11 +144,22 @@ static void power_suspend(struct work_struct *work)
 	#ifdef CONFIG_POWERSUSPEND_DEBUG
 	pr_info("[POWERSUSPEND] suspending...\n");
 	#endif
+	start = ktime_get();
+	par_suspending = true;
 	list_for_each_entry(pos, &power_suspend_handlers, link) {
-		if (pos->suspend != NULL) {
-			pos->suspend(pos);
-		}
+		if (pos->suspend == NULL)
+			continue;
+		if (pos->link.prev != &power_suspend_handlers &&
+		    list_entry(pos->link.prev, struct power_suspend,
+			       link)->level != pos->level)
+			flush_workqueue(power_suspend_par_wq);
+		if (pos->parallel)
+			queue_work(power_suspend_par_wq, &pos->work);
+		else
+			power_suspend_run(pos, true);
 	}
+	flush_workqueue(power_suspend_par_wq);
+	last_suspend_total_us = ktime_us_delta(ktime_get(), start);
 	#ifdef CONFIG_POWERSUSPEND_DEBUG
 	pr_info("[POWERSUSPEND] suspend completed.\n");
 	#endif
@@ -116,6 +171,7 @@ static void power_resume(struct work_struct *work)
 {
 	struct power_suspend *pos;
 	unsigned long irqflags;
+	ktime_t start;
 	int abort = 0;
 
 	#ifdef CONFIG_POWERSUSPEND_DEBUG
@@ -135,11 +191,22 @@ static void power_resume(struct work_struct *work)
 	#ifdef CONFIG_POWERSUSPEND_DEBUG
 	pr_info("[POWERSUSPEND] resuming...\n");
 	#endif
+	start = ktime_get();
+	par_suspending = false;
 	list_for_each_entry_reverse(pos, &power_suspend_handlers, link) {
-		if (pos->resume != NULL) {
-			pos->resume(pos);
-		}
+		if (pos->resume == NULL)
+			continue;
+		if (pos->link.next != &power_suspend_handlers &&
+		    list_entry(pos->link.next, struct power_suspend,
+			       link)->level != pos->level)
+			flush_workqueue(power_suspend_par_wq);
+		if (pos->parallel)
+			queue_work(power_suspend_par_wq, &pos->work);
+		else
+			power_suspend_run(pos, false);
 	}
+	flush_workqueue(power_suspend_par_wq);
+	last_resume_total_us = ktime_us_delta(ktime_get(), start);
 	#ifdef CONFIG_POWERSUSPEND_DEBUG
 	pr_info("[POWERSUSPEND] resume completed.\n");
 	#endif
@@ -271,11 +338,51 @@ static struct kobj_attribute power_suspend_version_attribute =
 		power_suspend_version_show,
 		NULL);
 
+static ssize_t power_suspend_stats_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct power_suspend *pos;
+	char sym[KSYM_SYMBOL_LEN];
+	ssize_t len;
+
+	len = scnprintf(buf, PAGE_SIZE, "total suspend %u us resume %u us\n"
+			"%-32s %5s %3s %10s %10s %10s %10s\n",
+			last_suspend_total_us, last_resume_total_us,
+			"handler", "level", "par", "susp_us", "susp_max",
+			"resume_us", "resume_max");
+
+	mutex_lock(&power_suspend_lock);
+	list_for_each_entry(pos, &power_suspend_handlers, link) {
+		const char *name = pos->name;
+
+		if (!name) {
+			sprint_symbol_no_offset(sym, pos->suspend ?
+				(unsigned long)pos->suspend :
+				(unsigned long)pos->resume);
+			name = sym;
+		}
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "%-32s %5d %3d %10u %10u %10u %10u\n",
+				 name, pos->level, pos->parallel,
+				 pos->last_suspend_us, pos->max_suspend_us,
+				 pos->last_resume_us, pos->max_resume_us);
+	}
+	mutex_unlock(&power_suspend_lock);
+
+	return len;
+}
+
+static struct kobj_attribute power_suspend_stats_attribute =
+	__ATTR(power_suspend_stats, 0444,
+		power_suspend_stats_show,
+		NULL);
+
 static struct attribute *power_suspend_attrs[] =
 {
 	&power_suspend_state_attribute.attr,
 	&power_suspend_mode_attribute.attr,
 	&power_suspend_version_attribute.attr,
+	&power_suspend_stats_attribute.attr,
 	NULL,
 };
 
@@ -314,6 +421,13 @@ static int __init power_suspend_init(void)
 		return -ENOMEM;
 	}
 
+	power_suspend_par_wq = alloc_workqueue("p-suspend-par",
+					       WQ_UNBOUND | WQ_HIGHPRI, 0);
+	if (power_suspend_par_wq == NULL) {
+		destroy_workqueue(suspend_work_queue);
+		return -ENOMEM;
+	}
+
 //	mode = POWER_SUSPEND_USERSPACE;	// Yank555.lu : Default to userspace mode
 	mode = POWER_SUSPEND_PANEL;	// Yank555.lu : Default to display panel mode
 
@@ -325,6 +439,7 @@ static void __exit power_suspend_exit(void)
 	if (power_suspend_kobj != NULL)
 		kobject_put(power_suspend_kobj);
 
+	destroy_workqueue(power_suspend_par_wq);
 	destroy_workqueue(suspend_work_queue);
 } 
 
@@ -17,28 +17,119 @@
 #include <linux/delay.h>
 #include <linux/workqueue.h>
 #include <linux/kmod.h>
+#include <linux/ktime.h>
+#include <linux/string.h>
 
 /* 
  * Timeout for stopping processes
  */
 unsigned int __read_mostly freeze_timeout_msecs = 20 * MSEC_PER_SEC;
 
+struct freeze_walk {
+	unsigned int		todo;
+	bool			first_pass;
+	unsigned int		elapsed_usecs;
+	struct task_struct	*last;
+};
+
+/*
+ * Walk the tasks the system freezer has to care about, skipping those of
+ * cgroups that are frozen already when the cgroup freezer can tell, unless
+ * @full is set.  Returns true if only unfrozen cgroups were walked: a task
+ * moving into a cgroup that had been visited already may have been missed.
+ */
+static bool freezer_walk_tasks(void (*fn)(struct task_struct *, void *),
+			       void *data, bool full)
+{
+	struct task_struct *g, *p;
+
+	if (!full && cgroup_freezer_walk_unfrozen(fn, data))
+		return true;
+
+	read_lock(&tasklist_lock);
+	do_each_thread(g, p) {
+		fn(p, data);
+	} while_each_thread(g, p);
+	read_unlock(&tasklist_lock);
+	return false;
+}
+
+#ifdef CONFIG_PM_SLEEP
+static void freeze_stats_reset(void)
+{
+	suspend_stats.last_freeze_usecs = 0;
+	suspend_stats.nr_freeze_laggards = 0;
+}
+
+static void freeze_stats_add(unsigned int usecs)
+{
+	suspend_stats.last_freeze_usecs += usecs;
+	suspend_stats.total_freeze_usecs += usecs;
+}
+
+static void thaw_stats_add(unsigned int usecs)
+{
+	suspend_stats.last_thaw_usecs = usecs;
+	suspend_stats.total_thaw_usecs += usecs;
+}
+
+/* Remember a task that did not freeze on the first pass. */
+static void freeze_note_laggard(struct task_struct *p, unsigned int usecs)
+{
+	int i, nr = suspend_stats.nr_freeze_laggards;
+
+	for (i = 0; i < nr; i++) {
+		if (suspend_stats.freeze_laggards[i].pid == p->pid) {
+			suspend_stats.freeze_laggards[i].usecs = usecs;
+			return;
+		}
+	}
+	if (nr == REC_FREEZE_LAGGARDS)
+		return;
+
+	suspend_stats.freeze_laggards[nr].pid = p->pid;
+	strlcpy(suspend_stats.freeze_laggards[nr].comm, p->comm,
+		sizeof(suspend_stats.freeze_laggards[nr].comm));
+	suspend_stats.freeze_laggards[nr].usecs = usecs;
+	suspend_stats.nr_freeze_laggards++;
+}
+#else /* !CONFIG_PM_SLEEP */
+static inline void freeze_stats_reset(void) {}
+static inline void freeze_stats_add(unsigned int usecs) {}
+static inline void thaw_stats_add(unsigned int usecs) {}
+static inline void freeze_note_laggard(struct task_struct *p,
+				       unsigned int usecs) {}
+#endif /* !CONFIG_PM_SLEEP */
+
+static void freeze_one_task(struct task_struct *p, void *data)
+{
+	struct freeze_walk *w = data;
+
+	if (p == current || !freeze_task(p))
+		return;
+
+	if (freezer_should_skip(p))
+		return;
+
+	w->todo++;
+	w->last = p;
+	if (!w->first_pass)
+		freeze_note_laggard(p, w->elapsed_usecs);
+}
+
 static int try_to_freeze_tasks(bool user_only)
 {
+	struct freeze_walk w = { .first_pass = true };
 	struct task_struct *g, *p;
-#ifdef CONFIG_SEC_PM_DEBUG
-	struct task_struct *q;
-#endif
 	unsigned long end_time;
 	unsigned int todo;
 	bool wq_busy = false;
-	struct timeval start, end;
-	u64 elapsed_msecs64;
+	ktime_t start;
 	unsigned int elapsed_msecs;
 	bool wakeup = false;
 	int sleep_usecs = USEC_PER_MSEC;
 
-	do_gettimeofday(&start);
+	start = ktime_get();
 
 	end_time = jiffies + msecs_to_jiffies(freeze_timeout_msecs);
 
@@ -46,20 +137,12 @@ static int try_to_freeze_tasks(bool user_only)
 		freeze_workqueues_begin();
 
 	while (true) {
-		todo = 0;
-		read_lock(&tasklist_lock);
-		do_each_thread(g, p) {
-			if (p == current || !freeze_task(p))
-				continue;
-
-			if (!freezer_should_skip(p)) {
-				todo++;
-#ifdef CONFIG_SEC_PM_DEBUG
-				q = p;
-#endif
-			}
-		} while_each_thread(g, p);
-		read_unlock(&tasklist_lock);
+		w.todo = 0;
+		w.last = NULL;
+		/* confirm an all clear from the cgroup walk on every task */
+		if (freezer_walk_tasks(freeze_one_task, &w, false) && !w.todo)
+			freezer_walk_tasks(freeze_one_task, &w, true);
+		todo = w.todo;
 
 		if (!user_only) {
 			wq_busy = freeze_workqueues_busy();
@@ -82,12 +165,14 @@ static int try_to_freeze_tasks(bool user_only)
 		usleep_range(sleep_usecs / 2, sleep_usecs);
 		if (sleep_usecs < 8 * USEC_PER_MSEC)
 			sleep_usecs *= 2;
+
+		w.first_pass = false;
+		w.elapsed_usecs = ktime_us_delta(ktime_get(), start);
 	}
 
-	do_gettimeofday(&end);
-	elapsed_msecs64 = timeval_to_ns(&end) - timeval_to_ns(&start);
-	do_div(elapsed_msecs64, NSEC_PER_MSEC);
-	elapsed_msecs = elapsed_msecs64;
+	w.elapsed_usecs = ktime_us_delta(ktime_get(), start);
+	freeze_stats_add(w.elapsed_usecs);
+	elapsed_msecs = w.elapsed_usecs / USEC_PER_MSEC;
 
 	if (todo) {
 		printk("\n");
@@ -99,6 +184,8 @@ static int try_to_freeze_tasks(bool user_only)
 
 #ifdef CONFIG_SEC_PM_DEBUG
 		if (wakeup) {
+			struct task_struct *q = w.last;
+
 			printk(KERN_ERR "Freezing of %s aborted (%d) (%s)\n",
 					user_only ? "user space " : "tasks ",
 					q ? q->pid : 0, q ? q->comm : "NONE");
@@ -161,6 +248,8 @@ int freeze_processes(void)
 	if (!pm_freezing)
 		atomic_inc(&system_freezing_cnt);
 
+	freeze_stats_reset();
+
 	printk("Freezing user space processes ... ");
 	pm_freezing = true;
 	oom_kills_saved = oom_kills_count();
@@ -218,9 +307,14 @@ int freeze_kernel_threads(void)
 	return error;
 }
 
+static void thaw_one_task(struct task_struct *p, void *data)
+{
+	__thaw_task(p);
+}
+
 void thaw_processes(void)
 {
-	struct task_struct *g, *p;
+	ktime_t start = ktime_get();
 
 	if (pm_freezing)
 		atomic_dec(&system_freezing_cnt);
@@ -234,14 +328,13 @@ void thaw_processes(void)
 	__usermodehelper_set_disable_depth(UMH_FREEZING);
 	thaw_workqueues();
 
-	read_lock(&tasklist_lock);
-	do_each_thread(g, p) {
-		__thaw_task(p);
-	} while_each_thread(g, p);
-	read_unlock(&tasklist_lock);
+	/* tasks of frozen cgroups would only go back to the refrigerator */
+	freezer_walk_tasks(thaw_one_task, NULL, false);
 
 	usermodehelper_enable();
 
+	thaw_stats_add(ktime_us_delta(ktime_get(), start));
+
 	schedule();
 	printk("done.\n");
 }
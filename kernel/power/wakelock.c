@@ -10,6 +10,7 @@
  */
 
 #include <linux/capability.h>
+#include <linux/cred.h>
 #include <linux/ctype.h>
 #include <linux/device.h>
 #include <linux/err.h>
@@ -29,21 +30,37 @@ struct wakelock {
 #endif
 };
 
+/*
+ * Wakelocks are kept per name and UID of the task that takes them, so that
+ * each UID taking a wakelock of the same name gets its own statistics.
+ * The tree is sorted by name first, which keeps the UIDs of one name next
+ * to each other.
+ */
 static struct rb_root wakelocks_tree = RB_ROOT;
 
 ssize_t pm_show_wakelocks(char *buf, bool show_active)
 {
-	struct rb_node *node;
-	struct wakelock *wl;
+	struct rb_node *node, *next;
+	struct wakelock *wl, *wl_next;
+	bool active = false;
 	char *str = buf;
 	char *end = buf + PAGE_SIZE;
 
 	mutex_lock(&wakelocks_lock);
 
-	for (node = rb_first(&wakelocks_tree); node; node = rb_next(node)) {
+	/* A name is active if any UID holds it. */
+	for (node = rb_first(&wakelocks_tree); node; node = next) {
 		wl = rb_entry(node, struct wakelock, node);
-		if (wl->ws.active == show_active)
+		active |= wl->ws.active;
+		next = rb_next(node);
+		if (next) {
+			wl_next = rb_entry(next, struct wakelock, node);
+			if (!strcmp(wl->name, wl_next->name))
+				continue;
+		}
+		if (active == show_active)
 			str += scnprintf(str, end - str, "%s ", wl->name);
+		active = false;
 	}
 	if (str > buf)
 		str--;
@@ -132,8 +149,39 @@ static inline void wakelocks_lru_most_recent(struct wakelock *wl) {}
 static inline void wakelocks_gc(void) {}
 #endif /* !CONFIG_PM_WAKELOCKS_GC */
 
+static int wakelock_name_cmp(const char *name, size_t len,
+			     struct wakelock *wl)
+{
+	int diff = strncmp(name, wl->name, len);
+
+	if (diff == 0 && wl->name[len])
+		diff = -1;
+	return diff;
+}
+
+/* Returns the wakelock of @name with the lowest UID, or NULL. */
+static struct wakelock *wakelock_lookup_first(const char *name, size_t len)
+{
+	struct rb_node *node = wakelocks_tree.rb_node;
+	struct wakelock *wl, *first = NULL;
+
+	while (node) {
+		int diff;
+
+		wl = rb_entry(node, struct wakelock, node);
+		diff = wakelock_name_cmp(name, len, wl);
+		if (diff == 0)
+			first = wl;
+		if (diff <= 0)
+			node = node->rb_left;
+		else
+			node = node->rb_right;
+	}
+	return first;
+}
+
 static struct wakelock *wakelock_lookup_add(const char *name, size_t len,
-					    bool add_if_not_found)
+					    kuid_t uid)
 {
 	struct rb_node **node = &wakelocks_tree.rb_node;
 	struct rb_node *parent = *node;
@@ -144,10 +192,12 @@ static struct wakelock *wakelock_lookup_add(const char *name, size_t len,
 
 		parent = *node;
 		wl = rb_entry(*node, struct wakelock, node);
-		diff = strncmp(name, wl->name, len);
+		diff = wakelock_name_cmp(name, len, wl);
 		if (diff == 0) {
-			if (wl->name[len])
+			if (uid_lt(uid, wl->ws.uid))
 				diff = -1;
+			else if (uid_gt(uid, wl->ws.uid))
+				diff = 1;
 			else
 				return wl;
 		}
@@ -156,8 +206,6 @@ static struct wakelock *wakelock_lookup_add(const char *name, size_t len,
 		else
 			node = &(*node)->rb_right;
 	}
-	if (!add_if_not_found)
-		return ERR_PTR(-EINVAL);
 
 	if (wakelocks_limit_exceeded())
 		return ERR_PTR(-ENOSPC);
@@ -173,6 +221,7 @@ static struct wakelock *wakelock_lookup_add(const char *name, size_t len,
 		return ERR_PTR(-ENOMEM);
 	}
 	wl->ws.name = wl->name;
+	wl->ws.uid = uid;
 	wakeup_source_add(&wl->ws);
 	rb_link_node(&wl->node, parent, node);
 	rb_insert_color(&wl->node, &wakelocks_tree);
@@ -210,7 +259,7 @@ int pm_wake_lock(const char *buf)
 
 	mutex_lock(&wakelocks_lock);
 
-	wl = wakelock_lookup_add(buf, len, true);
+	wl = wakelock_lookup_add(buf, len, current_uid());
 	if (IS_ERR(wl)) {
 		ret = PTR_ERR(wl);
 		goto out;
@@ -233,6 +282,7 @@ int pm_wake_lock(const char *buf)
 
 int pm_wake_unlock(const char *buf)
 {
+	struct rb_node *node;
 	struct wakelock *wl;
 	size_t len;
 	int ret = 0;
@@ -254,14 +304,25 @@ int pm_wake_unlock(const char *buf)
 
 	mutex_lock(&wakelocks_lock);
 
-	wl = wakelock_lookup_add(buf, len, false);
-	if (IS_ERR(wl)) {
-		ret = PTR_ERR(wl);
+	wl = wakelock_lookup_first(buf, len);
+	if (!wl) {
+		ret = -EINVAL;
 		goto out;
 	}
-	__pm_relax(&wl->ws);
-
-	wakelocks_lru_most_recent(wl);
+	/*
+	 * A wakelock may be released by a task other than the one that took
+	 * it, so unlocking a name releases it for every UID.
+	 */
+	for (;;) {
+		node = rb_next(&wl->node);
+		__pm_relax(&wl->ws);
+		wakelocks_lru_most_recent(wl);
+		if (!node)
+			break;
+		wl = rb_entry(node, struct wakelock, node);
+		if (wakelock_name_cmp(buf, len, wl))
+			break;
+	}
 	wakelocks_gc();
 
  out:
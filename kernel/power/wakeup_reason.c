@@ -26,6 +26,9 @@
 #include <linux/spinlock.h>
 #include <linux/notifier.h>
 #include <linux/suspend.h>
+#include <linux/string.h>
+#include <linux/export.h>
+#include <linux/user_namespace.h>
 
 
 #define MAX_WAKEUP_REASON_IRQS 32
@@ -34,6 +37,27 @@ static int irqcount;
 static struct kobject *wakeup_reason;
 static spinlock_t resume_reason_lock;
 
+/*
+ * Wakeups that a subsystem could pin on a user: the current resume cycle
+ * (reset on suspend) and running totals since boot.
+ */
+#define MAX_WAKEUP_REASON_UIDS 32
+#define MAX_WAKEUP_UID_TOTALS 64
+#define WAKEUP_SOURCE_LEN 16
+
+struct wakeup_uid {
+	kuid_t uid;
+	char source[WAKEUP_SOURCE_LEN];
+	unsigned long count;
+};
+
+static struct wakeup_uid uid_list[MAX_WAKEUP_REASON_UIDS];
+static int uidcount;
+static struct wakeup_uid uid_totals[MAX_WAKEUP_UID_TOTALS];
+static int uid_totals_count;
+static unsigned long uid_overflow;
+static DEFINE_SPINLOCK(wakeup_uid_lock);
+
 static ssize_t last_resume_reason_show(struct kobject *kobj, struct kobj_attribute *attr,
 		char *buf)
 {
@@ -53,10 +77,45 @@ static ssize_t last_resume_reason_show(struct kobject *kobj, struct kobj_attribu
 	return buf_offset;
 }
 
+static ssize_t show_uid_table(char *buf, struct wakeup_uid *table, int n)
+{
+	int i, buf_offset = 0;
+	unsigned long flags;
+
+	spin_lock_irqsave(&wakeup_uid_lock, flags);
+	for (i = 0; i < n && buf_offset < PAGE_SIZE - 64; i++)
+		buf_offset += sprintf(buf + buf_offset, "%u %s %lu\n",
+				from_kuid_munged(current_user_ns(),
+						 table[i].uid),
+				table[i].source, table[i].count);
+	spin_unlock_irqrestore(&wakeup_uid_lock, flags);
+	return buf_offset;
+}
+
+static ssize_t last_resume_uids_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return show_uid_table(buf, uid_list, uidcount);
+}
+
+static ssize_t uid_wakeups_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	ssize_t ret = show_uid_table(buf, uid_totals, uid_totals_count);
+
+	if (uid_overflow)
+		ret += sprintf(buf + ret, "other - %lu\n", uid_overflow);
+	return ret;
+}
+
 static struct kobj_attribute resume_reason = __ATTR_RO(last_resume_reason);
+static struct kobj_attribute resume_uids = __ATTR_RO(last_resume_uids);
+static struct kobj_attribute uid_wakeups = __ATTR_RO(uid_wakeups);
 
 static struct attribute *attrs[] = {
 	&resume_reason.attr,
+	&resume_uids.attr,
+	&uid_wakeups.attr,
 	NULL,
 };
 static struct attribute_group attr_group = {
@@ -89,6 +148,45 @@ void log_wakeup_reason(int irq)
 	spin_unlock(&resume_reason_lock);
 }
 
+static bool account_uid(struct wakeup_uid *table, int *n, int max,
+		const char *source, kuid_t uid)
+{
+	int i;
+
+	for (i = 0; i < *n; i++) {
+		if (uid_eq(table[i].uid, uid) &&
+		    !strncmp(table[i].source, source, WAKEUP_SOURCE_LEN - 1)) {
+			table[i].count++;
+			return true;
+		}
+	}
+	if (*n == max)
+		return false;
+
+	table[i].uid = uid;
+	strlcpy(table[i].source, source, WAKEUP_SOURCE_LEN);
+	table[i].count = 1;
+	(*n)++;
+	return true;
+}
+
+/*
+ * attributes a wakeup delivered through @source to @uid
+ * may be called from any context
+ */
+void log_wakeup_reason_uid(const char *source, kuid_t uid)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&wakeup_uid_lock, flags);
+	account_uid(uid_list, &uidcount, MAX_WAKEUP_REASON_UIDS, source, uid);
+	if (!account_uid(uid_totals, &uid_totals_count,
+			 MAX_WAKEUP_UID_TOTALS, source, uid))
+		uid_overflow++;
+	spin_unlock_irqrestore(&wakeup_uid_lock, flags);
+}
+EXPORT_SYMBOL_GPL(log_wakeup_reason_uid);
+
 /* Detects a suspend and clears all the previous wake up reasons*/
 static int wakeup_reason_pm_event(struct notifier_block *notifier,
 		unsigned long pm_event, void *unused)
@@ -98,6 +196,9 @@ static int wakeup_reason_pm_event(struct notifier_block *notifier,
 		spin_lock(&resume_reason_lock);
 		irqcount = 0;
 		spin_unlock(&resume_reason_lock);
+		spin_lock_irq(&wakeup_uid_lock);
+		uidcount = 0;
+		spin_unlock_irq(&wakeup_uid_lock);
 		break;
 	default:
 		break;
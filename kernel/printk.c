@@ -44,6 +44,7 @@
 #include <linux/rculist.h>
 #include <linux/poll.h>
 #include <linux/irq_work.h>
+#include <linux/kthread.h>
 #include <linux/utsname.h>
 
 #include <asm/uaccess.h>
@@ -1439,6 +1440,75 @@ static inline void printk_delay(void)
 	}
 }
 
+/*
+ * Once printk_kthread is running, printk() only stores the message in
+ * log_buf and leaves the console drivers to the thread, so that a slow
+ * console no longer stalls whoever is logging. printk.synchronous=1
+ * restores printing from the caller. Oopses, panics and everything past
+ * SYSTEM_RUNNING (reboot, halt, power off) always print synchronously;
+ * panic() additionally flushes with console_flush_on_panic().
+ */
+static bool __read_mostly printk_synchronous;
+module_param_named(synchronous, printk_synchronous, bool, S_IRUGO | S_IWUSR);
+
+static struct task_struct *printk_kthread __read_mostly;
+static bool printk_kthread_need_flush;
+
+static bool printk_offload(void)
+{
+	return printk_kthread && !ACCESS_ONCE(printk_synchronous) &&
+	       !oops_in_progress && system_state == SYSTEM_RUNNING;
+}
+
+/* printk() may be called with scheduler locks held, so wake from irq_work */
+static void printk_kthread_wake_func(struct irq_work *irq_work)
+{
+	wake_up_process(printk_kthread);
+}
+
+static DEFINE_PER_CPU(struct irq_work, printk_kthread_work) = {
+	.func = printk_kthread_wake_func,
+};
+
+static void printk_kthread_wake(void)
+{
+	ACCESS_ONCE(printk_kthread_need_flush) = true;
+	irq_work_queue(&__get_cpu_var(printk_kthread_work));
+}
+
+static int printk_kthread_func(void *data)
+{
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!ACCESS_ONCE(printk_kthread_need_flush))
+			schedule();
+		__set_current_state(TASK_RUNNING);
+
+		/*
+		 * Messages stored after this are either picked up by the
+		 * console_unlock() below or set the flag again.
+		 */
+		ACCESS_ONCE(printk_kthread_need_flush) = false;
+		console_lock();
+		console_unlock();
+	}
+	return 0;
+}
+
+static int __init printk_kthread_init(void)
+{
+	struct task_struct *p;
+
+	p = kthread_run(printk_kthread_func, NULL, "printk");
+	if (IS_ERR(p)) {
+		pr_err("printk: unable to start printing thread\n");
+		return PTR_ERR(p);
+	}
+	printk_kthread = p;
+	return 0;
+}
+core_initcall(printk_kthread_init);
+
 /*
  * Continuation lines are buffered, and not committed to the record buffer
  * until the line is complete, or a race forces it. The line fragments
@@ -1671,14 +1741,18 @@ asmlinkage int vprintk_emit(int facility, int level,
 	printed_len += text_len;
 
 	/*
-	 * Try to acquire and then immediately release the console semaphore.
-	 * The release will print out buffers and wake up /dev/kmsg and syslog()
-	 * users.
+	 * Either hand the message to printk_kthread, or try to acquire and
+	 * then immediately release the console semaphore. The release will
+	 * print out buffers and wake up /dev/kmsg and syslog() users.
 	 *
 	 * The console_trylock_for_printk() function will release 'logbuf_lock'
 	 * regardless of whether it actually gets the console semaphore or not.
 	 */
-	if (console_trylock_for_printk(this_cpu))
+	if (printk_offload()) {
+		logbuf_cpu = UINT_MAX;
+		raw_spin_unlock(&logbuf_lock);
+		printk_kthread_wake();
+	} else if (console_trylock_for_printk(this_cpu))
 		console_unlock();
 
 	lockdep_on();
@@ -31,6 +31,10 @@
  * Display the information collected so far:
  * # cat /proc/timer_stats
  *
+ * The first non-deferrable expiry after a CPU left tickless idle is the
+ * one that woke it up; those are counted separately and shown by:
+ * # cat /proc/timer_wakeups
+ *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License version 2 as
  * published by the Free Software Foundation.
@@ -42,6 +46,7 @@
 #include <linux/sched.h>
 #include <linux/seq_file.h>
 #include <linux/kallsyms.h>
+#include <linux/tick.h>
 
 #include <asm/uaccess.h>
 
@@ -68,6 +73,7 @@ struct entry {
 	 * Number of timeout events:
 	 */
 	unsigned long		count;
+	unsigned long		wakeups;
 	unsigned int		timer_flag;
 
 	/*
@@ -118,6 +124,37 @@ static struct entry entries[MAX_ENTRIES];
 
 static atomic_t overflow_count;
 
+/*
+ * Idle wakeups per CPU, and the tickless idle period the last one was
+ * counted for, updated under the CPU's lookup lock:
+ */
+static DEFINE_PER_CPU(unsigned long, tstats_wakeups);
+static DEFINE_PER_CPU(unsigned long, tstats_idle_calls);
+
+/*
+ * Deferrable timers only run once something else woke the CPU, and
+ * without NO_HZ the tick does all the waking:
+ */
+static bool tstats_idle_wakeup(int cpu, unsigned int timer_flag)
+{
+#ifdef CONFIG_NO_HZ_COMMON
+	unsigned long idle_calls;
+
+	if (timer_flag & TIMER_STATS_FLAG_DEFERRABLE)
+		return false;
+	if (!is_idle_task(current) || !tick_nohz_tick_stopped())
+		return false;
+
+	idle_calls = per_cpu(tick_cpu_sched, cpu).idle_calls;
+	if (per_cpu(tstats_idle_calls, cpu) == idle_calls)
+		return false;
+	per_cpu(tstats_idle_calls, cpu) = idle_calls;
+	return true;
+#else
+	return false;
+#endif
+}
+
 /*
  * The entries are in a hash-table, for fast lookup:
  */
@@ -137,10 +174,14 @@ static struct entry *tstat_hash_table[TSTAT_HASH_SIZE] __read_mostly;
 
 static void reset_entries(void)
 {
+	int cpu;
+
 	nr_entries = 0;
 	memset(entries, 0, sizeof(entries));
 	memset(tstat_hash_table, 0, sizeof(tstat_hash_table));
 	atomic_set(&overflow_count, 0);
+	for_each_possible_cpu(cpu)
+		per_cpu(tstats_wakeups, cpu) = 0;
 }
 
 static struct entry *alloc_entry(void)
@@ -204,6 +245,7 @@ static struct entry *tstat_lookup(struct entry *entry, char *comm)
 	if (curr) {
 		*curr = *entry;
 		curr->count = 0;
+		curr->wakeups = 0;
 		curr->next = NULL;
 		memcpy(curr->comm, comm, TASK_COMM_LEN);
 
@@ -241,11 +283,14 @@ void timer_stats_update_stats(void *timer, pid_t pid, void *startf,
 	raw_spinlock_t *lock;
 	struct entry *entry, input;
 	unsigned long flags;
+	bool wakeup;
+	int cpu;
 
 	if (likely(!timer_stats_active))
 		return;
 
-	lock = &per_cpu(tstats_lookup_lock, raw_smp_processor_id());
+	cpu = raw_smp_processor_id();
+	lock = &per_cpu(tstats_lookup_lock, cpu);
 
 	input.timer = timer;
 	input.start_func = startf;
@@ -257,11 +302,14 @@ void timer_stats_update_stats(void *timer, pid_t pid, void *startf,
 	if (!timer_stats_active)
 		goto out_unlock;
 
+	wakeup = tstats_idle_wakeup(cpu, timer_flag);
 	entry = tstat_lookup(&input, comm);
-	if (likely(entry))
+	if (likely(entry)) {
 		entry->count++;
-	else
+		entry->wakeups += wakeup;
+	} else
 		atomic_inc(&overflow_count);
+	per_cpu(tstats_wakeups, cpu) += wakeup;
 
  out_unlock:
 	raw_spin_unlock_irqrestore(lock, flags);
@@ -277,16 +325,16 @@ static void print_name_offset(struct seq_file *m, unsigned long addr)
 		seq_printf(m, "%s", symname);
 }
 
-static int tstats_show(struct seq_file *m, void *v)
+/*
+ * Print the header and return the sample period in ms. Must be called
+ * with show_mutex held:
+ */
+static unsigned long tstats_show_header(struct seq_file *m, const char *title)
 {
 	struct timespec period;
-	struct entry *entry;
 	unsigned long ms;
-	long events = 0;
 	ktime_t time;
-	int i;
 
-	mutex_lock(&show_mutex);
 	/*
 	 * If still active then calculate up to now:
 	 */
@@ -298,41 +346,83 @@ static int tstats_show(struct seq_file *m, void *v)
 	period = ktime_to_timespec(time);
 	ms = period.tv_nsec / 1000000;
 
-	seq_puts(m, "Timer Stats Version: v0.2\n");
+	seq_puts(m, title);
 	seq_printf(m, "Sample period: %ld.%03ld s\n", period.tv_sec, ms);
 	if (atomic_read(&overflow_count))
 		seq_printf(m, "Overflow: %d entries\n",
 			atomic_read(&overflow_count));
 
-	for (i = 0; i < nr_entries; i++) {
-		entry = entries + i;
- 		if (entry->timer_flag & TIMER_STATS_FLAG_DEFERRABLE) {
-			seq_printf(m, "%4luD, %5d %-16s ",
-				entry->count, entry->pid, entry->comm);
-		} else {
-			seq_printf(m, " %4lu, %5d %-16s ",
-				entry->count, entry->pid, entry->comm);
-		}
-
-		print_name_offset(m, (unsigned long)entry->start_func);
-		seq_puts(m, " (");
-		print_name_offset(m, (unsigned long)entry->expire_func);
-		seq_puts(m, ")\n");
+	return ms + period.tv_sec * 1000;
+}
 
-		events += entry->count;
+static void tstats_show_entry(struct seq_file *m, struct entry *entry,
+			      unsigned long count)
+{
+	if (entry->timer_flag & TIMER_STATS_FLAG_DEFERRABLE) {
+		seq_printf(m, "%4luD, %5d %-16s ",
+			count, entry->pid, entry->comm);
+	} else {
+		seq_printf(m, " %4lu, %5d %-16s ",
+			count, entry->pid, entry->comm);
 	}
 
-	ms += period.tv_sec * 1000;
-	if (!ms)
-		ms = 1;
+	print_name_offset(m, (unsigned long)entry->start_func);
+	seq_puts(m, " (");
+	print_name_offset(m, (unsigned long)entry->expire_func);
+	seq_puts(m, ")\n");
+}
 
-	if (events && period.tv_sec)
-		seq_printf(m, "%ld total events, %ld.%03ld events/sec\n",
-			   events, events * 1000 / ms,
-			   (events * 1000000 / ms) % 1000);
+static void tstats_show_total(struct seq_file *m, long events,
+			      unsigned long ms, const char *what)
+{
+	if (events && ms >= 1000)
+		seq_printf(m, "%ld total %s, %ld.%03ld %s/sec\n",
+			   events, what, events * 1000 / ms,
+			   (events * 1000000 / ms) % 1000, what);
 	else
-		seq_printf(m, "%ld total events\n", events);
+		seq_printf(m, "%ld total %s\n", events, what);
+}
+
+static int tstats_show(struct seq_file *m, void *v)
+{
+	unsigned long ms;
+	long events = 0;
+	int i;
+
+	mutex_lock(&show_mutex);
+	ms = tstats_show_header(m, "Timer Stats Version: v0.2\n");
+
+	for (i = 0; i < nr_entries; i++) {
+		tstats_show_entry(m, entries + i, entries[i].count);
+		events += entries[i].count;
+	}
+
+	tstats_show_total(m, events, ms, "events");
+	mutex_unlock(&show_mutex);
+
+	return 0;
+}
+
+static int twakeups_show(struct seq_file *m, void *v)
+{
+	unsigned long ms;
+	long events = 0;
+	int i, cpu;
 
+	mutex_lock(&show_mutex);
+	ms = tstats_show_header(m, "Timer Wakeups Version: v0.1\n");
+
+	for (i = 0; i < nr_entries; i++) {
+		if (!entries[i].wakeups)
+			continue;
+		tstats_show_entry(m, entries + i, entries[i].wakeups);
+		events += entries[i].wakeups;
+	}
+
+	tstats_show_total(m, events, ms, "wakeups");
+	for_each_possible_cpu(cpu)
+		seq_printf(m, "CPU%d: %lu wakeups\n", cpu,
+			   per_cpu(tstats_wakeups, cpu));
 	mutex_unlock(&show_mutex);
 
 	return 0;
@@ -405,6 +495,18 @@ static const struct file_operations tstats_fops = {
 	.release	= single_release,
 };
 
+static int twakeups_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, twakeups_show, NULL);
+}
+
+static const struct file_operations twakeups_fops = {
+	.open		= twakeups_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 void __init init_timer_stats(void)
 {
 	int cpu;
@@ -418,6 +520,9 @@ static int __init init_tstats_procfs(void)
 	struct proc_dir_entry *pe;
 
 	pe = proc_create("timer_stats", 0644, NULL, &tstats_fops);
+	if (!pe)
+		return -ENOMEM;
+	pe = proc_create("timer_wakeups", 0444, NULL, &twakeups_fops);
 	if (!pe)
 		return -ENOMEM;
 	return 0;
@@ -1456,7 +1456,7 @@ static void process_timeout(unsigned long __data)
 signed long __sched schedule_timeout(signed long timeout)
 {
 	struct timer_list timer;
-	unsigned long expire;
+	unsigned long expire, slack;
 
 	switch (timeout)
 	{
@@ -1490,7 +1490,18 @@ signed long __sched schedule_timeout(signed long timeout)
 	expire = timeout + jiffies;
 
 	setup_timer_on_stack(&timer, process_timeout, (unsigned long)current);
-	__mod_timer(&timer, expire, false, TIMER_NOT_PINNED);
+	/*
+	 * Like its hrtimer sleeps, the task's timeout may be up to its timer
+	 * slack late, so that the sleeps of tasks in a cgroup with a large
+	 * timer slack share expiry slots. A slack below the default 0.4%,
+	 * such as the 50us default that converts to no jiffies at all, keeps
+	 * the default.
+	 */
+	slack = nsecs_to_jiffies(current->timer_slack_ns);
+	if (slack > (unsigned long)timeout / 256)
+		timer.slack = slack;
+	__mod_timer(&timer, apply_slack(&timer, expire), false,
+		    TIMER_NOT_PINNED);
 	schedule();
 	del_singleshot_timer_sync(&timer);
 
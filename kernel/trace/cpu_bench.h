@@ -0,0 +1,47 @@
+#ifndef __CPU_BENCH_H
+#define __CPU_BENCH_H
+
+#include <linux/atomic.h>
+#include <linux/cpu.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/smp.h>
+
+/*
+ * Runs a benchmark loop on every online cpu at the same time, from an
+ * IPI with interrupts disabled, so that the result is not disturbed by
+ * scheduling but does include contention between the cpus.
+ */
+struct cpu_bench {
+	/* runs @loops iterations of the measured call */
+	void			(*run)(struct cpu_bench *bench);
+	unsigned int		loops;
+	atomic64_t		ns;
+};
+
+static inline void cpu_bench_one(void *data)
+{
+	struct cpu_bench *bench = data;
+	u64 start = local_clock();
+
+	bench->run(bench);
+	atomic64_add(local_clock() - start, &bench->ns);
+}
+
+/* returns the average ns per iteration, @cpus is set to the cpus used */
+static inline u64 cpu_bench_run(struct cpu_bench *bench, unsigned int *cpus)
+{
+	u64 ns;
+
+	atomic64_set(&bench->ns, 0);
+	get_online_cpus();
+	*cpus = num_online_cpus();
+	on_each_cpu(cpu_bench_one, bench, 1);
+	put_online_cpus();
+
+	ns = atomic64_read(&bench->ns);
+	do_div(ns, bench->loops * *cpus);
+	return ns;
+}
+
+#endif /* __CPU_BENCH_H */
@@ -13,6 +13,7 @@
 
 #include <linux/slab.h>
 #include <linux/uaccess.h>
+#include <linux/ctype.h>
 #include <linux/module.h>
 #include <linux/fs.h>
 #include <linux/kernel.h>
@@ -26,8 +27,11 @@
 #include <linux/wait.h>
 #include <linux/delay.h>
 #include <linux/completion.h>
+#include <linux/percpu.h>
 #include <linux/ipc_logging.h>
 
+#include <asm/sections.h>
+
 #include "ipc_logging_private.h"
 
 static LIST_HEAD(ipc_log_context_list);
@@ -36,30 +40,30 @@ static atomic_t next_log_id = ATOMIC_INIT(0);
 static void *get_deserialization_func(struct ipc_log_context *ilctxt,
 				      int type);
 
-static struct ipc_log_page *get_first_page(struct ipc_log_context *ilctxt)
+static struct ipc_log_page *get_first_page(struct ipc_log_cpu *ring)
 {
 	struct ipc_log_page_header *p_pghdr;
 	struct ipc_log_page *pg = NULL;
 
-	if (!ilctxt)
+	if (!ring)
 		return NULL;
-	p_pghdr = list_first_entry(&ilctxt->page_list,
+	p_pghdr = list_first_entry(&ring->page_list,
 				   struct ipc_log_page_header, list);
 	pg = container_of(p_pghdr, struct ipc_log_page, hdr);
 	return pg;
 }
 
-static struct ipc_log_page *get_next_page(struct ipc_log_context *ilctxt,
+static struct ipc_log_page *get_next_page(struct ipc_log_cpu *ring,
 					  struct ipc_log_page *cur_pg)
 {
 	struct ipc_log_page_header *p_pghdr;
 	struct ipc_log_page *pg = NULL;
 
-	if (!ilctxt || !cur_pg)
+	if (!ring || !cur_pg)
 		return NULL;
 
-	if (ilctxt->last_page == cur_pg)
-		return ilctxt->first_page;
+	if (ring->last_page == cur_pg)
+		return ring->first_page;
 
 	p_pghdr = list_first_entry(&cur_pg->hdr.list,
 			struct ipc_log_page_header, list);
@@ -69,30 +73,68 @@ static struct ipc_log_page *get_next_page(struct ipc_log_context *ilctxt,
 }
 
 /* If data == NULL, drop the log of size data_size*/
-static void ipc_log_read(struct ipc_log_context *ilctxt,
+static void ipc_log_read(struct ipc_log_cpu *ring,
 			 void *data, int data_size)
 {
 	int bytes_to_read;
 
-	bytes_to_read = MIN(((PAGE_SIZE - sizeof(struct ipc_log_page_header))
-				- ilctxt->read_page->hdr.read_offset),
-			      data_size);
+	bytes_to_read = MIN((LOG_PAGE_DATA_SIZE -
+			     ring->read_page->hdr.read_offset), data_size);
 	if (data)
-		memcpy(data, (ilctxt->read_page->data +
-			ilctxt->read_page->hdr.read_offset), bytes_to_read);
+		memcpy(data, (ring->read_page->data +
+			ring->read_page->hdr.read_offset), bytes_to_read);
 	if (bytes_to_read != data_size) {
-		ilctxt->read_page->hdr.read_offset = 0xFFFF;
-		ilctxt->read_page = get_next_page(ilctxt, ilctxt->read_page);
-		ilctxt->read_page->hdr.read_offset = 0;
+		ring->read_page->hdr.read_offset = 0xFFFF;
+		ring->read_page = get_next_page(ring, ring->read_page);
+		ring->read_page->hdr.read_offset = 0;
 		if (data)
 			memcpy((data + bytes_to_read),
-			       (ilctxt->read_page->data +
-				ilctxt->read_page->hdr.read_offset),
+			       (ring->read_page->data +
+				ring->read_page->hdr.read_offset),
 			       (data_size - bytes_to_read));
 		bytes_to_read = (data_size - bytes_to_read);
 	}
-	ilctxt->read_page->hdr.read_offset += bytes_to_read;
-	ilctxt->write_avail += data_size;
+	ring->read_page->hdr.read_offset += bytes_to_read;
+	ring->write_avail += data_size;
+}
+
+/* Like ipc_log_read(), but leaves the data in the ring */
+static void ipc_log_peek(struct ipc_log_cpu *ring,
+			 void *data, int data_size)
+{
+	struct ipc_log_page *pg = ring->read_page;
+	int bytes_to_read;
+
+	bytes_to_read = MIN((LOG_PAGE_DATA_SIZE - pg->hdr.read_offset),
+			    data_size);
+	memcpy(data, (pg->data + pg->hdr.read_offset), bytes_to_read);
+	if (bytes_to_read != data_size) {
+		pg = get_next_page(ring, pg);
+		memcpy((data + bytes_to_read), pg->data,
+		       (data_size - bytes_to_read));
+	}
+}
+
+static void ipc_log_copy(struct ipc_log_cpu *ring,
+			 void *data, int data_size)
+{
+	int bytes_to_write;
+
+	bytes_to_write = MIN((LOG_PAGE_DATA_SIZE -
+			      ring->write_page->hdr.write_offset), data_size);
+	memcpy((ring->write_page->data +
+		ring->write_page->hdr.write_offset), data, bytes_to_write);
+	if (bytes_to_write != data_size) {
+		ring->write_page->hdr.write_offset = 0xFFFF;
+		ring->write_page = get_next_page(ring, ring->write_page);
+		ring->write_page->hdr.write_offset = 0;
+		memcpy((ring->write_page->data +
+			ring->write_page->hdr.write_offset),
+		       (data + bytes_to_write), (data_size - bytes_to_write));
+		bytes_to_write = (data_size - bytes_to_write);
+	}
+	ring->write_page->hdr.write_offset += bytes_to_write;
+	ring->write_avail -= data_size;
 }
 
 /*
@@ -105,68 +147,98 @@ static void ipc_log_read(struct ipc_log_context *ilctxt,
  *
  * @ectxt   Message context and if NULL, drops the message.
  *
- * @returns 0  - no message available
- *          1  - message read
+ * @returns number of bytes the message took in the ring
  */
-int msg_read(struct ipc_log_context *ilctxt,
+int msg_read(struct ipc_log_cpu *ring,
 	     struct encode_context *ectxt)
 {
 	struct tsv_header hdr;
+	u64 stamp;
 
-	ipc_log_read(ilctxt, &hdr, sizeof(hdr));
+	ipc_log_read(ring, &stamp, sizeof(stamp));
+	ipc_log_read(ring, &hdr, sizeof(hdr));
 	if (ectxt) {
 		ectxt->hdr.type = hdr.type;
 		ectxt->hdr.size = hdr.size;
 		ectxt->offset = sizeof(hdr);
-		ipc_log_read(ilctxt, (ectxt->buff + ectxt->offset),
+		ipc_log_read(ring, (ectxt->buff + ectxt->offset),
 			     (int)hdr.size);
 	} else {
-		ipc_log_read(ilctxt, NULL, (int)hdr.size);
+		ipc_log_read(ring, NULL, (int)hdr.size);
 	}
-	return sizeof(hdr) + (int)hdr.size;
+	return sizeof(stamp) + sizeof(hdr) + (int)hdr.size;
 }
 
 /*
- * Commits messages to the FIFO.  If the FIFO is full, then enough
- * messages are dropped to create space for the new message.
+ * Reads the oldest message of all CPUs.
+ *
+ * @returns 0  - no message available
+ *          >0 - message read
+ */
+static int msg_read_oldest(struct ipc_log_context *ilctxt,
+			   struct encode_context *ectxt)
+{
+	struct ipc_log_cpu *ring, *oldest = NULL;
+	u64 stamp, oldest_stamp = 0;
+	unsigned long flags;
+	int cpu, ret = 0;
+
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(ilctxt->cpu, cpu);
+		spin_lock_irqsave(&ring->lock, flags);
+		if (!is_ring_empty(ring)) {
+			ipc_log_peek(ring, &stamp, sizeof(stamp));
+			if (!oldest || stamp < oldest_stamp) {
+				oldest = ring;
+				oldest_stamp = stamp;
+			}
+		}
+		spin_unlock_irqrestore(&ring->lock, flags);
+	}
+	if (!oldest)
+		return 0;
+
+	/* writers only drop messages to make room, the ring can't be empty */
+	spin_lock_irqsave(&oldest->lock, flags);
+	if (!is_ring_empty(oldest))
+		ret = msg_read(oldest, ectxt);
+	spin_unlock_irqrestore(&oldest->lock, flags);
+	return ret;
+}
+
+/*
+ * Commits messages to the FIFO of the local CPU.  If the FIFO is full,
+ * then enough messages are dropped to create space for the new message.
  */
 void ipc_log_write(void *ctxt, struct encode_context *ectxt)
 {
 	struct ipc_log_context *ilctxt = (struct ipc_log_context *)ctxt;
-	int bytes_to_write;
+	struct ipc_log_cpu *ring;
 	unsigned long flags;
+	u64 stamp;
 
 	if (!ilctxt || !ectxt) {
 		pr_err("%s: Invalid ipc_log or encode context\n", __func__);
 		return;
 	}
 
-	read_lock_irqsave(&ipc_log_context_list_lock, flags);
-	spin_lock(&ilctxt->ipc_log_context_lock);
-	while (ilctxt->write_avail < ectxt->offset)
-		msg_read(ilctxt, NULL);
-
-	bytes_to_write = MIN(((PAGE_SIZE - sizeof(struct ipc_log_page_header))
-				- ilctxt->write_page->hdr.write_offset),
-				ectxt->offset);
-	memcpy((ilctxt->write_page->data +
-		ilctxt->write_page->hdr.write_offset),
-		ectxt->buff, bytes_to_write);
-	if (bytes_to_write != ectxt->offset) {
-		ilctxt->write_page->hdr.write_offset = 0xFFFF;
-		ilctxt->write_page = get_next_page(ilctxt, ilctxt->write_page);
-		ilctxt->write_page->hdr.write_offset = 0;
-		memcpy((ilctxt->write_page->data +
-			ilctxt->write_page->hdr.write_offset),
-		       (ectxt->buff + bytes_to_write),
-		       (ectxt->offset - bytes_to_write));
-		bytes_to_write = (ectxt->offset - bytes_to_write);
-	}
-	ilctxt->write_page->hdr.write_offset += bytes_to_write;
-	ilctxt->write_avail -= ectxt->offset;
-	complete(&ilctxt->read_avail);
-	spin_unlock(&ilctxt->ipc_log_context_lock);
-	read_unlock_irqrestore(&ipc_log_context_list_lock, flags);
+	local_irq_save(flags);
+	ring = this_cpu_ptr(ilctxt->cpu);
+	/* only contended while a reader looks at this CPU's ring */
+	spin_lock(&ring->lock);
+	while (ring->write_avail < sizeof(stamp) + ectxt->offset)
+		msg_read(ring, NULL);
+
+	stamp = local_clock();
+	ipc_log_copy(ring, &stamp, sizeof(stamp));
+	ipc_log_copy(ring, ectxt->buff, ectxt->offset);
+	spin_unlock(&ring->lock);
+	local_irq_restore(flags);
+
+	/* pairs with the barrier in prepare_to_wait() */
+	smp_mb();
+	if (waitqueue_active(&ilctxt->read_wait))
+		wake_up_interruptible(&ilctxt->read_wait);
 }
 EXPORT_SYMBOL(ipc_log_write);
 
@@ -312,6 +384,62 @@ int tsv_byte_array_write(struct encode_context *ectxt,
 }
 EXPORT_SYMBOL(tsv_byte_array_write);
 
+/*
+ * vbin_printf() keeps the argument of a %p extension such as %pa, %pV or
+ * %pI4 as a pointer, which bstr_printf() only follows when the log is
+ * read.  By then it may point to a dead stack frame, so such formats are
+ * formatted right away.  Plain %p and %pK print the pointer value only.
+ */
+static bool tsv_fmt_deref_ptr(const char *fmt)
+{
+	while ((fmt = strchr(fmt, '%'))) {
+		fmt++;
+		if (*fmt == '%') {
+			fmt++;
+			continue;
+		}
+		while (*fmt && !isalpha(*fmt))
+			fmt++;
+		while (*fmt == 'h' || *fmt == 'l' || *fmt == 'L' ||
+		       *fmt == 'z' || *fmt == 'Z' || *fmt == 't')
+			fmt++;
+		if (*fmt == 'p' && isalnum(fmt[1]) && fmt[1] != 'K')
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Stores the format pointer and the arguments in vbin_printf() form, to
+ * be formatted when the log is read.  Only done for formats in the
+ * kernel's rodata, which stay around as long as the log does, and
+ * without pointer dereferencing %p extensions.
+ *
+ * @returns 0 if the message was encoded, < 0 if it has to be formatted
+ */
+static int tsv_bprintf_write(struct encode_context *ectxt,
+			     const char *fmt, va_list args)
+{
+	u32 bin[BPRINTF_WORDS];
+	int avail_words, words;
+
+	if (fmt < __start_rodata || fmt >= __end_rodata)
+		return -EINVAL;
+	if (tsv_fmt_deref_ptr(fmt))
+		return -EINVAL;
+
+	avail_words = (MAX_MSG_SIZE - (ectxt->offset +
+		       sizeof(struct tsv_header) + sizeof(fmt))) / sizeof(u32);
+	words = vbin_printf(bin, avail_words, fmt, args);
+	if (words > avail_words)
+		return -ENOSPC;
+
+	tsv_write_header(ectxt, TSV_TYPE_BPRINTF,
+			 sizeof(fmt) + words * sizeof(u32));
+	tsv_write_data(ectxt, &fmt, sizeof(fmt));
+	return tsv_write_data(ectxt, bin, words * sizeof(u32));
+}
+
 /*
  * Helper function to log a string
  *
@@ -323,19 +451,27 @@ int ipc_log_string(void *ilctxt, const char *fmt, ...)
 	struct encode_context ectxt;
 	int avail_size, data_size, hdr_size = sizeof(struct tsv_header);
 	va_list arg_list;
+	int ret;
 
 	if (!ilctxt)
 		return -EINVAL;
 
 	msg_encode_start(&ectxt, TSV_TYPE_STRING);
 	tsv_timestamp_write(&ectxt);
-	avail_size = (MAX_MSG_SIZE - (ectxt.offset + hdr_size));
+
 	va_start(arg_list, fmt);
-	data_size = vsnprintf((ectxt.buff + ectxt.offset + hdr_size),
-			      avail_size, fmt, arg_list);
+	ret = tsv_bprintf_write(&ectxt, fmt, arg_list);
 	va_end(arg_list);
-	tsv_write_header(&ectxt, TSV_TYPE_BYTE_ARRAY, data_size);
-	ectxt.offset += data_size;
+
+	if (ret) {
+		avail_size = (MAX_MSG_SIZE - (ectxt.offset + hdr_size));
+		va_start(arg_list, fmt);
+		data_size = vscnprintf((ectxt.buff + ectxt.offset + hdr_size),
+				       avail_size, fmt, arg_list);
+		va_end(arg_list);
+		tsv_write_header(&ectxt, TSV_TYPE_BYTE_ARRAY, data_size);
+		ectxt.offset += data_size;
+	}
 	msg_encode_end(&ectxt);
 	ipc_log_write(ilctxt, &ectxt);
 	return 0;
@@ -350,9 +486,9 @@ EXPORT_SYMBOL(ipc_log_string);
  * @size:    size of the buffer
  * @returns: 0 if no data read; >0 number of bytes read; < 0 error
  *
- * If no data is available to be read, then the ilctxt::read_avail
- * completion is reinitialized.  This allows clients to block
- * until new log data is save.
+ * Messages logged on different CPUs are merged in the order they were
+ * logged.  Clients can sleep on ilctxt::read_wait until new log data
+ * is saved.
  */
 int ipc_log_extract(void *ctxt, char *buff, int size)
 {
@@ -369,27 +505,18 @@ int ipc_log_extract(void *ctxt, char *buff, int size)
 	dctxt.output_format = OUTPUT_DEBUGFS;
 	dctxt.buff = buff;
 	dctxt.size = size;
-	read_lock_irqsave(&ipc_log_context_list_lock, flags);
-	spin_lock(&ilctxt->ipc_log_context_lock);
 	while (dctxt.size >= MAX_MSG_DECODED_SIZE &&
-	       !is_ilctxt_empty(ilctxt)) {
-		msg_read(ilctxt, &ectxt);
+	       msg_read_oldest(ilctxt, &ectxt)) {
+		spin_lock_irqsave(&ilctxt->ipc_log_context_lock, flags);
 		deserialize_func = get_deserialization_func(ilctxt,
 							ectxt.hdr.type);
-		spin_unlock(&ilctxt->ipc_log_context_lock);
-		read_unlock_irqrestore(&ipc_log_context_list_lock, flags);
+		spin_unlock_irqrestore(&ilctxt->ipc_log_context_lock, flags);
 		if (deserialize_func)
 			deserialize_func(&ectxt, &dctxt);
 		else
 			pr_err("%s: unknown message 0x%x\n",
 				__func__, ectxt.hdr.type);
-		read_lock_irqsave(&ipc_log_context_list_lock, flags);
-		spin_lock(&ilctxt->ipc_log_context_lock);
 	}
-	if ((size - dctxt.size) == 0)
-		init_completion(&ilctxt->read_avail);
-	spin_unlock(&ilctxt->ipc_log_context_lock);
-	read_unlock_irqrestore(&ipc_log_context_list_lock, flags);
 	return size - dctxt.size;
 }
 EXPORT_SYMBOL(ipc_log_extract);
@@ -510,6 +637,38 @@ void tsv_byte_array_read(struct encode_context *ectxt,
 }
 EXPORT_SYMBOL(tsv_byte_array_read);
 
+/*
+ * Reads the text of a string message, formatting it first if
+ * ipc_log_string() stored only its format and arguments.
+ *
+ * @ectxt   context initialized by calling msg_read()
+ * @dctxt   deserialization context
+ */
+void tsv_string_read(struct encode_context *ectxt,
+		     struct decode_context *dctxt)
+{
+	struct tsv_header hdr;
+	u32 bin[BPRINTF_WORDS];
+	const char *fmt;
+	int len;
+
+	BUG_ON((ectxt->offset + sizeof(hdr)) > MAX_MSG_SIZE);
+	memcpy(&hdr, (ectxt->buff + ectxt->offset), sizeof(hdr));
+	if (hdr.type != TSV_TYPE_BPRINTF) {
+		tsv_byte_array_read(ectxt, dctxt, "");
+		return;
+	}
+
+	tsv_read_header(ectxt, &hdr);
+	tsv_read_data(ectxt, &fmt, sizeof(fmt));
+	tsv_read_data(ectxt, bin, hdr.size - sizeof(fmt));
+
+	len = bstr_printf(dctxt->buff, dctxt->size, fmt, bin);
+	len = MIN(len, dctxt->size - 1);
+	dctxt->buff += len;
+	dctxt->size -= len;
+}
+
 int add_deserialization_func(void *ctxt, int type,
 			void (*dfunc)(struct encode_context *,
 				      struct decode_context *))
@@ -525,13 +684,11 @@ int add_deserialization_func(void *ctxt, int type,
 	if (!df_info)
 		return -ENOSPC;
 
-	read_lock_irqsave(&ipc_log_context_list_lock, flags);
-	spin_lock(&ilctxt->ipc_log_context_lock);
+	spin_lock_irqsave(&ilctxt->ipc_log_context_lock, flags);
 	df_info->type = type;
 	df_info->dfunc = dfunc;
 	list_add_tail(&df_info->list, &ilctxt->dfunc_info_list);
-	spin_unlock(&ilctxt->ipc_log_context_lock);
-	read_unlock_irqrestore(&ipc_log_context_list_lock, flags);
+	spin_unlock_irqrestore(&ilctxt->ipc_log_context_lock, flags);
 	return 0;
 }
 EXPORT_SYMBOL(add_deserialization_func);
@@ -551,12 +708,60 @@ static void *get_deserialization_func(struct ipc_log_context *ilctxt,
 	return NULL;
 }
 
+static void ipc_log_free_pages(struct ipc_log_context *ctxt)
+{
+	struct ipc_log_cpu *ring;
+	struct ipc_log_page *pg;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(ctxt->cpu, cpu);
+		while (!list_empty(&ring->page_list)) {
+			pg = get_first_page(ring);
+			list_del(&pg->hdr.list);
+			kfree(pg);
+		}
+	}
+}
+
+static int ipc_log_alloc_pages(struct ipc_log_context *ctxt, int cpu,
+			       int max_num_pages, int log_id)
+{
+	struct ipc_log_cpu *ring = per_cpu_ptr(ctxt->cpu, cpu);
+	struct ipc_log_page *pg = NULL;
+	int page_cnt;
+
+	for (page_cnt = 0; page_cnt < max_num_pages; page_cnt++) {
+		pg = kzalloc_node(sizeof(struct ipc_log_page), GFP_KERNEL,
+				  cpu_to_node(cpu));
+		if (!pg) {
+			pr_err("%s: cannot create ipc_log_page\n", __func__);
+			return -ENOMEM;
+		}
+		pg->hdr.magic = IPC_LOGGING_MAGIC_NUM;
+		pg->hdr.nmagic = ~(IPC_LOGGING_MAGIC_NUM);
+		pg->hdr.version = IPC_LOGGING_PAGE_VERSION;
+		pg->hdr.log_id = (uint32_t)log_id;
+		pg->hdr.page_num = cpu * max_num_pages + page_cnt;
+		pg->hdr.read_offset = 0xFFFF;
+		pg->hdr.write_offset = 0xFFFF;
+		list_add_tail(&pg->hdr.list, &ring->page_list);
+	}
+	ring->first_page = get_first_page(ring);
+	ring->last_page = pg;
+	ring->write_page = ring->first_page;
+	ring->read_page = ring->first_page;
+	ring->write_page->hdr.write_offset = 0;
+	ring->read_page->hdr.read_offset = 0;
+	ring->write_avail = max_num_pages * LOG_PAGE_DATA_SIZE;
+	return 0;
+}
+
 void *ipc_log_context_create(int max_num_pages,
 			     const char *mod_name)
 {
 	struct ipc_log_context *ctxt;
-	struct ipc_log_page *pg = NULL;
-	int page_cnt, local_log_id;
+	int cpu, local_log_id, cpu_pages;
 	unsigned long flags;
 
 	ctxt = kzalloc(sizeof(struct ipc_log_context), GFP_KERNEL);
@@ -565,35 +770,34 @@ void *ipc_log_context_create(int max_num_pages,
 		return 0;
 	}
 
+	ctxt->cpu = alloc_percpu(struct ipc_log_cpu);
+	if (!ctxt->cpu) {
+		pr_err("%s: cannot create ipc_log_context\n", __func__);
+		kfree(ctxt);
+		return 0;
+	}
+
 	local_log_id = atomic_add_return(1, &next_log_id);
-	init_completion(&ctxt->read_avail);
-	INIT_LIST_HEAD(&ctxt->page_list);
+	init_waitqueue_head(&ctxt->read_wait);
 	INIT_LIST_HEAD(&ctxt->dfunc_info_list);
 	spin_lock_init(&ctxt->ipc_log_context_lock);
-	for (page_cnt = 0; page_cnt < max_num_pages; page_cnt++) {
-		pg = kzalloc(sizeof(struct ipc_log_page), GFP_KERNEL);
-		if (!pg) {
-			pr_err("%s: cannot create ipc_log_page\n", __func__);
+	for_each_possible_cpu(cpu) {
+		struct ipc_log_cpu *ring = per_cpu_ptr(ctxt->cpu, cpu);
+
+		spin_lock_init(&ring->lock);
+		INIT_LIST_HEAD(&ring->page_list);
+	}
+	/*
+	 * The pages asked for are shared out among the CPUs, so the context
+	 * uses about as much memory as a single ring did.  A CPU logging a
+	 * lot keeps less history than before.
+	 */
+	cpu_pages = max_t(int, 1,
+			  DIV_ROUND_UP(max_num_pages, num_possible_cpus()));
+	for_each_possible_cpu(cpu) {
+		if (ipc_log_alloc_pages(ctxt, cpu, cpu_pages, local_log_id))
 			goto release_ipc_log_context;
-		}
-		pg->hdr.magic = IPC_LOGGING_MAGIC_NUM;
-		pg->hdr.nmagic = ~(IPC_LOGGING_MAGIC_NUM);
-		pg->hdr.log_id = (uint32_t)local_log_id;
-		pg->hdr.page_num = page_cnt;
-		pg->hdr.read_offset = 0xFFFF;
-		pg->hdr.write_offset = 0xFFFF;
-		spin_lock_irqsave(&ctxt->ipc_log_context_lock, flags);
-		list_add_tail(&pg->hdr.list, &ctxt->page_list);
-		spin_unlock_irqrestore(&ctxt->ipc_log_context_lock, flags);
 	}
-	ctxt->first_page = get_first_page(ctxt);
-	ctxt->last_page = pg;
-	ctxt->write_page = ctxt->first_page;
-	ctxt->read_page = ctxt->first_page;
-	ctxt->write_page->hdr.write_offset = 0;
-	ctxt->read_page->hdr.read_offset = 0;
-	ctxt->write_avail = max_num_pages * (PAGE_SIZE -
-					sizeof(struct ipc_log_page_header));
 
 	create_ctx_debugfs(ctxt, mod_name);
 
@@ -603,11 +807,8 @@ void *ipc_log_context_create(int max_num_pages,
 	return (void *)ctxt;
 
 release_ipc_log_context:
-	while (page_cnt-- > 0) {
-		pg = get_first_page(ctxt);
-		list_del(&pg->hdr.list);
-		kfree(pg);
-	}
+	ipc_log_free_pages(ctxt);
+	free_percpu(ctxt->cpu);
 	kfree(ctxt);
 	return 0;
 }
@@ -621,22 +822,25 @@ EXPORT_SYMBOL(ipc_log_context_create);
 int ipc_log_context_destroy(void *ctxt)
 {
 	struct ipc_log_context *ilctxt = (struct ipc_log_context *)ctxt;
-	struct ipc_log_page *pg = NULL;
+	struct dfunc_info *df_info, *tmp;
 	unsigned long flags;
 
 	if (!ilctxt)
 		return 0;
 
-	while (!list_empty(&ilctxt->page_list)) {
-		pg = get_first_page(ctxt);
-		list_del(&pg->hdr.list);
-		kfree(pg);
-	}
+	if (!IS_ERR_OR_NULL(ilctxt->dent))
+		debugfs_remove_recursive(ilctxt->dent);
 
 	write_lock_irqsave(&ipc_log_context_list_lock, flags);
 	list_del(&ilctxt->list);
 	write_unlock_irqrestore(&ipc_log_context_list_lock, flags);
 
+	ipc_log_free_pages(ilctxt);
+	free_percpu(ilctxt->cpu);
+
+	list_for_each_entry_safe(df_info, tmp, &ilctxt->dfunc_info_list, list)
+		kfree(df_info);
+
 	kfree(ilctxt);
 	return 0;
 }
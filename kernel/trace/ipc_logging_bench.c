@@ -0,0 +1,92 @@
+/*
+ * IPC logging benchmark
+ *
+ * Logs to a scratch context from every online CPU at the same time, the
+ * way busy IPC drivers do, and prints the average cost per call of
+ * ipc_log_string() with integer and string arguments and of
+ * ipc_log_write() with a pre-encoded message.
+ */
+
+#include <linux/module.h>
+#include <linux/ipc_logging.h>
+
+#include "cpu_bench.h"
+
+#define LOOPS		10000
+#define LOG_PAGES	4
+
+enum {
+	BENCH_INT,
+	BENCH_STR,
+	BENCH_RAW,
+	NR_BENCH,
+};
+
+static const char *bench_names[NR_BENCH] = {
+	"ipc_log_string(ints)",
+	"ipc_log_string(str)",
+	"ipc_log_write",
+};
+
+static void *bench_ctxt;
+static int bench_type;
+
+static void bench_cpu(struct cpu_bench *bench)
+{
+	struct encode_context ectxt;
+	int i;
+
+	for (i = 0; i < bench->loops; i++) {
+		switch (bench_type) {
+		case BENCH_INT:
+			ipc_log_string(bench_ctxt, "cpu %d seq %d len %u",
+				       smp_processor_id(), i, 64U);
+			break;
+		case BENCH_STR:
+			ipc_log_string(bench_ctxt, "%s: port %08x tx %d",
+				       "ipc_router", 0x1234, i);
+			break;
+		case BENCH_RAW:
+			msg_encode_start(&ectxt, TSV_TYPE_STRING);
+			tsv_timestamp_write(&ectxt);
+			tsv_byte_array_write(&ectxt, "raw", 3);
+			msg_encode_end(&ectxt);
+			ipc_log_write(bench_ctxt, &ectxt);
+			break;
+		}
+	}
+}
+
+static struct cpu_bench bench = {
+	.run	= bench_cpu,
+	.loops	= LOOPS,
+};
+
+static int __init ipc_logging_bench_init(void)
+{
+	unsigned int cpus;
+	u64 ns;
+
+	bench_ctxt = ipc_log_context_create(LOG_PAGES, "ipc_logging_bench");
+	if (!bench_ctxt)
+		return -ENOMEM;
+
+	for (bench_type = 0; bench_type < NR_BENCH; bench_type++) {
+		ns = cpu_bench_run(&bench, &cpus);
+		pr_info("ipc_logging_bench: %-22s %llu ns per call on %u cpus\n",
+			bench_names[bench_type], (unsigned long long)ns, cpus);
+	}
+
+	ipc_log_context_destroy(bench_ctxt);
+	return -EAGAIN; /* Fail will directly unload the module */
+}
+
+static void __exit ipc_logging_bench_exit(void)
+{
+}
+
+module_init(ipc_logging_bench_init)
+module_exit(ipc_logging_bench_exit)
+
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("IPC logging benchmark");
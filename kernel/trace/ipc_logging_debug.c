@@ -46,8 +46,8 @@ static int debug_log(struct ipc_log_context *ilctxt,
 	do {
 		i = ipc_log_extract(ilctxt, buff, size - 1);
 		if (cont && i == 0) {
-			wait_for_completion_interruptible(&ilctxt->read_avail);
-			if (signal_pending(current))
+			if (wait_event_interruptible(ilctxt->read_wait,
+						     !is_ilctxt_empty(ilctxt)))
 				break;
 		}
 	} while (cont && i == 0);
@@ -132,7 +132,7 @@ static void dfunc_string(struct encode_context *ectxt,
 			 struct decode_context *dctxt)
 {
 	tsv_timestamp_read(ectxt, dctxt, " ");
-	tsv_byte_array_read(ectxt, dctxt, "");
+	tsv_string_read(ectxt, dctxt);
 
 	/* add trailing \n if necessary */
 	if (*(dctxt->buff - 1) != '\n') {
@@ -14,6 +14,8 @@
 #define _IPC_LOGGING_PRIVATE_H
 
 #include <linux/ipc_logging.h>
+#include <linux/percpu.h>
+#include <linux/wait.h>
 
 struct ipc_log_page_header {
 	uint32_t magic;
@@ -22,6 +24,7 @@ struct ipc_log_page_header {
 	uint32_t page_num;
 	uint16_t read_offset;
 	uint16_t write_offset;
+	uint32_t version; /* IPC_LOGGING_PAGE_VERSION */
 	struct list_head list;
 };
 
@@ -30,18 +33,31 @@ struct ipc_log_page {
 	char data[PAGE_SIZE - sizeof(struct ipc_log_page_header)];
 };
 
-struct ipc_log_context {
-	struct list_head list;
+#define LOG_PAGE_DATA_SIZE (PAGE_SIZE - sizeof(struct ipc_log_page_header))
+
+/*
+ * Every CPU appends to a page ring of its own, so writers on different
+ * CPUs never share a lock or a cache line.  Each message is preceded by
+ * its local_clock() stamp, which the reader uses to merge the rings back
+ * into a single stream.
+ */
+struct ipc_log_cpu {
+	spinlock_t lock;
 	struct list_head page_list;
 	struct ipc_log_page *first_page;
 	struct ipc_log_page *last_page;
 	struct ipc_log_page *write_page;
 	struct ipc_log_page *read_page;
 	uint32_t write_avail;
+};
+
+struct ipc_log_context {
+	struct list_head list;
+	struct ipc_log_cpu __percpu *cpu;
 	struct dentry *dent;
 	struct list_head dfunc_info_list;
 	spinlock_t ipc_log_context_lock;
-	struct completion read_avail;
+	wait_queue_head_t read_wait;
 };
 
 struct dfunc_info {
@@ -56,31 +72,58 @@ enum {
 	TSV_TYPE_POINTER,
 	TSV_TYPE_INT32,
 	TSV_TYPE_BYTE_ARRAY,
+	TSV_TYPE_BPRINTF,	/* format pointer and vbin_printf() arguments */
 };
 
 enum {
 	OUTPUT_DEBUGFS,
 };
 
-#define IPC_LOGGING_MAGIC_NUM 0x52784425
+/*
+ * Page format for offline parsers.  Pages with IPC_LOGGING_MAGIC_NUM_V1
+ * have no version field, hold one ring per context and plain messages.
+ * Pages with IPC_LOGGING_MAGIC_NUM carry the version field, which shifts
+ * the list head by 4 bytes on 32-bit.  Version 2 pages belong to a
+ * per-CPU ring (page_num / pages per CPU gives the CPU), every message is
+ * preceded by a u64 local_clock() stamp, and TSV_TYPE_BPRINTF items store
+ * a kernel format pointer followed by vbin_printf() arguments.
+ */
+#define IPC_LOGGING_MAGIC_NUM_V1 0x52784425
+#define IPC_LOGGING_MAGIC_NUM 0x52784426
+#define IPC_LOGGING_PAGE_VERSION 2
 #define MIN(x, y) ((x) < (y) ? (x) : (y))
 #define IS_MSG_TYPE(x) (((x) > TSV_TYPE_MSG_START) && \
 			((x) < TSV_TYPE_MSG_END))
 #define MAX_MSG_DECODED_SIZE (MAX_MSG_SIZE*4)
+#define BPRINTF_WORDS (MAX_MSG_SIZE / sizeof(u32))
 
 extern rwlock_t ipc_log_context_list_lock;
 
-extern int msg_read(struct ipc_log_context *ilctxt,
+extern int msg_read(struct ipc_log_cpu *ring,
 		    struct encode_context *ectxt);
 
+void tsv_string_read(struct encode_context *ectxt,
+		     struct decode_context *dctxt);
+
+static inline int is_ring_empty(struct ipc_log_cpu *ring)
+{
+	return ((ring->read_page == ring->write_page) &&
+		(ring->read_page->hdr.read_offset ==
+		 ring->write_page->hdr.write_offset));
+}
+
+/* Without the ring locks, only good as a hint for sleeping readers */
 static inline int is_ilctxt_empty(struct ipc_log_context *ilctxt)
 {
+	int cpu;
+
 	if (!ilctxt)
 		return -EINVAL;
 
-	return ((ilctxt->read_page == ilctxt->write_page) &&
-		(ilctxt->read_page->hdr.read_offset ==
-		 ilctxt->write_page->hdr.write_offset));
+	for_each_possible_cpu(cpu)
+		if (!is_ring_empty(per_cpu_ptr(ilctxt->cpu, cpu)))
+			return 0;
+	return 1;
 }
 
 #if (defined(CONFIG_DEBUG_FS))
@@ -21,6 +21,7 @@
 #include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/string.h>
+#include <linux/timex.h>
 #include <linux/atomic.h>
 #include <linux/of.h>
 #include <linux/of_address.h>
@@ -35,16 +36,22 @@
 #define RTB_COMPAT_STR	"qcom,msm-rtb"
 
 /* Write
- * 1) 11 bytes sentinel
- * 2) 1 bytes of log type
- * 3) 8 bytes of where the caller came from
- * 4) 4 bytes index
- * 4) 8 bytes extra data from the caller
+ * 1) 3 bytes sentinel
+ * 2) 1 byte of the cpu that logged
+ * 3) 4 bytes of the cycle counter, to order entries of different cpus
+ * 4) 3 bytes reserved
+ * 5) 1 bytes of log type
+ * 6) 4 bytes index
+ * 7) 8 bytes of where the caller came from
+ * 8) 8 bytes extra data from the caller
  *
  * Total = 32 bytes.
  */
 struct msm_rtb_layout {
-	unsigned char sentinel[11];
+	unsigned char sentinel[3];
+	unsigned char cpu;
+	uint32_t cycles;
+	unsigned char reserved[3];
 	unsigned char log_type;
 	uint32_t idx;
 	uint64_t caller;
@@ -60,11 +67,22 @@ struct msm_rtb_state {
 	int enabled;
 	int initialized;
 	uint32_t filter;
-	int step_size;
+	unsigned long addr_start;
+	unsigned long addr_end;
 };
 
 #if defined(CONFIG_MSM_RTB_SEPARATE_CPUS)
-DEFINE_PER_CPU(atomic_t, msm_rtb_idx_cpu);
+/*
+ * Each cpu owns a contiguous slice of the buffer and its own index, so
+ * logging never writes a cache line or an index another cpu writes.
+ */
+struct msm_rtb_cpu {
+	struct msm_rtb_layout *rtb;
+	int nentries;
+	atomic_t idx;
+};
+
+static DEFINE_PER_CPU(struct msm_rtb_cpu, msm_rtb_cpu);
 #else
 static atomic_t msm_rtb_idx;
 #endif
@@ -74,13 +92,55 @@ static struct msm_rtb_state msm_rtb = {
 	.enabled = 0,
 };
 
-module_param_named(filter, msm_rtb.filter, uint, 0644);
-module_param_named(enable, msm_rtb.enabled, int, 0644);
+/* filter if enabled and initialized, 0 otherwise: one load to check */
+static uint32_t msm_rtb_active __read_mostly;
+
+static void msm_rtb_update_active(void)
+{
+	ACCESS_ONCE(msm_rtb_active) = (msm_rtb.initialized &&
+				       msm_rtb.enabled) ? msm_rtb.filter : 0;
+}
+
+static int msm_rtb_set_filter(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_uint(val, kp);
+
+	if (!ret)
+		msm_rtb_update_active();
+	return ret;
+}
+
+static struct kernel_param_ops msm_rtb_filter_ops = {
+	.set = msm_rtb_set_filter,
+	.get = param_get_uint,
+};
+
+static int msm_rtb_set_enable(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_int(val, kp);
+
+	if (!ret)
+		msm_rtb_update_active();
+	return ret;
+}
+
+static struct kernel_param_ops msm_rtb_enable_ops = {
+	.set = msm_rtb_set_enable,
+	.get = param_get_int,
+};
+
+module_param_cb(filter, &msm_rtb_filter_ops, &msm_rtb.filter, 0644);
+module_param_cb(enable, &msm_rtb_enable_ops, &msm_rtb.enabled, 0644);
+
+/* readl/writel outside [addr_start, addr_end) are not logged if addr_end */
+module_param_named(addr_start, msm_rtb.addr_start, ulong, 0644);
+module_param_named(addr_end, msm_rtb.addr_end, ulong, 0644);
 
 static int msm_rtb_panic_notifier(struct notifier_block *this,
 					unsigned long event, void *ptr)
 {
 	msm_rtb.enabled = 0;
+	msm_rtb_update_active();
 	return NOTIFY_DONE;
 }
 
@@ -90,11 +150,26 @@ static struct notifier_block msm_rtb_panic_blk = {
 
 int notrace msm_rtb_event_should_log(enum logk_event_type log_type)
 {
-	return msm_rtb.initialized && msm_rtb.enabled &&
-		((1 << (log_type & ~LOGTYPE_NOPC)) & msm_rtb.filter);
+	return (1 << (log_type & ~LOGTYPE_NOPC)) & ACCESS_ONCE(msm_rtb_active);
 }
 EXPORT_SYMBOL(msm_rtb_event_should_log);
 
+static bool notrace msm_rtb_addr_filtered(enum logk_event_type log_type,
+					  void *data)
+{
+	unsigned long addr = (unsigned long)data;
+	unsigned long end = ACCESS_ONCE(msm_rtb.addr_end);
+
+	if (!end)
+		return false;
+
+	log_type &= ~LOGTYPE_NOPC;
+	if (log_type != LOGK_READL && log_type != LOGK_WRITEL)
+		return false;
+
+	return addr < ACCESS_ONCE(msm_rtb.addr_start) || addr >= end;
+}
+
 static void msm_rtb_emit_sentinel(struct msm_rtb_layout *start)
 {
 	start->sentinel[0] = SENTINEL_BYTE_1;
@@ -124,14 +199,18 @@ static void msm_rtb_write_data(uint64_t data, struct msm_rtb_layout *start)
 	start->data = data;
 }
 
-static void uncached_logk_pc_idx(enum logk_event_type log_type, uint64_t caller,
-				 uint64_t data, int idx)
+static void msm_rtb_write_order(int cpu, struct msm_rtb_layout *start)
 {
-	struct msm_rtb_layout *start;
-
-	start = &msm_rtb.rtb[idx & (msm_rtb.nentries - 1)];
+	start->cpu = cpu;
+	start->cycles = (uint32_t)get_cycles();
+}
 
+static void uncached_logk_pc_idx(struct msm_rtb_layout *start,
+				 enum logk_event_type log_type, uint64_t caller,
+				 uint64_t data, int idx, int cpu)
+{
 	msm_rtb_emit_sentinel(start);
+	msm_rtb_write_order(cpu, start);
 	msm_rtb_write_type(log_type, start);
 	msm_rtb_write_caller(caller, start);
 	msm_rtb_write_idx(idx, start);
@@ -141,49 +220,48 @@ static void uncached_logk_pc_idx(enum logk_event_type log_type, uint64_t caller,
 	return;
 }
 
-static void uncached_logk_timestamp(int idx)
+static void uncached_logk_timestamp(struct msm_rtb_layout *start, int idx,
+				    int cpu)
 {
 	unsigned long long timestamp;
 
 	timestamp = sched_clock();
-	uncached_logk_pc_idx(LOGK_TIMESTAMP|LOGTYPE_NOPC,
+	uncached_logk_pc_idx(start, LOGK_TIMESTAMP|LOGTYPE_NOPC,
 			(uint64_t)lower_32_bits(timestamp),
-			(uint64_t)upper_32_bits(timestamp), idx);
+			(uint64_t)upper_32_bits(timestamp), idx, cpu);
 }
 
 #if defined(CONFIG_MSM_RTB_SEPARATE_CPUS)
-static int msm_rtb_get_idx(void)
+static struct msm_rtb_layout *msm_rtb_get_entry(int *idx, int *cpu)
 {
-	int cpu, i, offset;
-	atomic_t *index;
+	struct msm_rtb_cpu *rc;
+	int i;
 
 	/*
 	 * ideally we would use get_cpu but this is a close enough
 	 * approximation for our purposes.
 	 */
-	cpu = raw_smp_processor_id();
-
-	index = &per_cpu(msm_rtb_idx_cpu, cpu);
+	*cpu = raw_smp_processor_id();
+	rc = &per_cpu(msm_rtb_cpu, *cpu);
 
-	i = atomic_add_return(msm_rtb.step_size, index);
-	i -= msm_rtb.step_size;
+	i = atomic_inc_return(&rc->idx) - 1;
 
-	/* Check if index has wrapped around */
-	offset = (i & (msm_rtb.nentries - 1)) -
-		 ((i - msm_rtb.step_size) & (msm_rtb.nentries - 1));
-	if (offset < 0) {
-		uncached_logk_timestamp(i);
-		i = atomic_add_return(msm_rtb.step_size, index);
-		i -= msm_rtb.step_size;
+	/* Start every lap of the slice with a timestamp */
+	if (!(i & (rc->nentries - 1))) {
+		uncached_logk_timestamp(rc->rtb, i, *cpu);
+		i = atomic_inc_return(&rc->idx) - 1;
 	}
 
-	return i;
+	*idx = i;
+	return &rc->rtb[i & (rc->nentries - 1)];
 }
 #else
-static int msm_rtb_get_idx(void)
+static struct msm_rtb_layout *msm_rtb_get_entry(int *idx, int *cpu)
 {
 	int i, offset;
 
+	*cpu = raw_smp_processor_id();
+
 	i = atomic_inc_return(&msm_rtb_idx);
 	i--;
 
@@ -191,26 +269,33 @@ static int msm_rtb_get_idx(void)
 	offset = (i & (msm_rtb.nentries - 1)) -
 		 ((i - 1) & (msm_rtb.nentries - 1));
 	if (offset < 0) {
-		uncached_logk_timestamp(i);
+		uncached_logk_timestamp(&msm_rtb.rtb[i & (msm_rtb.nentries - 1)],
+					i, *cpu);
 		i = atomic_inc_return(&msm_rtb_idx);
 		i--;
 	}
 
-	return i;
+	*idx = i;
+	return &msm_rtb.rtb[i & (msm_rtb.nentries - 1)];
 }
 #endif
 
 int notrace uncached_logk_pc(enum logk_event_type log_type, void *caller,
 				void *data)
 {
-	int i;
+	struct msm_rtb_layout *start;
+	int i, cpu;
 
 	if (!msm_rtb_event_should_log(log_type))
 		return 0;
 
-	i = msm_rtb_get_idx();
-	uncached_logk_pc_idx(log_type, (uint64_t)((unsigned long) caller),
-				(uint64_t)((unsigned long) data), i);
+	if (msm_rtb_addr_filtered(log_type, data))
+		return 0;
+
+	start = msm_rtb_get_entry(&i, &cpu);
+	uncached_logk_pc_idx(start, log_type,
+				(uint64_t)((unsigned long) caller),
+				(uint64_t)((unsigned long) data), i, cpu);
 
 	return 1;
 }
@@ -227,6 +312,7 @@ static int msm_rtb_probe(struct platform_device *pdev)
 	struct msm_rtb_platform_data *d = pdev->dev.platform_data;
 #if defined(CONFIG_MSM_RTB_SEPARATE_CPUS)
 	unsigned int cpu;
+	int i, nentries;
 #endif
 	int ret;
 
@@ -278,19 +364,29 @@ static int msm_rtb_probe(struct platform_device *pdev)
 
 
 #if defined(CONFIG_MSM_RTB_SEPARATE_CPUS)
+	nentries = msm_rtb.nentries / num_possible_cpus();
+	if (nentries < 2) {
+		dma_free_coherent(&pdev->dev, msm_rtb.size, msm_rtb.rtb,
+				  msm_rtb.phys);
+		return -EINVAL;
+	}
+	nentries = __rounddown_pow_of_two(nentries);
+	i = 0;
 	for_each_possible_cpu(cpu) {
-		atomic_t *a = &per_cpu(msm_rtb_idx_cpu, cpu);
-		atomic_set(a, cpu);
+		struct msm_rtb_cpu *rc = &per_cpu(msm_rtb_cpu, cpu);
+
+		rc->rtb = &msm_rtb.rtb[i++ * nentries];
+		rc->nentries = nentries;
+		atomic_set(&rc->idx, 0);
 	}
-	msm_rtb.step_size = num_possible_cpus();
 #else
 	atomic_set(&msm_rtb_idx, 0);
-	msm_rtb.step_size = 1;
 #endif
 
 	atomic_notifier_chain_register(&panic_notifier_list,
 						&msm_rtb_panic_blk);
 	msm_rtb.initialized = 1;
+	msm_rtb_update_active();
 	return 0;
 }
 
@@ -0,0 +1,65 @@
+/*
+ * Register trace buffer benchmark
+ *
+ * Calls uncached_logk() from every online CPU at the same time, the way
+ * readl()/writel() heavy drivers do, and prints the average cost per call
+ * for an event type the filter drops and for register reads. Whether the
+ * reads were logged depends on msm_rtb.enable, msm_rtb.filter and the
+ * msm_rtb.addr_start/addr_end range at the time the benchmark runs, and
+ * is reported next to the numbers.
+ */
+
+#include <linux/module.h>
+#include <linux/msm_rtb.h>
+
+#include "cpu_bench.h"
+
+#define LOOPS		100000
+
+static enum logk_event_type bench_type;
+static atomic_t bench_logged;
+static u32 bench_reg;
+
+static void bench_cpu(struct cpu_bench *bench)
+{
+	int i, logged = 0;
+
+	for (i = 0; i < bench->loops; i++)
+		logged += uncached_logk(bench_type, &bench_reg);
+	atomic_add(logged, &bench_logged);
+}
+
+static struct cpu_bench bench = {
+	.run	= bench_cpu,
+	.loops	= LOOPS,
+};
+
+static void bench_run(enum logk_event_type type, const char *name)
+{
+	unsigned int cpus;
+	u64 ns;
+
+	bench_type = type;
+	atomic_set(&bench_logged, 0);
+	ns = cpu_bench_run(&bench, &cpus);
+	pr_info("msm_rtb_bench: %-8s %llu ns per call on %u cpus, %d logged\n",
+		name, (unsigned long long)ns, cpus,
+		atomic_read(&bench_logged));
+}
+
+static int __init msm_rtb_bench_init(void)
+{
+	bench_run(LOGK_NONE, "filtered");
+	bench_run(LOGK_READL, "readl");
+	return -EAGAIN; /* Fail will directly unload the module */
+}
+
+static void __exit msm_rtb_bench_exit(void)
+{
+}
+
+module_init(msm_rtb_bench_init)
+module_exit(msm_rtb_bench_exit)
+
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("Register trace buffer benchmark");
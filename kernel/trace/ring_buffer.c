@@ -5,6 +5,7 @@
  */
 #include <linux/ftrace_event.h>
 #include <linux/ring_buffer.h>
+#include <linux/trace_mmap.h>
 #include <linux/trace_clock.h>
 #include <linux/trace_seq.h>
 #include <linux/spinlock.h>
@@ -356,6 +357,7 @@ struct buffer_page {
 	unsigned	 read;		/* index for next read */
 	local_t		 entries;	/* entries on this page */
 	unsigned long	 real_end;	/* real end of data */
+	unsigned	 id;		/* sub-buffer id when mapped */
 	struct buffer_data_page *page;	/* Actual data page */
 };
 
@@ -489,6 +491,11 @@ struct ring_buffer_per_cpu {
 	struct completion		update_done;
 
 	struct rb_irq_work		irq_work;
+
+	/* user space mapping, see ring_buffer_map() */
+	int				mapped;
+	struct trace_buffer_meta	*meta_page;
+	unsigned long			*subbuf_ids;	/* id -> data page */
 };
 
 struct ring_buffer {
@@ -1666,6 +1673,16 @@ int ring_buffer_resize(struct ring_buffer *buffer, unsigned long size,
 	/* prevent another thread from changing buffer sizes */
 	mutex_lock(&buffer->mutex);
 
+	/* user space has the pages of a mapped buffer, leave them alone */
+	for_each_buffer_cpu(buffer, cpu) {
+		if (cpu_id != RING_BUFFER_ALL_CPUS && cpu != cpu_id)
+			continue;
+		if (buffer->buffers[cpu]->mapped) {
+			mutex_unlock(&buffer->mutex);
+			return -EBUSY;
+		}
+	}
+
 	if (cpu_id == RING_BUFFER_ALL_CPUS) {
 		/* calculate the pages to update */
 		for_each_buffer_cpu(buffer, cpu) {
@@ -4340,6 +4357,10 @@ int ring_buffer_swap_cpu(struct ring_buffer *buffer_a,
 	if (atomic_read(&cpu_buffer_b->record_disabled))
 		goto out;
 
+	ret = -EBUSY;
+	if (cpu_buffer_a->mapped || cpu_buffer_b->mapped)
+		goto out;
+
 	/*
 	 * We can't do a synchronize_sched here because this
 	 * function can be called in atomic context.
@@ -4501,12 +4522,14 @@ int ring_buffer_read_page(struct ring_buffer *buffer,
 	/*
 	 * If this page has been partially read or
 	 * if len is not big enough to read the rest of the page or
-	 * a writer is still on the page, then
+	 * a writer is still on the page or
+	 * the pages are mapped to user space, then
 	 * we must copy the data from the page to the buffer.
 	 * Otherwise, we can simply swap the page with the one passed in.
 	 */
 	if (read || (len < (commit - read)) ||
-	    cpu_buffer->reader_page == cpu_buffer->commit_page) {
+	    cpu_buffer->reader_page == cpu_buffer->commit_page ||
+	    cpu_buffer->mapped) {
 		struct buffer_data_page *rpage = cpu_buffer->reader_page->page;
 		unsigned int rpos = read;
 		unsigned int pos = 0;
@@ -4615,6 +4638,259 @@ int ring_buffer_read_page(struct ring_buffer *buffer,
 }
 EXPORT_SYMBOL_GPL(ring_buffer_read_page);
 
+static void rb_update_meta_page(struct ring_buffer_per_cpu *cpu_buffer)
+{
+	struct trace_buffer_meta *meta = cpu_buffer->meta_page;
+
+	meta->entries = local_read(&cpu_buffer->entries);
+	meta->overrun = local_read(&cpu_buffer->overrun);
+	meta->read = cpu_buffer->read;
+}
+
+static int rb_setup_ids_meta_page(struct ring_buffer_per_cpu *cpu_buffer)
+{
+	struct trace_buffer_meta *meta = cpu_buffer->meta_page;
+	struct buffer_page *first, *bpage;
+	unsigned id = 0;
+
+	first = rb_set_head_page(cpu_buffer);
+	if (!first)
+		return -ENODEV;
+
+	/* the reader page is sub-buffer 0, the ring follows from the head */
+	cpu_buffer->subbuf_ids[id] = (unsigned long)cpu_buffer->reader_page->page;
+	cpu_buffer->reader_page->id = id++;
+
+	bpage = first;
+	do {
+		if (RB_WARN_ON(cpu_buffer, id > cpu_buffer->nr_pages))
+			return -EINVAL;
+		cpu_buffer->subbuf_ids[id] = (unsigned long)bpage->page;
+		bpage->id = id++;
+		rb_inc_page(cpu_buffer, &bpage);
+	} while (bpage != first);
+
+	meta->meta_page_size = PAGE_SIZE;
+	meta->meta_struct_len = sizeof(*meta);
+	meta->subbuf_size = PAGE_SIZE;
+	meta->nr_subbufs = id;
+
+	/* nothing handed out yet */
+	meta->reader.id = cpu_buffer->reader_page->id;
+	meta->reader.read = cpu_buffer->reader_page->read;
+	meta->reader.commit = cpu_buffer->reader_page->read;
+	meta->reader.lost_events = 0;
+	rb_update_meta_page(cpu_buffer);
+
+	return 0;
+}
+
+/**
+ * ring_buffer_map - prepare a cpu buffer to be mapped to user space
+ * @buffer: the buffer the cpu buffer belongs to
+ * @cpu: the cpu buffer to map
+ *
+ * Gives every data page of the cpu buffer a sub-buffer id and sets up the
+ * meta page describing them (see include/uapi/linux/trace_mmap.h). While
+ * a cpu buffer is mapped its pages are fixed: it cannot be resized or
+ * swapped, and ring_buffer_read_page() copies instead of swapping pages.
+ * Calls nest; each must be paired with ring_buffer_unmap().
+ *
+ * Returns 0 on success, negative errno otherwise.
+ */
+int ring_buffer_map(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct trace_buffer_meta *meta;
+	unsigned long *subbuf_ids;
+	unsigned long flags;
+	int err = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&buffer->mutex);
+
+	if (cpu_buffer->mapped) {
+		cpu_buffer->mapped++;
+		goto out;
+	}
+
+	/* the ring plus the reader page */
+	subbuf_ids = kcalloc(cpu_buffer->nr_pages + 1, sizeof(*subbuf_ids),
+			     GFP_KERNEL);
+	meta = (void *)get_zeroed_page(GFP_KERNEL);
+	if (!subbuf_ids || !meta) {
+		kfree(subbuf_ids);
+		free_page((unsigned long)meta);
+		err = -ENOMEM;
+		goto out;
+	}
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	cpu_buffer->subbuf_ids = subbuf_ids;
+	cpu_buffer->meta_page = meta;
+	err = rb_setup_ids_meta_page(cpu_buffer);
+	if (err) {
+		cpu_buffer->subbuf_ids = NULL;
+		cpu_buffer->meta_page = NULL;
+	} else {
+		cpu_buffer->mapped = 1;
+	}
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	if (err) {
+		kfree(subbuf_ids);
+		free_page((unsigned long)meta);
+	}
+ out:
+	mutex_unlock(&buffer->mutex);
+	return err;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map);
+
+/**
+ * ring_buffer_unmap - drop a mapping taken with ring_buffer_map()
+ * @buffer: the buffer the cpu buffer belongs to
+ * @cpu: the mapped cpu buffer
+ *
+ * The caller must make sure user space can no longer reach the meta page.
+ */
+int ring_buffer_unmap(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct trace_buffer_meta *meta = NULL;
+	unsigned long *subbuf_ids = NULL;
+	unsigned long flags;
+	int err = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&buffer->mutex);
+
+	if (!cpu_buffer->mapped) {
+		err = -ENODEV;
+	} else if (!--cpu_buffer->mapped) {
+		raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+		meta = cpu_buffer->meta_page;
+		subbuf_ids = cpu_buffer->subbuf_ids;
+		cpu_buffer->meta_page = NULL;
+		cpu_buffer->subbuf_ids = NULL;
+		raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+	}
+
+	mutex_unlock(&buffer->mutex);
+
+	kfree(subbuf_ids);
+	free_page((unsigned long)meta);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_unmap);
+
+/**
+ * ring_buffer_map_fault - find the page backing an offset of the mapping
+ * @buffer: the buffer the cpu buffer belongs to
+ * @cpu: the mapped cpu buffer
+ * @pgoff: page offset into the mapping
+ *
+ * Page 0 is the meta page, page N + 1 is sub-buffer N. Returns NULL if
+ * @pgoff is out of range or the cpu buffer is not mapped.
+ */
+struct page *ring_buffer_map_fault(struct ring_buffer *buffer, int cpu,
+				   unsigned long pgoff)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return NULL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	/* stable as long as the mapping that faults exists */
+	if (!cpu_buffer->mapped)
+		return NULL;
+
+	if (!pgoff)
+		return virt_to_page(cpu_buffer->meta_page);
+
+	if (pgoff > cpu_buffer->meta_page->nr_subbufs)
+		return NULL;
+
+	return virt_to_page((void *)cpu_buffer->subbuf_ids[pgoff - 1]);
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map_fault);
+
+/**
+ * ring_buffer_map_get_reader - hand the next sub-buffer to a mapped reader
+ * @buffer: the buffer the cpu buffer belongs to
+ * @cpu: the mapped cpu buffer
+ *
+ * Consumes what is left of the current reader page on behalf of user space
+ * and publishes the reader page with the new events in the meta page. If
+ * the writer is still on that page, the following call returns the same
+ * sub-buffer with the events added since.
+ *
+ * Returns 0 on success, -ENODEV if the cpu buffer is not mapped.
+ */
+int ring_buffer_map_get_reader(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct trace_buffer_meta *meta;
+	struct buffer_page *reader;
+	unsigned long flags;
+	unsigned read, commit;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+
+	if (!cpu_buffer->mapped) {
+		raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+		return -ENODEV;
+	}
+
+	meta = cpu_buffer->meta_page;
+
+	reader = rb_get_reader_page(cpu_buffer);
+	if (!reader) {
+		/* empty, publish an empty range on the current page */
+		reader = cpu_buffer->reader_page;
+		meta->reader.id = reader->id;
+		meta->reader.read = reader->read;
+		meta->reader.commit = reader->read;
+		meta->reader.lost_events = 0;
+		goto out;
+	}
+
+	read = reader->read;
+	commit = rb_page_commit(reader);
+
+	/* user space owns the events up to commit now */
+	while (reader->read < commit)
+		rb_advance_reader(cpu_buffer);
+
+	meta->reader.id = reader->id;
+	meta->reader.read = read;
+	meta->reader.commit = commit;
+	meta->reader.lost_events = cpu_buffer->lost_events;
+	cpu_buffer->lost_events = 0;
+ out:
+	rb_update_meta_page(cpu_buffer);
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map_get_reader);
+
 #ifdef CONFIG_HOTPLUG_CPU
 static int rb_cpu_notify(struct notifier_block *self,
 			 unsigned long action, void *hcpu)
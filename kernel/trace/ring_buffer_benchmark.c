@@ -7,7 +7,9 @@
 #include <linux/completion.h>
 #include <linux/kthread.h>
 #include <linux/module.h>
+#include <linux/mm.h>
 #include <linux/time.h>
+#include <linux/trace_mmap.h>
 #include <asm/local.h>
 
 struct rb_page {
@@ -36,6 +38,10 @@ static int disable_reader;
 module_param(disable_reader, uint, 0644);
 MODULE_PARM_DESC(disable_reader, "only run producer");
 
+static int mmap_reader;
+module_param(mmap_reader, uint, 0444);
+MODULE_PARM_DESC(mmap_reader, "consume through the mmap interface");
+
 static int write_iteration = 50;
 module_param(write_iteration, uint, 0644);
 MODULE_PARM_DESC(write_iteration, "# of writes between timestamp readings");
@@ -95,76 +101,83 @@ static enum event_status read_event(int cpu)
 	return EVENT_FOUND;
 }
 
-static enum event_status read_page(int cpu)
+static void read_page_events(int cpu, struct rb_page *rpage,
+			     unsigned long start, unsigned long commit)
 {
 	struct ring_buffer_event *event;
-	struct rb_page *rpage;
-	unsigned long commit;
-	void *bpage;
 	int *entry;
-	int ret;
 	int inc;
 	int i;
 
-	bpage = ring_buffer_alloc_read_page(buffer, cpu);
-	if (!bpage)
-		return EVENT_DROPPED;
+	for (i = start; i < commit && !kill_test; i += inc) {
 
-	ret = ring_buffer_read_page(buffer, &bpage, PAGE_SIZE, cpu, 1);
-	if (ret >= 0) {
-		rpage = bpage;
-		/* The commit may have missed event flags set, clear them */
-		commit = local_read(&rpage->commit) & 0xfffff;
-		for (i = 0; i < commit && !kill_test; i += inc) {
+		if (i >= (PAGE_SIZE - offsetof(struct rb_page, data))) {
+			KILL_TEST();
+			break;
+		}
 
-			if (i >= (PAGE_SIZE - offsetof(struct rb_page, data))) {
+		inc = -1;
+		event = (void *)&rpage->data[i];
+		switch (event->type_len) {
+		case RINGBUF_TYPE_PADDING:
+			/* failed writes may be discarded events */
+			if (!event->time_delta)
+				KILL_TEST();
+			inc = event->array[0] + 4;
+			break;
+		case RINGBUF_TYPE_TIME_EXTEND:
+			inc = 8;
+			break;
+		case 0:
+			entry = ring_buffer_event_data(event);
+			if (*entry != cpu) {
 				KILL_TEST();
 				break;
 			}
-
-			inc = -1;
-			event = (void *)&rpage->data[i];
-			switch (event->type_len) {
-			case RINGBUF_TYPE_PADDING:
-				/* failed writes may be discarded events */
-				if (!event->time_delta)
-					KILL_TEST();
-				inc = event->array[0] + 4;
-				break;
-			case RINGBUF_TYPE_TIME_EXTEND:
-				inc = 8;
-				break;
-			case 0:
-				entry = ring_buffer_event_data(event);
-				if (*entry != cpu) {
-					KILL_TEST();
-					break;
-				}
-				read++;
-				if (!event->array[0]) {
-					KILL_TEST();
-					break;
-				}
-				inc = event->array[0] + 4;
+			read++;
+			if (!event->array[0]) {
+				KILL_TEST();
 				break;
-			default:
-				entry = ring_buffer_event_data(event);
-				if (*entry != cpu) {
-					KILL_TEST();
-					break;
-				}
-				read++;
-				inc = ((event->type_len + 1) * 4);
 			}
-			if (kill_test)
-				break;
-
-			if (inc <= 0) {
+			inc = event->array[0] + 4;
+			break;
+		default:
+			entry = ring_buffer_event_data(event);
+			if (*entry != cpu) {
 				KILL_TEST();
 				break;
 			}
+			read++;
+			inc = ((event->type_len + 1) * 4);
+		}
+		if (kill_test)
+			break;
+
+		if (inc <= 0) {
+			KILL_TEST();
+			break;
 		}
 	}
+}
+
+static enum event_status read_page(int cpu)
+{
+	struct rb_page *rpage;
+	unsigned long commit;
+	void *bpage;
+	int ret;
+
+	bpage = ring_buffer_alloc_read_page(buffer, cpu);
+	if (!bpage)
+		return EVENT_DROPPED;
+
+	ret = ring_buffer_read_page(buffer, &bpage, PAGE_SIZE, cpu, 1);
+	if (ret >= 0) {
+		rpage = bpage;
+		/* The commit may have missed event flags set, clear them */
+		commit = local_read(&rpage->commit) & 0xfffff;
+		read_page_events(cpu, rpage, 0, commit);
+	}
 	ring_buffer_free_read_page(buffer, bpage);
 
 	if (ret < 0)
@@ -172,6 +185,31 @@ static enum event_status read_page(int cpu)
 	return EVENT_FOUND;
 }
 
+/* what a user space reader of a mapped trace_pipe_raw file does */
+static enum event_status read_mapped_page(int cpu)
+{
+	struct trace_buffer_meta *meta;
+	struct page *page;
+
+	/* cpus that came up after the module was loaded are not mapped */
+	if (ring_buffer_map_get_reader(buffer, cpu) < 0)
+		return EVENT_DROPPED;
+
+	meta = page_address(ring_buffer_map_fault(buffer, cpu, 0));
+	if (meta->reader.read == meta->reader.commit)
+		return EVENT_DROPPED;
+
+	page = ring_buffer_map_fault(buffer, cpu, meta->reader.id + 1);
+	if (!page) {
+		KILL_TEST();
+		return EVENT_DROPPED;
+	}
+
+	read_page_events(cpu, page_address(page), meta->reader.read,
+			 meta->reader.commit);
+	return EVENT_FOUND;
+}
+
 static void ring_buffer_consumer(void)
 {
 	/* toggle between reading pages and events */
@@ -188,7 +226,9 @@ static void ring_buffer_consumer(void)
 			for_each_online_cpu(cpu) {
 				enum event_status stat;
 
-				if (read_events)
+				if (mmap_reader)
+					stat = read_mapped_page(cpu);
+				else if (read_events)
 					stat = read_event(cpu);
 				else
 					stat = read_page(cpu);
@@ -317,6 +357,7 @@ static void ring_buffer_producer(void)
 		trace_printk("Read:     (reader disabled)\n");
 	else
 		trace_printk("Read:     %ld  (by %s)\n", read,
+			mmap_reader ? "mapped pages" :
 			read_events ? "events" : "pages");
 	trace_printk("Entries:  %lld\n", entries);
 	trace_printk("Total:    %lld\n", entries + overruns + read);
@@ -416,6 +457,33 @@ static int ring_buffer_producer_thread(void *arg)
 	return 0;
 }
 
+static cpumask_t rb_bench_mapped;
+
+static void rb_bench_unmap(void)
+{
+	int cpu;
+
+	for_each_cpu(cpu, &rb_bench_mapped)
+		ring_buffer_unmap(buffer, cpu);
+	cpumask_clear(&rb_bench_mapped);
+}
+
+/* the reader then measures the cost the mapping adds to the producer */
+static int rb_bench_map(void)
+{
+	int cpu, ret;
+
+	for_each_online_cpu(cpu) {
+		ret = ring_buffer_map(buffer, cpu);
+		if (ret) {
+			rb_bench_unmap();
+			return ret;
+		}
+		cpumask_set_cpu(cpu, &rb_bench_mapped);
+	}
+	return 0;
+}
+
 static int __init ring_buffer_benchmark_init(void)
 {
 	int ret;
@@ -426,11 +494,17 @@ static int __init ring_buffer_benchmark_init(void)
 		return -ENOMEM;
 
 	if (!disable_reader) {
+		if (mmap_reader) {
+			ret = rb_bench_map();
+			if (ret)
+				goto out_fail;
+		}
+
 		consumer = kthread_create(ring_buffer_consumer_thread,
 					  NULL, "rb_consumer");
 		ret = PTR_ERR(consumer);
 		if (IS_ERR(consumer))
-			goto out_fail;
+			goto out_unmap;
 	}
 
 	producer = kthread_run(ring_buffer_producer_thread,
@@ -467,6 +541,8 @@ static int __init ring_buffer_benchmark_init(void)
 	if (consumer)
 		kthread_stop(consumer);
 
+ out_unmap:
+	rb_bench_unmap();
  out_fail:
 	ring_buffer_free(buffer);
 	return ret;
@@ -477,6 +553,7 @@ static void __exit ring_buffer_benchmark_exit(void)
 	kthread_stop(producer);
 	if (consumer)
 		kthread_stop(consumer);
+	rb_bench_unmap();
 	ring_buffer_free(buffer);
 }
 
@@ -40,6 +40,7 @@
 #include <linux/fs.h>
 #include <linux/sched/rt.h>
 #include <linux/coresight-stm.h>
+#include <linux/trace_mmap.h>
 
 #include "trace.h"
 #include "trace_output.h"
@@ -500,6 +501,12 @@ int __trace_bputs(unsigned long ip, const char *str)
 }
 EXPORT_SYMBOL_GPL(__trace_bputs);
 
+/*
+ * Serializes mapping per_cpu trace_pipe_raw files against allocating the
+ * snapshot buffer: a snapshot swaps the buffers under a mapping.
+ */
+static DEFINE_MUTEX(trace_mmap_lock);
+
 #ifdef CONFIG_TRACER_SNAPSHOT
 /**
  * trace_snapshot - take a snapshot of the current buffer.
@@ -553,7 +560,14 @@ static void set_buffer_entries(struct trace_buffer *buf, unsigned long val);
 
 static int alloc_snapshot(struct trace_array *tr)
 {
-	int ret;
+	int ret = 0;
+
+	mutex_lock(&trace_mmap_lock);
+
+	if (tr->mapped) {
+		ret = -EBUSY;
+		goto out;
+	}
 
 	if (!tr->allocated_snapshot) {
 
@@ -561,12 +575,13 @@ static int alloc_snapshot(struct trace_array *tr)
 		ret = resize_buffer_duplicate_size(&tr->max_buffer,
 				   &tr->trace_buffer, RING_BUFFER_ALL_CPUS);
 		if (ret < 0)
-			return ret;
+			goto out;
 
 		tr->allocated_snapshot = true;
 	}
-
-	return 0;
+ out:
+	mutex_unlock(&trace_mmap_lock);
+	return ret;
 }
 
 void free_snapshot(struct trace_array *tr)
@@ -5371,12 +5386,111 @@ out:
 	return ret;
 }
 
+static long tracing_buffers_ioctl(struct file *file, unsigned int cmd,
+				  unsigned long arg)
+{
+	struct ftrace_buffer_info *info = file->private_data;
+	struct trace_iterator *iter = &info->iter;
+
+	if (cmd != TRACE_MMAP_IOCTL_GET_READER)
+		return -ENOTTY;
+
+	if (iter->cpu_file == RING_BUFFER_ALL_CPUS)
+		return -EINVAL;
+
+	return ring_buffer_map_get_reader(iter->trace_buffer->buffer,
+					  iter->cpu_file);
+}
+
+static void tracing_buffers_mmap_open(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+	struct trace_iterator *iter = &info->iter;
+
+	mutex_lock(&trace_mmap_lock);
+	WARN_ON(ring_buffer_map(iter->trace_buffer->buffer, iter->cpu_file));
+	iter->tr->mapped++;
+	mutex_unlock(&trace_mmap_lock);
+}
+
+static void tracing_buffers_mmap_close(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+	struct trace_iterator *iter = &info->iter;
+
+	mutex_lock(&trace_mmap_lock);
+	WARN_ON(ring_buffer_unmap(iter->trace_buffer->buffer, iter->cpu_file));
+	iter->tr->mapped--;
+	mutex_unlock(&trace_mmap_lock);
+}
+
+static int tracing_buffers_mmap_fault(struct vm_area_struct *vma,
+				      struct vm_fault *vmf)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+	struct trace_iterator *iter = &info->iter;
+	struct page *page;
+
+	page = ring_buffer_map_fault(iter->trace_buffer->buffer,
+				     iter->cpu_file, vmf->pgoff);
+	if (!page)
+		return VM_FAULT_SIGBUS;
+
+	get_page(page);
+	vmf->page = page;
+	return 0;
+}
+
+static const struct vm_operations_struct tracing_buffers_vmops = {
+	.open		= tracing_buffers_mmap_open,
+	.close		= tracing_buffers_mmap_close,
+	.fault		= tracing_buffers_mmap_fault,
+};
+
+static int tracing_buffers_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = filp->private_data;
+	struct trace_iterator *iter = &info->iter;
+	int ret;
+
+	/* only the per_cpu files have a single ring to map */
+	if (iter->cpu_file == RING_BUFFER_ALL_CPUS)
+		return -EINVAL;
+
+	/* user space reads, the pages are still the writer's */
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_flags |= VM_DONTCOPY | VM_DONTEXPAND | VM_DONTDUMP;
+
+	mutex_lock(&trace_mmap_lock);
+#ifdef CONFIG_TRACER_MAX_TRACE
+	if (iter->tr->allocated_snapshot) {
+		ret = -EBUSY;
+		goto out;
+	}
+#endif
+	ret = ring_buffer_map(iter->trace_buffer->buffer, iter->cpu_file);
+	if (ret)
+		goto out;
+
+	iter->tr->mapped++;
+	vma->vm_ops = &tracing_buffers_vmops;
+ out:
+	mutex_unlock(&trace_mmap_lock);
+	return ret;
+}
+
 static const struct file_operations tracing_buffers_fops = {
 	.open		= tracing_buffers_open,
 	.read		= tracing_buffers_read,
 	.poll		= tracing_buffers_poll,
 	.release	= tracing_buffers_release,
 	.splice_read	= tracing_buffers_splice_read,
+	.unlocked_ioctl	= tracing_buffers_ioctl,
+	.compat_ioctl	= tracing_buffers_ioctl,
+	.mmap		= tracing_buffers_mmap,
 	.llseek		= no_llseek,
 };
 
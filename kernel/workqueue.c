@@ -2175,6 +2175,8 @@ __acquires(&pool->lock)
 	worker->current_work = work;
 	worker->current_func = work->func;
 	worker->current_pwq = pwq;
+	worker->current_start = jiffies;
+	worker->hog_reported = false;
 	work_color = get_work_color(work);
 
 	list_del_init(&work->entry);
@@ -5077,6 +5079,100 @@ static void __init wq_numa_init(void)
 	wq_numa_enabled = true;
 }
 
+#ifdef CONFIG_WQ_WATCHDOG
+/*
+ * Work items sharing a pool with others delay them for as long as they
+ * run.  The watchdog periodically looks at the busy workers of all pools
+ * and warns, once per execution, about any work item that has been running
+ * for longer than workqueue.watchdog_thresh milliseconds (0 disables it).
+ * The timer is deferrable, so an idle system is not woken up for it.
+ */
+static void wq_watchdog_timer_fn(unsigned long data);
+
+static unsigned long wq_watchdog_thresh = 1000;
+static struct timer_list wq_watchdog_timer =
+	TIMER_DEFERRED_INITIALIZER(wq_watchdog_timer_fn, 0, 0);
+
+static void wq_watchdog_timer_fn(unsigned long data)
+{
+	unsigned long thresh = msecs_to_jiffies(ACCESS_ONCE(wq_watchdog_thresh));
+	struct worker_pool *pool;
+	struct worker *worker;
+	unsigned long flags;
+	int pi, bkt;
+
+	if (!thresh)
+		return;
+
+	rcu_read_lock_sched();
+	for_each_pool(pool, pi) {
+		spin_lock_irqsave(&pool->lock, flags);
+		hash_for_each(pool->busy_hash, bkt, worker, hentry) {
+			if (worker->hog_reported ||
+			    time_before(jiffies, worker->current_start + thresh))
+				continue;
+
+			worker->hog_reported = true;
+			pr_warn("workqueue: %pf on %s has been running for %u ms in %s/%d\n",
+				worker->current_func,
+				worker->current_pwq->wq->name,
+				jiffies_to_msecs(jiffies - worker->current_start),
+				worker->task->comm, task_pid_nr(worker->task));
+		}
+		spin_unlock_irqrestore(&pool->lock, flags);
+	}
+	rcu_read_unlock_sched();
+
+	mod_timer(&wq_watchdog_timer, jiffies + thresh);
+}
+
+static void wq_watchdog_set_thresh(unsigned long thresh)
+{
+	wq_watchdog_thresh = 0;
+	del_timer_sync(&wq_watchdog_timer);
+
+	if (thresh) {
+		wq_watchdog_thresh = thresh;
+		mod_timer(&wq_watchdog_timer,
+			  jiffies + msecs_to_jiffies(thresh));
+	}
+}
+
+static int wq_watchdog_param_set_thresh(const char *val,
+					const struct kernel_param *kp)
+{
+	unsigned long thresh;
+	int ret;
+
+	ret = kstrtoul(val, 0, &thresh);
+	if (ret)
+		return ret;
+
+	/* timers can't be used before init_workqueues() */
+	if (system_wq)
+		wq_watchdog_set_thresh(thresh);
+	else
+		wq_watchdog_thresh = thresh;
+
+	return 0;
+}
+
+static struct kernel_param_ops wq_watchdog_thresh_ops = {
+	.set	= wq_watchdog_param_set_thresh,
+	.get	= param_get_ulong,
+};
+
+module_param_cb(watchdog_thresh, &wq_watchdog_thresh_ops, &wq_watchdog_thresh,
+		0644);
+
+static void wq_watchdog_init(void)
+{
+	wq_watchdog_set_thresh(wq_watchdog_thresh);
+}
+#else
+static inline void wq_watchdog_init(void) { }
+#endif	/* CONFIG_WQ_WATCHDOG */
+
 static int __init init_workqueues(void)
 {
 	int std_nice[NR_STD_WORKER_POOLS] = { 0, HIGHPRI_NICE_LEVEL };
@@ -5152,6 +5248,8 @@ static int __init init_workqueues(void)
 					      WQ_FREEZABLE, 0);
 	BUG_ON(!system_wq || !system_highpri_wq || !system_long_wq ||
 	       !system_unbound_wq || !system_freezable_wq);
+
+	wq_watchdog_init();
 	return 0;
 }
 early_initcall(init_workqueues);
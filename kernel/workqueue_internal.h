@@ -29,7 +29,9 @@ struct worker {
 	struct work_struct	*current_work;	/* L: work being processed */
 	work_func_t		current_func;	/* L: current_work's fn */
 	struct pool_workqueue	*current_pwq; /* L: current_work's pwq */
+	unsigned long		current_start;	/* L: jiffies current_work started */
 	bool			desc_valid;	/* ->desc is valid */
+	bool			hog_reported;	/* L: watchdog warned about it */
 	struct list_head	scheduled;	/* L: scheduled works */
 
 	/* 64 bytes boundary on 64bit, 32 on 32bit */
@@ -50,6 +52,10 @@ struct worker {
 
 	/* used only by rescuers to point to the target workqueue */
 	struct workqueue_struct	*rescue_wq;	/* I: the workqueue to rescue */
+
+#ifdef CONFIG_WQ_LATENCY_STATS
+	u64			stats_start;	/* local_clock() current_work started */
+#endif
 };
 
 /**
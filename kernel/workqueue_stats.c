@@ -0,0 +1,216 @@
+/*
+ * kernel/workqueue_stats.c - per work function latency histograms
+ *
+ * Hooks the workqueue tracepoints and keeps, for every work function
+ * seen, a log2 histogram of the time from queueing to the start of
+ * execution and one of the execution time.  The former is what other
+ * users of a shared workqueue wait behind it, the latter what it costs
+ * them.  Delayed work is stamped when its timer queues it.
+ *
+ * The histograms are in /sys/kernel/debug/workqueue/latency; writing
+ * anything to the file clears the counts.  Functions that don't fit in
+ * the table are counted as dropped.
+ *
+ * The queueing stamp lives in the work item, so a work item requeued
+ * while its previous instance is being started may have its wait time
+ * underestimated.
+ */
+
+#include <linux/atomic.h>
+#include <linux/debugfs.h>
+#include <linux/hash.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/workqueue.h>
+
+#include "workqueue_internal.h"
+
+/* only passed through by the tracepoint, private to workqueue.c */
+struct pool_workqueue;
+
+#include <trace/events/workqueue.h>
+
+#define WQ_STATS_BITS		8
+#define WQ_STATS_SIZE		(1 << WQ_STATS_BITS)
+
+/* bucket n counts durations of [2^(n-1), 2^n) us, the last one the rest */
+#define WQ_STATS_BUCKETS	20
+
+struct wq_stat {
+	work_func_t		func;
+	atomic64_t		wait_ns;
+	atomic64_t		run_ns;
+	atomic_t		wait[WQ_STATS_BUCKETS];
+	atomic_t		run[WQ_STATS_BUCKETS];
+};
+
+static struct wq_stat wq_stats[WQ_STATS_SIZE];
+static atomic_t wq_stats_dropped;
+
+static struct wq_stat *wq_stat_get(work_func_t func)
+{
+	unsigned int h = hash_ptr((void *)func, WQ_STATS_BITS);
+	unsigned int i;
+
+	for (i = 0; i < WQ_STATS_SIZE; i++) {
+		struct wq_stat *s = &wq_stats[(h + i) & (WQ_STATS_SIZE - 1)];
+		work_func_t cur = ACCESS_ONCE(s->func);
+
+		if (!cur)
+			cur = cmpxchg(&s->func, NULL, func);
+		if (!cur || cur == func)
+			return s;
+	}
+
+	atomic_inc(&wq_stats_dropped);
+	return NULL;
+}
+
+static void wq_stat_add(atomic_t *hist, atomic64_t *total, u64 ns)
+{
+	unsigned int bucket = fls64(div_u64(ns, NSEC_PER_USEC));
+
+	atomic_inc(&hist[min_t(unsigned int, bucket, WQ_STATS_BUCKETS - 1)]);
+	atomic64_add(ns, total);
+}
+
+static void probe_queue_work(void *ignore, unsigned int req_cpu,
+			     struct pool_workqueue *pwq,
+			     struct work_struct *work)
+{
+	work->queue_time = local_clock();
+}
+
+static void probe_execute_start(void *ignore, struct work_struct *work)
+{
+	struct worker *worker = current_wq_worker();
+	u64 now = local_clock();
+	u64 queued = work->queue_time;
+	struct wq_stat *s;
+
+	if (worker)
+		worker->stats_start = now;
+
+	/* queued before the probes were registered */
+	if (!queued || queued > now)
+		return;
+
+	s = wq_stat_get(work->func);
+	if (s)
+		wq_stat_add(s->wait, &s->wait_ns, now - queued);
+}
+
+/* @work may have been freed by now, only the worker can be looked at */
+static void probe_execute_end(void *ignore, struct work_struct *work)
+{
+	struct worker *worker = current_wq_worker();
+	struct wq_stat *s;
+	u64 now;
+
+	if (!worker || !worker->stats_start)
+		return;
+
+	now = local_clock();
+	s = wq_stat_get(worker->current_func);
+	if (s && now > worker->stats_start)
+		wq_stat_add(s->run, &s->run_ns, now - worker->stats_start);
+	worker->stats_start = 0;
+}
+
+static void wq_stats_show_hist(struct seq_file *m, const char *name,
+			       atomic_t *hist, atomic64_t *total)
+{
+	unsigned int count = 0;
+	int i;
+
+	for (i = 0; i < WQ_STATS_BUCKETS; i++)
+		count += atomic_read(&hist[i]);
+
+	seq_printf(m, "  %-4s %10u %10llu", name, count, count ?
+		   (unsigned long long)div_u64(div_u64(atomic64_read(total),
+						       NSEC_PER_USEC), count) :
+		   0ULL);
+	for (i = 0; i < WQ_STATS_BUCKETS; i++)
+		seq_printf(m, " %u", atomic_read(&hist[i]));
+	seq_putc(m, '\n');
+}
+
+static int wq_stats_show(struct seq_file *m, void *v)
+{
+	int i;
+
+	seq_printf(m, "# dropped functions: %u\n",
+		   atomic_read(&wq_stats_dropped));
+	seq_printf(m, "# %-4s %10s %10s  histogram: <1us <2us <4us ... >=%uus\n",
+		   "", "count", "avg_us", 1U << (WQ_STATS_BUCKETS - 2));
+
+	for (i = 0; i < WQ_STATS_SIZE; i++) {
+		struct wq_stat *s = &wq_stats[i];
+
+		if (!ACCESS_ONCE(s->func))
+			continue;
+		seq_printf(m, "%pf\n", s->func);
+		wq_stats_show_hist(m, "wait", s->wait, &s->wait_ns);
+		wq_stats_show_hist(m, "run", s->run, &s->run_ns);
+	}
+	return 0;
+}
+
+static int wq_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wq_stats_show, NULL);
+}
+
+/* function slots are kept, they can't be reused safely under the probes */
+static ssize_t wq_stats_write(struct file *file, const char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	int i, j;
+
+	for (i = 0; i < WQ_STATS_SIZE; i++) {
+		struct wq_stat *s = &wq_stats[i];
+
+		atomic64_set(&s->wait_ns, 0);
+		atomic64_set(&s->run_ns, 0);
+		for (j = 0; j < WQ_STATS_BUCKETS; j++) {
+			atomic_set(&s->wait[j], 0);
+			atomic_set(&s->run[j], 0);
+		}
+	}
+	atomic_set(&wq_stats_dropped, 0);
+	return count;
+}
+
+static const struct file_operations wq_stats_fops = {
+	.open		= wq_stats_open,
+	.read		= seq_read,
+	.write		= wq_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init wq_stats_init(void)
+{
+	struct dentry *dir;
+	int ret;
+
+	dir = debugfs_create_dir("workqueue", NULL);
+	if (!dir || !debugfs_create_file("latency", S_IRUGO | S_IWUSR, dir,
+					 NULL, &wq_stats_fops))
+		return -ENOMEM;
+
+	ret = register_trace_workqueue_queue_work(probe_queue_work, NULL);
+	if (!ret)
+		ret = register_trace_workqueue_execute_start(probe_execute_start,
+							     NULL);
+	if (!ret)
+		ret = register_trace_workqueue_execute_end(probe_execute_end,
+							   NULL);
+	if (ret)
+		pr_err("workqueue: unable to register latency probes: %d\n",
+		       ret);
+	return ret;
+}
+fs_initcall(wq_stats_init);
@@ -0,0 +1,64 @@
+/*
+ * printk caller latency benchmark
+ *
+ * Logs a burst of messages, first from process context and then with
+ * interrupts disabled as an interrupt handler would, and reports the
+ * average and worst time spent inside each printk() call. Run it once with
+ * printk.synchronous=1 and once with 0 to see what moving console output to
+ * the printing thread buys on a given console.
+ */
+
+#include <linux/module.h>
+#include <linux/irqflags.h>
+#include <linux/sched.h>
+
+static unsigned int nr_msgs = 1000;
+module_param(nr_msgs, uint, S_IRUGO);
+
+static void bench(const char *ctx, bool irqs_off)
+{
+	u64 total = 0, max = 0, t;
+	unsigned long flags;
+	unsigned int i;
+
+	for (i = 0; i < nr_msgs; i++) {
+		if (irqs_off)
+			local_irq_save(flags);
+		t = local_clock();
+		printk(KERN_ERR "printk_latency_test: %s message %u\n",
+		       ctx, i);
+		t = local_clock() - t;
+		if (irqs_off)
+			local_irq_restore(flags);
+
+		total += t;
+		if (t > max)
+			max = t;
+		cond_resched();
+	}
+
+	printk(KERN_ALERT "printk_latency_test: %s: %u messages, avg %llu ns max %llu ns\n",
+	       ctx, nr_msgs, (unsigned long long)div_u64(total, nr_msgs),
+	       (unsigned long long)max);
+}
+
+static int __init printk_latency_test_init(void)
+{
+	if (!nr_msgs)
+		return -EINVAL;
+
+	bench("process", false);
+	bench("irqs off", true);
+
+	return -EAGAIN; /* Fail will directly unload the module */
+}
+
+static void __exit printk_latency_test_exit(void)
+{
+}
+
+module_init(printk_latency_test_init)
+module_exit(printk_latency_test_exit)
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("printk caller latency benchmark");
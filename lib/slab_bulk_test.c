@@ -0,0 +1,92 @@
+/*
+ * Slab bulk allocation benchmark
+ *
+ * Compares allocating and freeing objects one at a time with
+ * kmem_cache_alloc()/kmem_cache_free() against doing the same in batches
+ * with kmem_cache_alloc_bulk()/kmem_cache_free_bulk(), for a few object
+ * and batch sizes. Results are printed in cycles per object.
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <asm/timex.h>
+
+#define LOOPS		10000
+#define MAX_BULK	128
+
+static unsigned int sizes[] = { 64, 256, 1024 };
+static unsigned int bulks[] = { 1, 8, 16, 32, 64, 128 };
+
+static void *objs[MAX_BULK];
+
+static cycles_t bench_single(struct kmem_cache *s, unsigned int bulk)
+{
+	cycles_t start;
+	int i, j;
+
+	start = get_cycles();
+	for (i = 0; i < LOOPS; i++) {
+		for (j = 0; j < bulk; j++) {
+			objs[j] = kmem_cache_alloc(s, GFP_KERNEL);
+			if (!objs[j])
+				break;
+		}
+		while (j--)
+			kmem_cache_free(s, objs[j]);
+	}
+	return get_cycles() - start;
+}
+
+static cycles_t bench_bulk(struct kmem_cache *s, unsigned int bulk)
+{
+	cycles_t start;
+	int i;
+
+	start = get_cycles();
+	for (i = 0; i < LOOPS; i++) {
+		if (!kmem_cache_alloc_bulk(s, GFP_KERNEL, bulk, objs))
+			continue;
+		kmem_cache_free_bulk(s, bulk, objs);
+	}
+	return get_cycles() - start;
+}
+
+static int __init slab_bulk_test_init(void)
+{
+	struct kmem_cache *s;
+	cycles_t single, bulk;
+	int i, j;
+
+	printk(KERN_ALERT "slab bulk testing\n");
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		s = kmem_cache_create("slab_bulk_test", sizes[i], 0, 0, NULL);
+		if (!s)
+			return -ENOMEM;
+
+		for (j = 0; j < ARRAY_SIZE(bulks); j++) {
+			single = bench_single(s, bulks[j]);
+			bulk = bench_bulk(s, bulks[j]);
+			printk(KERN_ALERT "size %4u bulk %3u: single %llu bulk %llu cycles per object\n",
+			       sizes[i], bulks[j],
+			       (unsigned long long)div_u64(single,
+							   LOOPS * bulks[j]),
+			       (unsigned long long)div_u64(bulk,
+							   LOOPS * bulks[j]));
+		}
+
+		kmem_cache_destroy(s);
+	}
+
+	return -EAGAIN; /* Fail will directly unload the module */
+}
+
+static void __exit slab_bulk_test_exit(void)
+{
+}
+
+module_init(slab_bulk_test_init)
+module_exit(slab_bulk_test_exit)
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Slab bulk allocation benchmark");
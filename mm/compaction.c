@@ -16,6 +16,8 @@
 #include <linux/sysfs.h>
 #include <linux/balloon_compaction.h>
 #include <linux/page-isolation.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include "internal.h"
 
 #ifdef CONFIG_COMPACTION
@@ -901,7 +903,8 @@ static int compact_finished(struct zone *zone,
  *   COMPACT_PARTIAL  - If the allocation would succeed without compaction
  *   COMPACT_CONTINUE - If compaction should run now
  */
-unsigned long compaction_suitable(struct zone *zone, int order)
+static unsigned long __compaction_suitable(struct zone *zone, int order,
+					   int extfrag_threshold)
 {
 	int fragindex;
 	unsigned long watermark;
@@ -934,7 +937,7 @@ unsigned long compaction_suitable(struct zone *zone, int order)
 	 * Only compact if a failure would be due to fragmentation.
 	 */
 	fragindex = fragmentation_index(zone, order);
-	if (fragindex >= 0 && fragindex <= sysctl_extfrag_threshold)
+	if (fragindex >= 0 && fragindex <= extfrag_threshold)
 		return COMPACT_SKIPPED;
 
 	if (fragindex == -1000 && zone_watermark_ok(zone, order, watermark,
@@ -944,13 +947,21 @@ unsigned long compaction_suitable(struct zone *zone, int order)
 	return COMPACT_CONTINUE;
 }
 
+unsigned long compaction_suitable(struct zone *zone, int order)
+{
+	return __compaction_suitable(zone, order, sysctl_extfrag_threshold);
+}
+
 static int compact_zone(struct zone *zone, struct compact_control *cc)
 {
 	int ret;
 	unsigned long start_pfn = zone->zone_start_pfn;
 	unsigned long end_pfn = zone_end_pfn(zone);
 
-	ret = compaction_suitable(zone, cc->order);
+	/* kcompactd has already checked the index against its own target */
+	ret = __compaction_suitable(zone, cc->order, cc->proactive ?
+			sysctl_compaction_proactive_target :
+			sysctl_extfrag_threshold);
 	switch (ret) {
 	case COMPACT_PARTIAL:
 	case COMPACT_SKIPPED:
@@ -1249,4 +1260,192 @@ void compaction_unregister_node(struct node *node)
 }
 #endif /* CONFIG_SYSFS && CONFIG_NUMA */
 
+/*
+ * Proactive compaction
+ *
+ * Compaction normally only runs once a high-order allocation has already
+ * failed, and drivers that need large physically contiguous buffers then
+ * either stall in direct compaction or fall back to smaller pages. kcompactd
+ * periodically checks the fragmentation index of every zone for the orders
+ * in vm.compaction_proactive_orders and compacts the zones where an
+ * allocation of such an order would fail with an index above
+ * vm.compaction_proactive_target. It runs at the lowest priority, skips
+ * its turn while every cpu has something else to run, and backs off while
+ * its work does not pay off. It is not SCHED_IDLE because migration takes
+ * page and anon_vma locks that a starved holder would sit on.
+ */
+#define KCOMPACTD_INTERVAL_MSECS	500
+#define KCOMPACTD_MAX_BACKOFF		6
+
+int sysctl_compaction_proactive_orders = (1 << 4) | (1 << 8);
+int sysctl_compaction_proactive_target = 500;
+
+static struct task_struct *kcompactd;
+static DECLARE_WAIT_QUEUE_HEAD(kcompactd_wait);
+static bool kcompactd_kick;
+
+static bool kcompactd_zone_needs_work(struct zone *zone, int order)
+{
+	int fragindex = fragmentation_index(zone, order);
+
+	/* -1000 means the allocation would succeed already */
+	return fragindex > sysctl_compaction_proactive_target;
+}
+
+/*
+ * Compacts @zone for @order and returns true if the fragmentation index
+ * is within the target afterwards.
+ */
+static bool kcompactd_compact_zone(struct zone *zone, int order)
+{
+	struct compact_control cc = {
+		.order = order,
+		.migratetype = MIGRATE_MOVABLE,
+		.zone = zone,
+		.sync = false,
+		.proactive = true,
+	};
+
+	INIT_LIST_HEAD(&cc.freepages);
+	INIT_LIST_HEAD(&cc.migratepages);
+
+	count_compact_event(COMPACTPROACTIVE);
+	compact_zone(zone, &cc);
+
+	VM_BUG_ON(!list_empty(&cc.freepages));
+	VM_BUG_ON(!list_empty(&cc.migratepages));
+
+	if (kcompactd_zone_needs_work(zone, order))
+		return false;
+
+	count_compact_event(COMPACTPROACTIVESUCCESS);
+	return true;
+}
+
+/*
+ * One pass over all zones. Returns false if compaction was attempted
+ * and did not reach the target anywhere, i.e. it is not worth trying
+ * again as soon.
+ */
+static bool kcompactd_do_work(void)
+{
+	int orders = ACCESS_ONCE(sysctl_compaction_proactive_orders);
+	bool tried = false, progress = false;
+	struct zone *zone;
+	int order;
+
+	for_each_populated_zone(zone) {
+		for (order = MAX_ORDER - 1; order > 0; order--) {
+			if (!(orders & (1 << order)))
+				continue;
+			if (kthread_should_stop() || freezing(current))
+				return true;
+			if (!kcompactd_zone_needs_work(zone, order))
+				continue;
+
+			if (!tried)
+				count_compact_event(KCOMPACTD_WAKE);
+			tried = true;
+			if (kcompactd_compact_zone(zone, order))
+				progress = true;
+		}
+	}
+
+	return !tried || progress;
+}
+
+static void kcompactd_timeout(unsigned long data)
+{
+	wake_up_process((struct task_struct *)data);
+}
+
+/* like schedule_timeout_interruptible() but without waking an idle cpu */
+static void kcompactd_sleep(unsigned long timeout)
+{
+	struct timer_list timer;
+	DEFINE_WAIT(wait);
+
+	prepare_to_wait(&kcompactd_wait, &wait, TASK_INTERRUPTIBLE);
+	if (!ACCESS_ONCE(kcompactd_kick) && !kthread_should_stop()) {
+		setup_deferrable_timer_on_stack(&timer, kcompactd_timeout,
+						(unsigned long)current);
+		mod_timer(&timer, jiffies + timeout);
+		freezable_schedule();
+		del_singleshot_timer_sync(&timer);
+		destroy_timer_on_stack(&timer);
+	}
+	finish_wait(&kcompactd_wait, &wait);
+	kcompactd_kick = false;
+}
+
+static int kcompactd_thread(void *unused)
+{
+	unsigned int backoff = 0;
+
+	set_user_nice(current, 19);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		unsigned long timeout;
+
+		if (!ACCESS_ONCE(sysctl_compaction_proactive_orders)) {
+			wait_event_freezable(kcompactd_wait,
+				ACCESS_ONCE(sysctl_compaction_proactive_orders) ||
+				kthread_should_stop());
+			backoff = 0;
+			continue;
+		}
+
+		/* leave the cpus to others while they are all busy */
+		if (nr_running() <= num_online_cpus()) {
+			if (kcompactd_do_work())
+				backoff = 0;
+			else if (backoff < KCOMPACTD_MAX_BACKOFF)
+				backoff++;
+		}
+
+		timeout = msecs_to_jiffies(KCOMPACTD_INTERVAL_MSECS) << backoff;
+		kcompactd_sleep(timeout);
+	}
+
+	return 0;
+}
+
+int sysctl_compaction_proactive_handler(struct ctl_table *table, int write,
+			void __user *buffer, size_t *length, loff_t *ppos)
+{
+	struct ctl_table t = *table;
+	int val = *(int *)table->data;
+	int ret;
+
+	t.data = &val;
+	ret = proc_dointvec_minmax(&t, write, buffer, length, ppos);
+	if (ret || !write)
+		return ret;
+
+	/* order 0 allocations never fail for fragmentation */
+	if (table->data == &sysctl_compaction_proactive_orders && (val & 1))
+		return -EINVAL;
+	*(int *)table->data = val;
+
+	/* re-evaluate with the new settings right away */
+	kcompactd_kick = true;
+	wake_up_interruptible(&kcompactd_wait);
+	return 0;
+}
+
+static int __init kcompactd_init(void)
+{
+	struct task_struct *tsk;
+
+	tsk = kthread_run(kcompactd_thread, NULL, "kcompactd");
+	if (IS_ERR(tsk)) {
+		pr_err("Failed to start kcompactd\n");
+		return PTR_ERR(tsk);
+	}
+	kcompactd = tsk;
+	return 0;
+}
+module_init(kcompactd_init)
+
 #endif /* CONFIG_COMPACTION */
@@ -218,7 +218,9 @@ get_write_lock:
 		}
 		mutex_lock(&mapping->i_mmap_mutex);
 		flush_dcache_mmap_lock(mapping);
+		vm_write_begin(vma);
 		vma->vm_flags |= VM_NONLINEAR;
+		vm_write_end(vma);
 		vma_interval_tree_remove(vma, &mapping->i_mmap);
 		vma_nonlinear_insert(vma, &mapping->i_mmap_nonlinear);
 		flush_dcache_mmap_unlock(mapping);
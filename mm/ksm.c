@@ -37,6 +37,7 @@
 #include <linux/freezer.h>
 #include <linux/oom.h>
 #include <linux/numa.h>
+#include <linux/ktime.h>
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -226,6 +227,28 @@ static unsigned int ksm_thread_sleep_millisecs = 1500;
 /* Boolean to indicate whether to use deferred timer or not */
 static bool use_deferred_timer;
 
+/* Whether to merge zero-filled pages with the kernel's zero page */
+static bool ksm_use_zero_pages __read_mostly;
+
+/* Checksum of an empty (zeroed) page */
+static unsigned int zero_checksum __read_mostly;
+
+/* The number of pages merged with the zero page so far */
+static unsigned long ksm_zero_pages_merged;
+
+/* The number of pages merged so far, zero pages included */
+static unsigned long ksm_pages_merged;
+
+/* Whether ksmd adjusts pages_to_scan itself, see ksm_auto_tune() */
+static bool ksm_auto_tune_enabled;
+
+/* Percentage of one cpu ksmd may use when auto-tuning */
+static unsigned int ksm_auto_tune_max_cpu = 10;
+
+/* Bounds for pages_to_scan when auto-tuning */
+static unsigned int ksm_auto_tune_min_pages = 64;
+static unsigned int ksm_auto_tune_max_pages = 4096;
+
 #ifdef CONFIG_NUMA
 /* Zeroed when merging across nodes is not allowed */
 static unsigned int ksm_merge_across_nodes = 1;
@@ -296,6 +319,7 @@ static inline struct rmap_item *alloc_rmap_item(void)
 static inline void free_rmap_item(struct rmap_item *rmap_item)
 {
 	ksm_rmap_items--;
+	rmap_item->mm->ksm_rmap_items--;
 	rmap_item->mm = NULL;	/* debug safety */
 	kmem_cache_free(rmap_item_cache, rmap_item);
 }
@@ -505,6 +529,7 @@ static void remove_node_from_stable_tree(struct stable_node *stable_node)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+		rmap_item->mm->ksm_merging_pages--;
 		put_anon_vma(rmap_item->anon_vma);
 		rmap_item->address &= PAGE_MASK;
 		cond_resched();
@@ -633,6 +658,7 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+		rmap_item->mm->ksm_merging_pages--;
 
 		put_anon_vma(rmap_item->anon_vma);
 		rmap_item->address &= PAGE_MASK;
@@ -925,7 +951,7 @@ out:
  * replace_page - replace page in vma by new ksm page
  * @vma:      vma that holds the pte pointing to page
  * @page:     the page we are replacing by kpage
- * @kpage:    the ksm page we replace page by
+ * @kpage:    the ksm page we replace page by, or the zero page
  * @orig_pte: the original value of the pte
  *
  * Returns 0 on success, -EFAULT on failure.
@@ -936,6 +962,7 @@ static int replace_page(struct vm_area_struct *vma, struct page *page,
 	struct mm_struct *mm = vma->vm_mm;
 	pmd_t *pmd;
 	pte_t *ptep;
+	pte_t newpte;
 	spinlock_t *ptl;
 	unsigned long addr;
 	int err = -EFAULT;
@@ -961,12 +988,23 @@ static int replace_page(struct vm_area_struct *vma, struct page *page,
 		goto out_mn;
 	}
 
-	get_page(kpage);
-	page_add_anon_rmap(kpage, vma, addr);
+	if (!is_zero_pfn(page_to_pfn(kpage))) {
+		get_page(kpage);
+		page_add_anon_rmap(kpage, vma, addr);
+		newpte = mk_pte(kpage, vma->vm_page_prot);
+	} else {
+		/*
+		 * The zero page is not refcounted nor on any rmap, and it
+		 * no longer counts as the process's anonymous memory.
+		 */
+		newpte = pte_mkspecial(pfn_pte(page_to_pfn(kpage),
+					       vma->vm_page_prot));
+		dec_mm_counter(mm, MM_ANONPAGES);
+	}
 
 	flush_cache_page(vma, addr, pte_pfn(*ptep));
 	ptep_clear_flush(vma, addr, ptep);
-	set_pte_at_notify(mm, addr, ptep, mk_pte(kpage, vma->vm_page_prot));
+	set_pte_at_notify(mm, addr, ptep, newpte);
 
 	page_remove_rmap(page);
 	if (!page_mapped(page))
@@ -1013,7 +1051,8 @@ static int page_trans_compound_anon_split(struct page *page)
  * @vma: the vma that holds the pte pointing to page
  * @page: the PageAnon page that we want to replace with kpage
  * @kpage: the PageKsm page that we want to map instead of page,
- *         or NULL the first time when we want to use page as kpage.
+ *         the zero page, or NULL the first time when we want to use
+ *         page as kpage.
  *
  * This function returns 0 if the pages were merged, -EFAULT otherwise.
  */
@@ -1065,7 +1104,7 @@ static int try_to_merge_one_page(struct vm_area_struct *vma,
 
 	if ((vma->vm_flags & VM_LOCKED) && kpage && !err) {
 		munlock_vma_page(page);
-		if (!PageMlocked(kpage)) {
+		if (!PageMlocked(kpage) && !is_zero_pfn(page_to_pfn(kpage))) {
 			unlock_page(page);
 			lock_page(kpage);
 			mlock_vma_page(kpage);
@@ -1406,6 +1445,41 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 		ksm_pages_sharing++;
 	else
 		ksm_pages_shared++;
+	rmap_item->mm->ksm_merging_pages++;
+	ksm_pages_merged++;
+}
+
+/*
+ * try_to_merge_zero_page - map the zero page in place of an empty page
+ * @rmap_item: the reverse mapping of @page
+ * @page: a page whose checksum matched that of the zero page
+ *
+ * Zero-filled pages are common (freshly allocated heaps that were only
+ * ever cleared) and need neither the stable nor the unstable tree: they
+ * all have the same content as the kernel's zero page already.
+ *
+ * This function returns 0 if the page was merged, -EFAULT otherwise.
+ */
+static int try_to_merge_zero_page(struct rmap_item *rmap_item,
+				  struct page *page)
+{
+	struct mm_struct *mm = rmap_item->mm;
+	struct vm_area_struct *vma;
+	int err = -EFAULT;
+
+	down_read(&mm->mmap_sem);
+	vma = find_mergeable_vma(mm, rmap_item->address);
+	if (vma)
+		err = try_to_merge_one_page(vma, page,
+					    ZERO_PAGE(rmap_item->address));
+	up_read(&mm->mmap_sem);
+
+	if (!err) {
+		mm->ksm_zero_pages_merged++;
+		ksm_zero_pages_merged++;
+		ksm_pages_merged++;
+	}
+	return err;
 }
 
 /*
@@ -1476,6 +1550,14 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 		return;
 	}
 
+	/*
+	 * Same checksum as an empty page: try the zero page first.  If the
+	 * merge fails the page was not really empty, so carry on as usual.
+	 */
+	if (ksm_use_zero_pages && checksum == zero_checksum &&
+	    !try_to_merge_zero_page(rmap_item, page))
+		return;
+
 	tree_rmap_item =
 		unstable_tree_search_insert(rmap_item, page, &tree_page);
 	if (tree_rmap_item) {
@@ -1530,6 +1612,7 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	if (rmap_item) {
 		/* It has already been zeroed */
 		rmap_item->mm = mm_slot->mm;
+		rmap_item->mm->ksm_rmap_items++;
 		rmap_item->address = addr;
 		rmap_item->rmap_list = *rmap_list;
 		*rmap_list = rmap_item;
@@ -1694,20 +1777,109 @@ next_mm:
 /**
  * ksm_do_scan  - the ksm scanner main worker function.
  * @scan_npages - number of pages we want to scan before we return.
+ *
+ * Returns the number of pages actually scanned.
  */
-static void ksm_do_scan(unsigned int scan_npages)
+static unsigned int ksm_do_scan(unsigned int scan_npages)
 {
 	struct rmap_item *rmap_item;
 	struct page *uninitialized_var(page);
+	unsigned int scanned = 0;
 
-	while (scan_npages-- && likely(!freezing(current))) {
+	while (scanned < scan_npages && likely(!freezing(current))) {
 		cond_resched();
 		rmap_item = scan_get_next_rmap_item(&page);
 		if (!rmap_item)
-			return;
+			break;
 		cmp_and_merge_page(page, rmap_item);
 		put_page(page);
+		scanned++;
+	}
+	return scanned;
+}
+
+/*
+ * A full scan that merged more than one page in KSM_YIELD_HIGH doubles
+ * pages_to_scan, one that merged less than one in KSM_YIELD_LOW halves it.
+ */
+#define KSM_YIELD_HIGH	64
+#define KSM_YIELD_LOW	1024
+
+static struct ksm_tune {
+	unsigned long seqnr;		/* full scan being accounted */
+	unsigned long scanned;		/* pages scanned in it so far */
+	unsigned long merged;		/* pages merged in it so far */
+	u64 ns_per_page;		/* average cost of scanning a page */
+} ksm_tune;
+
+/*
+ * ksm_auto_tune - adjust pages_to_scan after a batch
+ * @scanned: pages scanned by the batch
+ * @merged: pages merged by the batch
+ * @ns: time the batch took
+ *
+ * Scanning pays off only while it finds something to merge, so the scan
+ * rate follows the yield of the last full scan: busy while new mergeable
+ * pages keep showing up, down to auto_tune_min_pages once everything has
+ * settled.  Whatever the yield, a batch is never allowed to cost more
+ * than auto_tune_max_cpu percent of one cpu at the current sleep_millisecs.
+ */
+static void ksm_auto_tune(unsigned int scanned, unsigned long merged, u64 ns)
+{
+	unsigned int max_cpu = ksm_auto_tune_max_cpu;
+	unsigned long pages = ksm_thread_pages_to_scan;
+	u64 budget;
+
+	if (scanned) {
+		u64 cost = div_u64(ns, scanned);
+
+		if (ksm_tune.ns_per_page)
+			cost = (3 * ksm_tune.ns_per_page + cost) >> 2;
+		ksm_tune.ns_per_page = cost;
+	}
+	ksm_tune.scanned += scanned;
+	ksm_tune.merged += merged;
+
+	if (ksm_tune.seqnr != ksm_scan.seqnr) {
+		if (ksm_tune.merged * KSM_YIELD_HIGH > ksm_tune.scanned)
+			pages *= 2;
+		else if (ksm_tune.merged * KSM_YIELD_LOW < ksm_tune.scanned)
+			pages /= 2;
+		ksm_tune.seqnr = ksm_scan.seqnr;
+		ksm_tune.scanned = 0;
+		ksm_tune.merged = 0;
+	}
+
+	if (ksm_tune.ns_per_page) {
+		/* scan time allowed per sleep: sleep * cpu / (100 - cpu) */
+		budget = (u64)ksm_thread_sleep_millisecs * NSEC_PER_MSEC *
+			 max_cpu;
+		budget = div_u64(budget, 100 - max_cpu);
+		budget = div64_u64(budget, ksm_tune.ns_per_page);
+		if (pages > budget)
+			pages = budget;
+	}
+
+	pages = clamp_t(unsigned long, pages, ksm_auto_tune_min_pages,
+			ksm_auto_tune_max_pages);
+	ksm_thread_pages_to_scan = pages;
+}
+
+static void ksm_do_scan_batch(void)
+{
+	unsigned long merged = ksm_pages_merged;
+	unsigned int scanned;
+	ktime_t start;
+
+	if (!ksm_auto_tune_enabled) {
+		ksm_do_scan(ksm_thread_pages_to_scan);
+		return;
 	}
+
+	start = ktime_get();
+	scanned = ksm_do_scan(ksm_thread_pages_to_scan);
+	ksm_auto_tune(scanned, ksm_pages_merged - merged,
+		      ktime_to_ns(ktime_sub(ktime_get(), start)));
 }
 
 static void process_timeout(unsigned long __data)
@@ -1759,7 +1931,7 @@ static int ksm_scan_thread(void *nothing)
 		mutex_lock(&ksm_thread_mutex);
 		wait_while_offlining();
 		if (ksmd_should_run())
-			ksm_do_scan(ksm_thread_pages_to_scan);
+			ksm_do_scan_batch();
 		mutex_unlock(&ksm_thread_mutex);
 
 		try_to_freeze();
@@ -2338,6 +2510,129 @@ static ssize_t deferred_timer_store(struct kobject *kobj,
 }
 KSM_ATTR(deferred_timer);
 
+static ssize_t use_zero_pages_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_use_zero_pages);
+}
+
+static ssize_t use_zero_pages_store(struct kobject *kobj,
+				    struct kobj_attribute *attr,
+				    const char *buf, size_t count)
+{
+	bool value;
+
+	if (strtobool(buf, &value))
+		return -EINVAL;
+
+	ksm_use_zero_pages = value;
+
+	return count;
+}
+KSM_ATTR(use_zero_pages);
+
+static ssize_t zero_pages_merged_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_zero_pages_merged);
+}
+KSM_ATTR_RO(zero_pages_merged);
+
+static ssize_t auto_tune_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_auto_tune_enabled);
+}
+
+static ssize_t auto_tune_store(struct kobject *kobj,
+			       struct kobj_attribute *attr,
+			       const char *buf, size_t count)
+{
+	bool value;
+
+	if (strtobool(buf, &value))
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	if (value && !ksm_auto_tune_enabled)
+		memset(&ksm_tune, 0, sizeof(ksm_tune));
+	ksm_tune.seqnr = ksm_scan.seqnr;
+	ksm_auto_tune_enabled = value;
+	mutex_unlock(&ksm_thread_mutex);
+
+	return count;
+}
+KSM_ATTR(auto_tune);
+
+static ssize_t auto_tune_max_cpu_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_auto_tune_max_cpu);
+}
+
+static ssize_t auto_tune_max_cpu_store(struct kobject *kobj,
+				       struct kobj_attribute *attr,
+				       const char *buf, size_t count)
+{
+	unsigned long percent;
+	int err;
+
+	err = kstrtoul(buf, 10, &percent);
+	if (err || percent < 1 || percent > 99)
+		return -EINVAL;
+
+	ksm_auto_tune_max_cpu = percent;
+
+	return count;
+}
+KSM_ATTR(auto_tune_max_cpu);
+
+static ssize_t auto_tune_min_pages_show(struct kobject *kobj,
+					struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_auto_tune_min_pages);
+}
+
+static ssize_t auto_tune_min_pages_store(struct kobject *kobj,
+					 struct kobj_attribute *attr,
+					 const char *buf, size_t count)
+{
+	unsigned long nr_pages;
+	int err;
+
+	err = kstrtoul(buf, 10, &nr_pages);
+	if (err || nr_pages < 1 || nr_pages > ksm_auto_tune_max_pages)
+		return -EINVAL;
+
+	ksm_auto_tune_min_pages = nr_pages;
+
+	return count;
+}
+KSM_ATTR(auto_tune_min_pages);
+
+static ssize_t auto_tune_max_pages_show(struct kobject *kobj,
+					struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_auto_tune_max_pages);
+}
+
+static ssize_t auto_tune_max_pages_store(struct kobject *kobj,
+					 struct kobj_attribute *attr,
+					 const char *buf, size_t count)
+{
+	unsigned long nr_pages;
+	int err;
+
+	err = kstrtoul(buf, 10, &nr_pages);
+	if (err || nr_pages < ksm_auto_tune_min_pages || nr_pages > UINT_MAX)
+		return -EINVAL;
+
+	ksm_auto_tune_max_pages = nr_pages;
+
+	return count;
+}
+KSM_ATTR(auto_tune_max_pages);
+
 #ifdef CONFIG_NUMA
 static ssize_t merge_across_nodes_show(struct kobject *kobj,
 				struct kobj_attribute *attr, char *buf)
@@ -2451,6 +2746,12 @@ static struct attribute *ksm_attrs[] = {
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
 	&deferred_timer_attr.attr,
+	&use_zero_pages_attr.attr,
+	&zero_pages_merged_attr.attr,
+	&auto_tune_attr.attr,
+	&auto_tune_max_cpu_attr.attr,
+	&auto_tune_min_pages_attr.attr,
+	&auto_tune_max_pages_attr.attr,
 #ifdef CONFIG_NUMA
 	&merge_across_nodes_attr.attr,
 #endif
@@ -2468,6 +2769,9 @@ static int __init ksm_init(void)
 	struct task_struct *ksm_thread;
 	int err;
 
+	/* The correct value depends on page size and endianness */
+	zero_checksum = calc_checksum(ZERO_PAGE(0));
+
 	err = ksm_slab_init();
 	if (err)
 		goto out;
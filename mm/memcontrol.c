@@ -43,6 +43,7 @@
 #include <linux/slab.h>
 #include <linux/swap.h>
 #include <linux/swapops.h>
+#include <linux/shmem_fs.h>
 #include <linux/spinlock.h>
 #include <linux/eventfd.h>
 #include <linux/sort.h>
@@ -4830,26 +4831,18 @@ unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 /**
  * mem_cgroup_force_empty_list - clears LRU of a group
  * @memcg: group to clear
- * @node: NUMA node
- * @zid: zone id
- * @lru: lru to to clear
+ * @zone: zone of the list
+ * @list: lru list to clear
  *
  * Traverse a specified page_cgroup list and try to drop them all.  This doesn't
  * reclaim the pages page themselves - pages are moved to the parent (or root)
  * group.
  */
 static void mem_cgroup_force_empty_list(struct mem_cgroup *memcg,
-				int node, int zid, enum lru_list lru)
+				struct zone *zone, struct list_head *list)
 {
-	struct lruvec *lruvec;
 	unsigned long flags;
-	struct list_head *list;
 	struct page *busy;
-	struct zone *zone;
-
-	zone = &NODE_DATA(node)->node_zones[zid];
-	lruvec = mem_cgroup_zone_lruvec(zone, memcg);
-	list = &lruvec->lists[lru];
 
 	busy = NULL;
 	do {
@@ -4881,6 +4874,23 @@ static void mem_cgroup_force_empty_list(struct mem_cgroup *memcg,
 	} while (!list_empty(list));
 }
 
+static void mem_cgroup_force_empty_lruvec(struct mem_cgroup *memcg,
+					  struct zone *zone)
+{
+	struct lruvec *lruvec = mem_cgroup_zone_lruvec(zone, memcg);
+	enum lru_list lru;
+#ifdef CONFIG_LRU_GEN
+	int gen, type;
+
+	for (gen = 0; gen < MAX_NR_GENS; gen++)
+		for (type = 0; type < 2; type++)
+			mem_cgroup_force_empty_list(memcg, zone,
+					&lruvec->lrugen.lists[gen][type]);
+#endif
+	for_each_lru(lru)
+		mem_cgroup_force_empty_list(memcg, zone, &lruvec->lists[lru]);
+}
+
 /*
  * make mem_cgroup's charge to be 0 if there is no task by moving
  * all the charges and pages to the parent.
@@ -4900,11 +4910,8 @@ static void mem_cgroup_reparent_charges(struct mem_cgroup *memcg)
 		mem_cgroup_start_move(memcg);
 		for_each_node_state(node, N_MEMORY) {
 			for (zid = 0; zid < MAX_NR_ZONES; zid++) {
-				enum lru_list lru;
-				for_each_lru(lru) {
-					mem_cgroup_force_empty_list(memcg,
-							node, zid, lru);
-				}
+				mem_cgroup_force_empty_lruvec(memcg,
+					&NODE_DATA(node)->node_zones[zid]);
 			}
 		}
 		mem_cgroup_end_move(memcg);
@@ -6537,16 +6544,21 @@ static struct page *mc_handle_file_pte(struct vm_area_struct *vma,
 		pgoff = pte_to_pgoff(ptent);
 
 	/* page is moved even if it's not RSS of this task(page-faulted). */
-	page = find_get_page(mapping, pgoff);
-
 #ifdef CONFIG_SWAP
 	/* shmem/tmpfs may report page out on swap: account for that too. */
-	if (radix_tree_exceptional_entry(page)) {
-		swp_entry_t swap = radix_to_swp_entry(page);
-		if (do_swap_account)
-			*entry = swap;
-		page = find_get_page(swap_address_space(swap), swap.val);
-	}
+	if (shmem_mapping(mapping)) {
+		page = find_get_entry(mapping, pgoff);
+		if (radix_tree_exceptional_entry(page)) {
+			swp_entry_t swap = radix_to_swp_entry(page);
+			if (do_swap_account)
+				*entry = swap;
+			page = find_get_page(swap_address_space(swap),
+					     swap.val);
+		}
+	} else
+		page = find_get_page(mapping, pgoff);
+#else
+	page = find_get_page(mapping, pgoff);
 #endif
 	return page;
 }
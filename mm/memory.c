@@ -3156,10 +3156,14 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		goto out;
 	}
 	delayacct_set_flag(DELAYACCT_PF_SWAPIN);
-	page = lookup_swap_cache(entry);
+	page = lookup_swap_cache(entry, vma, address);
 	if (!page) {
-		page = swapin_readahead(entry,
-					GFP_HIGHUSER_MOVABLE, vma, address);
+		if (swap_use_vma_readahead())
+			page = swap_vma_readahead(entry, GFP_HIGHUSER_MOVABLE,
+						  vma, address, pmd);
+		else
+			page = swapin_readahead(entry, GFP_HIGHUSER_MOVABLE,
+						vma, address);
 		if (!page) {
 			/*
 			 * Back out if somebody else faulted in this pte
@@ -3981,6 +3985,320 @@ int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	return ret;
 }
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+/*
+ * Speculative page faults
+ *
+ * A fault normally holds mmap_sem for reading from the vma lookup to the
+ * pte update, so a thread faulting in its heap waits behind any other
+ * thread of the process doing mmap, munmap or mprotect.  The common
+ * faults - first touch of private anonymous memory, read of a page cache
+ * page, young/dirty updates of a present pte - can instead be handled
+ * without mmap_sem:
+ *
+ *  - get_vma() finds the vma under mm->mm_rb_lock and pins it, so that
+ *    the vma and its file stay around even if it is unmapped meanwhile;
+ *
+ *  - the vma fields are sampled under its vm_sequence, which writers
+ *    bump around any change of them (vm_write_begin/end) and leave odd
+ *    when the vma is unlinked;
+ *
+ *  - the page tables are walked with interrupts off: the architecture
+ *    frees page tables only after an RCU-sched grace period, and pmds
+ *    that are not yet populated are left to the regular path;
+ *
+ *  - vm_sequence is checked again under the pte lock before the pte is
+ *    installed.  Any later change of the vma either does not affect the
+ *    ptes or goes through them under the same lock (mprotect, munmap),
+ *    and so sees and handles the new pte.
+ *
+ * If anything does not fit, VM_FAULT_RETRY tells the caller to take
+ * mmap_sem and go the usual way.
+ */
+
+/*
+ * Walks down to the pte for @address and locks it, provided @vma has not
+ * changed since @seq was sampled.  Returns NULL if the pte table is not
+ * there, its lock is contended or the vma changed.
+ */
+static pte_t *spf_pte_map_lock(struct mm_struct *mm,
+			       struct vm_area_struct *vma,
+			       unsigned long address, unsigned int seq,
+			       spinlock_t **ptlp)
+{
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd, pmdval;
+	pte_t *pte;
+	spinlock_t *ptl;
+
+	/* keeps the page tables from being freed until we hold the lock */
+	local_irq_disable();
+	pgd = pgd_offset(mm, address);
+	if (pgd_none(*pgd) || unlikely(pgd_bad(*pgd)))
+		goto out;
+	pud = pud_offset(pgd, address);
+	if (pud_none(*pud) || unlikely(pud_bad(*pud)))
+		goto out;
+	pmd = pmd_offset(pud, address);
+	pmdval = *pmd;
+	barrier();
+	if (pmd_none(pmdval) || pmd_trans_huge(pmdval) ||
+	    unlikely(pmd_bad(pmdval)))
+		goto out;
+
+	/*
+	 * Don't spin with interrupts off: the lock holder may be waiting
+	 * for us to answer a TLB shootdown.
+	 */
+	ptl = pte_lockptr(mm, &pmdval);
+	pte = pte_offset_map(&pmdval, address);
+	if (!spin_trylock(ptl)) {
+		pte_unmap(pte);
+		goto out;
+	}
+	/*
+	 * Unlinking the vma precedes zapping its ptes under this lock and
+	 * freeing the page tables, so once the vma is found unchanged here
+	 * the table stays until we unlock.
+	 */
+	if (read_seqcount_retry(&vma->vm_sequence, seq)) {
+		pte_unmap_unlock(pte, ptl);
+		goto out;
+	}
+	local_irq_enable();
+
+	*ptlp = ptl;
+	return pte;
+out:
+	local_irq_enable();
+	return NULL;
+}
+
+static int spf_anonymous_page(struct mm_struct *mm,
+			      struct vm_area_struct *vma,
+			      struct vm_area_struct *snap,
+			      unsigned long address, unsigned int flags,
+			      unsigned int seq)
+{
+	struct page *page = NULL;
+	spinlock_t *ptl;
+	pte_t *pte, entry;
+	int ret = VM_FAULT_RETRY;
+
+	if (!(flags & FAULT_FLAG_WRITE)) {
+		entry = pte_mkspecial(pfn_pte(my_zero_pfn(address),
+						snap->vm_page_prot));
+	} else {
+		page = alloc_zeroed_user_highpage_movable(snap, address);
+		if (!page)
+			return VM_FAULT_RETRY;
+		__SetPageUptodate(page);
+		/* let the regular path deal with the memcg OOM */
+		if (mem_cgroup_newpage_charge(page, mm, GFP_KERNEL)) {
+			page_cache_release(page);
+			return VM_FAULT_RETRY;
+		}
+		entry = mk_pte(page, snap->vm_page_prot);
+		if (snap->vm_flags & VM_WRITE)
+			entry = pte_mkwrite(pte_mkdirty(entry));
+	}
+
+	pte = spf_pte_map_lock(mm, vma, address, seq, &ptl);
+	if (!pte)
+		goto release;
+	ret = 0;
+	if (!pte_none(*pte))
+		goto unlock;
+
+	if (page) {
+		inc_mm_counter_fast(mm, MM_ANONPAGES);
+		/* the snapshot is what was validated, vma may move on */
+		page_add_new_anon_rmap(page, snap, address);
+		page = NULL;
+	}
+	set_pte_at(mm, address, pte, entry);
+	update_mmu_cache(vma, address, pte);
+unlock:
+	pte_unmap_unlock(pte, ptl);
+release:
+	if (page) {
+		mem_cgroup_uncharge_page(page);
+		page_cache_release(page);
+	}
+	return ret;
+}
+
+static int spf_file_read_page(struct mm_struct *mm,
+			      struct vm_area_struct *vma,
+			      struct vm_area_struct *snap,
+			      unsigned long address, unsigned int flags,
+			      unsigned int seq)
+{
+	struct vm_fault vmf;
+	struct page *page;
+	spinlock_t *ptl;
+	pte_t *pte;
+	int ret;
+
+	vmf.virtual_address = (void __user *)address;
+	vmf.pgoff = ((address - snap->vm_start) >> PAGE_SHIFT) +
+		    snap->vm_pgoff;
+	vmf.flags = flags;
+	vmf.page = NULL;
+
+	/* the pinned vma keeps vm_file alive, whatever happens to it */
+	ret = vma->vm_ops->fault(vma, &vmf);
+	if (unlikely(ret & (VM_FAULT_ERROR | VM_FAULT_NOPAGE |
+			    VM_FAULT_RETRY)))
+		return VM_FAULT_RETRY;
+	page = vmf.page;
+	if (unlikely(!(ret & VM_FAULT_LOCKED)))
+		lock_page(page);
+	if (unlikely(PageHWPoison(page))) {
+		ret = VM_FAULT_RETRY;
+		goto release;
+	}
+
+	pte = spf_pte_map_lock(mm, vma, address, seq, &ptl);
+	if (!pte) {
+		ret = VM_FAULT_RETRY;
+		goto release;
+	}
+	ret &= VM_FAULT_MAJOR;
+	if (likely(pte_none(*pte))) {
+		flush_icache_page(snap, page);
+		inc_mm_counter_fast(mm, MM_FILEPAGES);
+		page_add_file_rmap(page);
+		set_pte_at(mm, address, pte, mk_pte(page, snap->vm_page_prot));
+		update_mmu_cache(vma, address, pte);
+		pte_unmap_unlock(pte, ptl);
+		/* the mapping keeps the reference taken by ->fault */
+		unlock_page(page);
+		return ret;
+	}
+	pte_unmap_unlock(pte, ptl);
+release:
+	unlock_page(page);
+	page_cache_release(page);
+	return ret;
+}
+
+static bool vma_can_speculate(struct vm_area_struct *vma, unsigned int flags,
+			      unsigned long vm_access)
+{
+	/* bad accesses get their signal from the regular path */
+	if (!(vma->vm_flags & vm_access))
+		return false;
+	/*
+	 * Stacks grow under the read lock, mlocked pages need the
+	 * unevictable list and the rest needs more than a page.
+	 */
+	if (vma->vm_flags & (VM_GROWSDOWN | VM_GROWSUP | VM_LOCKED |
+			     VM_HUGETLB | VM_PFNMAP | VM_MIXEDMAP | VM_IO |
+			     VM_NONLINEAR))
+		return false;
+	return true;
+}
+
+/**
+ * handle_speculative_fault - try to handle a page fault without mmap_sem
+ * @mm: the faulting mm, current->mm
+ * @address: the faulting address
+ * @flags: FAULT_FLAG_xxx flags
+ * @vm_access: VM_READ/VM_WRITE/VM_EXEC, any of which permits the access
+ *
+ * Returns VM_FAULT_RETRY if the fault was not handled, in which case the
+ * caller takes mmap_sem and calls handle_mm_fault() as usual.  Otherwise
+ * the fault has been handled and the result is 0 or VM_FAULT_MAJOR.
+ */
+int handle_speculative_fault(struct mm_struct *mm, unsigned long address,
+			     unsigned int flags, unsigned long vm_access)
+{
+	struct vm_area_struct *vma, snap;
+	spinlock_t *ptl;
+	pte_t *pte, entry;
+	unsigned int seq;
+	int ret = VM_FAULT_RETRY;
+
+	address &= PAGE_MASK;
+	/* nothing to drop and retry with */
+	flags &= ~(FAULT_FLAG_ALLOW_RETRY | FAULT_FLAG_KILLABLE);
+
+	vma = get_vma(mm, address);
+	if (!vma)
+		goto out;
+
+	/*
+	 * Everything used below comes from this copy; it is known to be
+	 * consistent once vm_sequence is found unchanged under the pte
+	 * lock.  An odd count means a writer is changing the vma right now.
+	 */
+	seq = ACCESS_ONCE(vma->vm_sequence.sequence);
+	smp_rmb();
+	if (seq & 1)
+		goto out_put;
+	snap = *vma;
+	/*
+	 * The vma may have been shrunk by __split_vma()/vma_adjust() after
+	 * get_vma() found it, with the count stable again by now.
+	 */
+	if (address < snap.vm_start || address >= snap.vm_end)
+		goto out_put;
+	if (!vma_can_speculate(&snap, flags, vm_access))
+		goto out_put;
+
+	pte = spf_pte_map_lock(mm, vma, address, seq, &ptl);
+	if (!pte)
+		goto out_put;
+	entry = *pte;
+	if (pte_present(entry)) {
+		/* the tail of handle_pte_fault(), short of do_wp_page() */
+		if (!pte_numa(entry) &&
+		    (!(flags & FAULT_FLAG_WRITE) || pte_write(entry))) {
+			if (flags & FAULT_FLAG_WRITE)
+				entry = pte_mkdirty(entry);
+			entry = pte_mkyoung(entry);
+			if (ptep_set_access_flags(vma, address, pte, entry,
+						  flags & FAULT_FLAG_WRITE))
+				update_mmu_cache(vma, address, pte);
+			else if (flags & FAULT_FLAG_WRITE)
+				flush_tlb_fix_spurious_fault(vma, address);
+			ret = 0;
+		}
+		pte_unmap_unlock(pte, ptl);
+		goto out_put;
+	}
+	pte_unmap_unlock(pte, ptl);
+	/* swap and nonlinear file ptes */
+	if (!pte_none(entry))
+		goto out_put;
+
+	if (!snap.vm_ops) {
+		/* anon_vma_prepare() needs mmap_sem */
+		if (snap.anon_vma && !(snap.vm_flags & VM_SHARED))
+			ret = spf_anonymous_page(mm, vma, &snap, address,
+						 flags, seq);
+	} else if (snap.vm_ops->fault == filemap_fault &&
+		   !(flags & FAULT_FLAG_WRITE)) {
+		ret = spf_file_read_page(mm, vma, &snap, address,
+					 flags, seq);
+	}
+
+out_put:
+	put_vma(vma);
+out:
+	if (ret == VM_FAULT_RETRY) {
+		count_vm_event(SPECULATIVE_PGFAULT_ABORT);
+	} else {
+		count_vm_event(PGFAULT);
+		count_vm_event(SPECULATIVE_PGFAULT);
+		mem_cgroup_count_vm_event(mm, PGFAULT);
+	}
+	return ret;
+}
+#endif /* CONFIG_SPECULATIVE_PAGE_FAULT */
+
 #ifndef __PAGETABLE_PUD_FOLDED
 /*
  * Allocate page upper directory.
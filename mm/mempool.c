@@ -90,12 +90,22 @@ mempool_t *mempool_create_node(int min_nr, mempool_alloc_t *alloc_fn,
 	pool->free = free_fn;
 
 	/*
-	 * First pre-allocate the guaranteed number of buffers.
+	 * First pre-allocate the guaranteed number of buffers, in one go
+	 * if they come straight from a slab cache.  The bulk API takes
+	 * objects from the local cpu, so a pool for another node is filled
+	 * one object at a time from that node.
 	 */
+	if (alloc_fn == mempool_alloc_slab && node_id == NUMA_NO_NODE)
+		pool->curr_nr = kmem_cache_alloc_bulk(pool_data, gfp_mask,
+						      min_nr, pool->elements);
 	while (pool->curr_nr < pool->min_nr) {
 		void *element;
 
-		element = pool->alloc(gfp_mask, pool->pool_data);
+		if (alloc_fn == mempool_alloc_slab)
+			element = kmem_cache_alloc_node(pool_data, gfp_mask,
+							node_id);
+		else
+			element = pool->alloc(gfp_mask, pool->pool_data);
 		if (unlikely(!element)) {
 			mempool_destroy(pool);
 			return NULL;
@@ -99,6 +99,9 @@ void lruvec_init(struct lruvec *lruvec)
 
 	for_each_lru(lru)
 		INIT_LIST_HEAD(&lruvec->lists[lru]);
+#ifdef CONFIG_LRU_GEN
+	lru_gen_init_lruvec(lruvec);
+#endif
 }
 
 #if defined(CONFIG_NUMA_BALANCING) && !defined(LAST_NID_NOT_IN_PAGE_FLAGS)
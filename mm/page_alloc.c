@@ -230,6 +230,13 @@ int min_free_order_shift = 1;
  */
 int extra_free_kbytes;
 
+/*
+ * Distance between the min and low watermarks, and between low and high,
+ * as a fraction of the zone in units of 0.01%.  Raising it wakes kswapd
+ * earlier and lets it reclaim more before going back to sleep.
+ */
+int watermark_scale_factor = 10;
+
 static unsigned long __meminitdata nr_kernel_pages;
 static unsigned long __meminitdata nr_all_pages;
 static unsigned long __meminitdata dma_reserve;
@@ -2343,12 +2350,35 @@ __alloc_pages_direct_compact(gfp_t gfp_mask, unsigned int order,
 }
 #endif /* CONFIG_COMPACTION */
 
+#ifdef CONFIG_RECLAIM_LATENCY_HIST
+static void account_reclaim_latency(ktime_t start)
+{
+	struct reclaim_latency *lat = &current->signal->reclaim_lat;
+	u64 us = ktime_to_us(ktime_sub(ktime_get(), start));
+	int bucket = 0;
+
+	if (us >> RECLAIM_LAT_MIN_SHIFT)
+		bucket = min_t(int, fls64(us) - RECLAIM_LAT_MIN_SHIFT,
+			       RECLAIM_LAT_BUCKETS - 1);
+	atomic_inc(&lat->count[bucket]);
+	atomic64_add(us, &lat->total_us);
+	/* racy, but a lost update only understates a concurrent maximum */
+	if (us > ACCESS_ONCE(lat->max_us))
+		lat->max_us = min_t(u64, us, UINT_MAX);
+}
+#else
+static inline void account_reclaim_latency(ktime_t start)
+{
+}
+#endif
+
 /* Perform direct synchronous page reclaim */
 static int
 __perform_reclaim(gfp_t gfp_mask, unsigned int order, struct zonelist *zonelist,
 		  nodemask_t *nodemask)
 {
 	struct reclaim_state reclaim_state;
+	ktime_t start;
 	int progress;
 
 	cond_resched();
@@ -2360,7 +2390,9 @@ __perform_reclaim(gfp_t gfp_mask, unsigned int order, struct zonelist *zonelist,
 	reclaim_state.reclaimed_slab = 0;
 	current->reclaim_state = &reclaim_state;
 
+	start = ktime_get();
 	progress = try_to_free_pages(zonelist, order, gfp_mask, nodemask);
+	account_reclaim_latency(start);
 
 	current->reclaim_state = NULL;
 	lockdep_clear_current_reclaim_state();
@@ -5535,7 +5567,7 @@ static void __setup_per_zone_wmarks(void)
 	}
 
 	for_each_zone(zone) {
-		u64 min, low;
+		u64 min, low, tmp;
 
 		spin_lock_irqsave(&zone->lock, flags);
 		min = (u64)pages_min * zone->present_pages;
@@ -5566,10 +5598,19 @@ static void __setup_per_zone_wmarks(void)
 			zone->watermark[WMARK_MIN] = min;
 		}
 
+		/*
+		 * Set the kswapd watermarks distance according to the
+		 * scale factor in proportion to available memory, but
+		 * ensure a minimum size on small systems.
+		 */
+		tmp = max_t(u64, min >> 2,
+			    mult_frac(zone->managed_pages,
+				      watermark_scale_factor, 10000));
+
 		zone->watermark[WMARK_LOW]  = min_wmark_pages(zone) +
-					low + (min >> 2);
+					low + tmp;
 		zone->watermark[WMARK_HIGH] = min_wmark_pages(zone) +
-					low + (min >> 1);
+					low + tmp * 2;
 
 		setup_zone_migrate_reserve(zone);
 		spin_unlock_irqrestore(&zone->lock, flags);
@@ -5697,6 +5738,21 @@ int min_free_kbytes_sysctl_handler(ctl_table *table, int write,
 	return 0;
 }
 
+int watermark_scale_factor_sysctl_handler(ctl_table *table, int write,
+	void __user *buffer, size_t *length, loff_t *ppos)
+{
+	int rc;
+
+	rc = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (rc)
+		return rc;
+
+	if (write)
+		setup_per_zone_wmarks();
+
+	return 0;
+}
+
 #ifdef CONFIG_NUMA
 int sysctl_min_unmapped_ratio_sysctl_handler(ctl_table *table, int write,
 	void __user *buffer, size_t *length, loff_t *ppos)
@@ -437,6 +437,110 @@ static void __insert_vmap_area(struct vmap_area *va)
 }
 
 static void purge_vmap_area_lazy(void);
+static void __free_vmap_area(struct vmap_area *va);
+
+/*
+ * Per-cpu cache of small, already purged vmap areas
+ *
+ * Most vmap areas are a few pages long, and every one of them costs an
+ * rbtree walk to allocate, a lazy free, and a share of a global TLB flush
+ * to purge. Areas up to VMAP_CACHE_PAGES long (guard page included) that
+ * come out of a purge are kept, still inserted in the rbtree, in a small
+ * per-cpu cache instead, and handed out again as they are: their TLB
+ * entries are gone already. The cache is bounded, so at most
+ * VMAP_CACHE_DEPTH * (1 + .. + VMAP_CACHE_PAGES) pages of address space
+ * are held per cpu, and it is drained when an allocation fails for lack
+ * of space.
+ */
+#define VMAP_CACHE_PAGES	4
+#define VMAP_CACHE_DEPTH	8
+
+struct vmap_area_cache {
+	spinlock_t		lock;
+	unsigned int		nr[VMAP_CACHE_PAGES];
+	struct vmap_area	*va[VMAP_CACHE_PAGES][VMAP_CACHE_DEPTH];
+};
+
+static DEFINE_PER_CPU(struct vmap_area_cache, vmap_area_cache);
+
+static inline int vmap_cache_class(unsigned long size)
+{
+	return (size >> PAGE_SHIFT) - 1;
+}
+
+static struct vmap_area *vmap_cache_get(unsigned long size,
+				unsigned long align,
+				unsigned long vstart, unsigned long vend)
+{
+	struct vmap_area_cache *vc;
+	struct vmap_area *va = NULL;
+	int class = vmap_cache_class(size);
+	int i;
+
+	if (class >= VMAP_CACHE_PAGES)
+		return NULL;
+
+	vc = &get_cpu_var(vmap_area_cache);
+	spin_lock(&vc->lock);
+	for (i = vc->nr[class] - 1; i >= 0; i--) {
+		struct vmap_area *tmp = vc->va[class][i];
+
+		if (tmp->va_start >= vstart && tmp->va_end <= vend &&
+		    IS_ALIGNED(tmp->va_start, align)) {
+			va = tmp;
+			vc->va[class][i] = vc->va[class][--vc->nr[class]];
+			break;
+		}
+	}
+	spin_unlock(&vc->lock);
+	put_cpu_var(vmap_area_cache);
+
+	if (va)
+		count_vm_event(VMAP_CACHE_HIT);
+	return va;
+}
+
+/* Returns false if @va did not fit in this cpu's cache */
+static bool vmap_cache_put(struct vmap_area *va)
+{
+	struct vmap_area_cache *vc;
+	int class = vmap_cache_class(va->va_end - va->va_start);
+	bool cached = false;
+
+	if (class >= VMAP_CACHE_PAGES)
+		return false;
+
+	vc = &get_cpu_var(vmap_area_cache);
+	spin_lock(&vc->lock);
+	if (vc->nr[class] < VMAP_CACHE_DEPTH) {
+		va->flags = 0;
+		va->vm = NULL;
+		vc->va[class][vc->nr[class]++] = va;
+		cached = true;
+	}
+	spin_unlock(&vc->lock);
+	put_cpu_var(vmap_area_cache);
+
+	return cached;
+}
+
+static void vmap_cache_drain(void)
+{
+	int cpu, class;
+
+	for_each_possible_cpu(cpu) {
+		struct vmap_area_cache *vc = &per_cpu(vmap_area_cache, cpu);
+
+		spin_lock(&vc->lock);
+		spin_lock(&vmap_area_lock);
+		for (class = 0; class < VMAP_CACHE_PAGES; class++) {
+			while (vc->nr[class])
+				__free_vmap_area(vc->va[class][--vc->nr[class]]);
+		}
+		spin_unlock(&vmap_area_lock);
+		spin_unlock(&vc->lock);
+	}
+}
 
 /*
  * Allocate a region of KVA of the specified size and alignment, within the
@@ -457,6 +561,10 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 	BUG_ON(size & ~PAGE_MASK);
 	BUG_ON(!is_power_of_2(align));
 
+	va = vmap_cache_get(size, align, vstart, vend);
+	if (va)
+		return va;
+
 	va = kmalloc_node(sizeof(struct vmap_area),
 			gfp_mask & GFP_RECLAIM_MASK, node);
 	if (unlikely(!va))
@@ -658,10 +766,20 @@ static void vmap_debug_free_range(unsigned long start, unsigned long end)
 static unsigned long lazy_max_pages(void)
 {
 	unsigned int log;
+	unsigned long pages;
 
 	log = fls(num_online_cpus());
+	pages = log * (32UL * 1024 * 1024 / PAGE_SIZE);
+
+	/*
+	 * On a small vmalloc area (32-bit) a backlog that size leaves too
+	 * little room for new allocations, which then end up doing the
+	 * purge synchronously from alloc_vmap_area().
+	 */
+	if (VMALLOC_TOTAL)
+		pages = min(pages, (VMALLOC_TOTAL >> PAGE_SHIFT) / 4);
 
-	return log * (32UL * 1024 * 1024 / PAGE_SIZE);
+	return pages;
 }
 
 static atomic_t vmap_lazy_nr = ATOMIC_INIT(0);
@@ -678,6 +796,42 @@ void set_iounmap_nonlazy(void)
 	atomic_set(&vmap_lazy_nr, lazy_max_pages()+1);
 }
 
+/*
+ * Flushing the hull of all purged areas walks every page in between on
+ * architectures that invalidate page by page. When the purged areas cover
+ * only a small part of their hull, flush them one by one instead.
+ */
+#define VMAP_PURGE_MAX_RANGES	32
+
+static void purge_flush_tlb(struct list_head *valist, unsigned long start,
+			    unsigned long end, int nr, int nr_ranges)
+{
+	unsigned long hull = (end - start) >> PAGE_SHIFT;
+	struct vmap_area *va;
+
+	count_vm_event(VMAP_PURGE_FLUSH);
+
+	if (nr_ranges > VMAP_PURGE_MAX_RANGES || hull <= 2 * nr) {
+		flush_tlb_kernel_range(start, end);
+		count_vm_events(VMAP_PURGE_FLUSH_PAGES, hull);
+		return;
+	}
+
+	count_vm_event(VMAP_PURGE_FLUSH_RANGED);
+	/* valist is address sorted: merge neighbouring areas */
+	start = end = 0;
+	list_for_each_entry(va, valist, purge_list) {
+		if (va->va_start != end) {
+			if (end)
+				flush_tlb_kernel_range(start, end);
+			start = va->va_start;
+		}
+		end = va->va_end;
+	}
+	flush_tlb_kernel_range(start, end);
+	count_vm_events(VMAP_PURGE_FLUSH_PAGES, nr);
+}
+
 /*
  * Purges all lazily-freed vmap areas.
  *
@@ -695,7 +849,7 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 	LIST_HEAD(valist);
 	struct vmap_area *va;
 	struct vmap_area *n_va;
-	int nr = 0;
+	int nr = 0, nr_ranges = 0;
 
 	/*
 	 * If sync is 0 but force_flush is 1, we'll go sync anyway but callers
@@ -719,6 +873,7 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 			if (va->va_end > *end)
 				*end = va->va_end;
 			nr += (va->va_end - va->va_start) >> PAGE_SHIFT;
+			nr_ranges++;
 			list_add_tail(&va->purge_list, &valist);
 			va->flags |= VM_LAZY_FREEING;
 			va->flags &= ~VM_LAZY_FREE;
@@ -726,13 +881,27 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 	}
 	rcu_read_unlock();
 
-	if (nr)
+	if (nr) {
 		atomic_sub(nr, &vmap_lazy_nr);
+		count_vm_event(VMAP_PURGE);
+		count_vm_events(VMAP_PURGE_PAGES, nr);
+	}
 
-	if (nr || force_flush)
+	if (force_flush) {
+		/* the caller's own range must be covered as a whole */
+		count_vm_event(VMAP_PURGE_FLUSH);
+		count_vm_events(VMAP_PURGE_FLUSH_PAGES,
+				(*end - *start) >> PAGE_SHIFT);
 		flush_tlb_kernel_range(*start, *end);
+	} else if (nr) {
+		purge_flush_tlb(&valist, *start, *end, nr, nr_ranges);
+	}
 
 	if (nr) {
+		list_for_each_entry_safe(va, n_va, &valist, purge_list) {
+			if (vmap_cache_put(va))
+				list_del(&va->purge_list);
+		}
 		spin_lock(&vmap_area_lock);
 		list_for_each_entry_safe(va, n_va, &valist, purge_list)
 			__free_vmap_area(va);
@@ -760,6 +929,8 @@ static void purge_vmap_area_lazy(void)
 	unsigned long start = ULONG_MAX, end = 0;
 
 	__purge_vmap_area_lazy(&start, &end, 1, 0);
+	/* whoever calls this is short of address space */
+	vmap_cache_drain();
 }
 
 /*
@@ -1333,6 +1504,7 @@ void __init vmalloc_init(void)
 		p = &per_cpu(vfree_deferred, i);
 		init_llist_head(&p->list);
 		INIT_WORK(&p->wq, free_work);
+		spin_lock_init(&per_cpu(vmap_area_cache, i).lock);
 	}
 
 	/* Import existing vmlist entries. */
@@ -83,6 +83,9 @@ struct scan_control {
 	/* Can pages be swapped as part of reclaim? */
 	int may_swap;
 
+	/* Can dirty pages be written out when force_reclaim skips references? */
+	int force_pageout;
+
 	int order;
 
 	int swappiness;
@@ -533,7 +536,8 @@ static pageout_t pageout(struct page *page, struct address_space *mapping,
  * Same as remove_mapping, but if the page is removed from the mapping, it
  * gets returned with a refcount of 0.
  */
-static int __remove_mapping(struct address_space *mapping, struct page *page)
+static int __remove_mapping(struct address_space *mapping, struct page *page,
+			    bool reclaimed)
 {
 	BUG_ON(!PageLocked(page));
 	BUG_ON(mapping != page_mapping(page));
@@ -579,10 +583,23 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 		swapcache_free(swap, page);
 	} else {
 		void (*freepage)(struct page *);
+		void *shadow = NULL;
 
 		freepage = mapping->a_ops->freepage;
-
-		__delete_from_page_cache(page);
+		/*
+		 * Remember a shadow entry for reclaimed file cache in
+		 * order to detect refaults, thus thrashing, later on.
+		 *
+		 * But don't store shadows in an address space that is
+		 * already exiting.  This is not just an optimization,
+		 * inode reclaim needs to empty out the radix tree or
+		 * the nodes are lost.  Don't plant shadows behind its
+		 * back.
+		 */
+		if (reclaimed && page_is_file_cache(page) &&
+		    !mapping_exiting(mapping))
+			shadow = workingset_eviction(mapping, page);
+		__delete_from_page_cache(page, shadow);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
 
@@ -605,7 +622,7 @@ cannot_free:
  */
 int remove_mapping(struct address_space *mapping, struct page *page)
 {
-	if (__remove_mapping(mapping, page)) {
+	if (__remove_mapping(mapping, page, false)) {
 		/*
 		 * Unfreezing the refcount with 1 rather than 2 effectively
 		 * drops the pagecache ref for us without requiring another
@@ -789,7 +806,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			goto keep;
 
 		VM_BUG_ON(PageActive(page));
-		VM_BUG_ON(page_zone(page) != zone);
+		VM_BUG_ON(zone && page_zone(page) != zone);
 
 		sc->nr_scanned++;
 
@@ -841,6 +858,8 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 
 		if (!force_reclaim)
 			references = page_check_references(page, sc);
+		else if (sc->force_pageout)
+			references = PAGEREF_RECLAIM;
 
 		switch (references) {
 		case PAGEREF_ACTIVATE:
@@ -982,7 +1001,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			}
 		}
 
-		if (!mapping || !__remove_mapping(mapping, page))
+		if (!mapping || !__remove_mapping(mapping, page, true))
 			goto keep_locked;
 
 		/*
@@ -1030,7 +1049,7 @@ keep:
 	 * back off and wait for congestion to clear because further reclaim
 	 * will encounter the same problem
 	 */
-	if (nr_dirty && nr_dirty == nr_congested && global_reclaim(sc))
+	if (nr_dirty && nr_dirty == nr_congested && global_reclaim(sc) && zone)
 		zone_set_flag(zone, ZONE_CONGESTED);
 
 	free_hot_cold_page_list(&free_pages, 1);
@@ -1071,6 +1090,54 @@ unsigned long reclaim_clean_pages_from_list(struct zone *zone,
 	return ret;
 }
 
+#ifdef CONFIG_PROCESS_RECLAIM
+/*
+ * Reclaims pages that /proc/<pid>/reclaim isolated from one task's page
+ * tables. The pages may come from any zone, and the caller has already
+ * decided they are cold, so the references check is skipped. Dirty pages,
+ * which includes every anon page add_to_swap() just gave a swap slot,
+ * are written out rather than kept.
+ */
+unsigned long reclaim_pages_from_list(struct list_head *page_list)
+{
+	struct scan_control sc = {
+		.gfp_mask = GFP_KERNEL,
+		.priority = DEF_PRIORITY,
+		.may_writepage = 1,
+		.may_unmap = 1,
+		.may_swap = 1,
+		.force_pageout = 1,
+	};
+	unsigned long nr_reclaimed, dummy1 = 0, dummy2 = 0;
+	struct page *page;
+
+	/*
+	 * shrink_page_list() frees pages without telling which, so drop
+	 * the isolation accounting up front.
+	 */
+	list_for_each_entry(page, page_list, lru) {
+		ClearPageActive(page);
+		dec_zone_page_state(page, NR_ISOLATED_ANON +
+				    page_is_file_cache(page));
+	}
+
+	nr_reclaimed = shrink_page_list(page_list, NULL, &sc,
+					TTU_UNMAP|TTU_IGNORE_ACCESS,
+					&dummy1, &dummy2, true);
+
+	count_vm_events(PGSCAN_PROCESS, sc.nr_scanned);
+	count_vm_events(PGSTEAL_PROCESS, nr_reclaimed);
+
+	while (!list_empty(page_list)) {
+		page = lru_to_page(page_list);
+		list_del(&page->lru);
+		putback_lru_page(page);
+	}
+
+	return nr_reclaimed;
+}
+#endif
+
 /*
  * Attempt to remove the specified page from its LRU.  Only take this page
  * if it is of the appropriate PageActive status.  Pages which are being
@@ -1946,6 +2013,709 @@ out:
 	}
 }
 
+#ifdef CONFIG_LRU_GEN
+/*
+ * Multi-generational LRU, see struct lru_gen_struct.
+ *
+ * Aging: once the oldest generation of the type reclaim wants to evict is
+ * one of the two youngest, lru_gen_age() walks the page tables of every mm
+ * on lru_gen_mm_list, moves the pages of the lruvec whose ptes have been
+ * accessed into the youngest generation, taking zone->lru_lock once per
+ * page table page rather than once per page, and then opens a new
+ * youngest generation. Unmapped page cache is promoted by
+ * mark_page_accessed() through activate_page() as before.
+ *
+ * Eviction: pages are isolated from the tail of the oldest generation and
+ * go through shrink_page_list() like inactive pages do. Those it finds in
+ * use are activated, which puts them back in the youngest generation, and
+ * are counted as protected, as are file pages that workingset_refault()
+ * finds coming back too soon after their eviction. The ratio of protected
+ * to evicted pages of each type, weighted by swappiness, decides whether
+ * anon or file pages are evicted next.
+ */
+
+/* pages moved per zone->lru_lock hold when a whole list is processed */
+#define LRU_GEN_BATCH		64
+
+static bool lru_gen_state __read_mostly = IS_ENABLED(CONFIG_LRU_GEN_ENABLED);
+
+static LIST_HEAD(lru_gen_mm_list);
+static DEFINE_SPINLOCK(lru_gen_mm_lock);
+
+void lru_gen_add_mm(struct mm_struct *mm)
+{
+	spin_lock(&lru_gen_mm_lock);
+	list_add_tail(&mm->lru_gen_list, &lru_gen_mm_list);
+	spin_unlock(&lru_gen_mm_lock);
+}
+
+/*
+ * Only mms that made it into a task are added, and an mm that failed
+ * earlier may still go through mmput(), so it may not be on the list.
+ */
+void lru_gen_del_mm(struct mm_struct *mm)
+{
+	if (list_empty(&mm->lru_gen_list))
+		return;
+
+	spin_lock(&lru_gen_mm_lock);
+	list_del_init(&mm->lru_gen_list);
+	spin_unlock(&lru_gen_mm_lock);
+}
+
+void lru_gen_init_lruvec(struct lruvec *lruvec)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int gen, type;
+
+	lrugen->max_seq = MIN_NR_GENS + 1;
+	for (gen = 0; gen < MAX_NR_GENS; gen++)
+		for (type = 0; type < 2; type++)
+			INIT_LIST_HEAD(&lrugen->lists[gen][type]);
+	lrugen->enabled = lru_gen_state;
+}
+
+static bool lru_gen_lruvec_enabled(struct lruvec *lruvec)
+{
+	return lruvec->lrugen.enabled;
+}
+
+/*
+ * A file page that refaulted within reach of the active list was evicted
+ * too early: count it against its type like a page found in use at
+ * eviction time.
+ */
+void lru_gen_refault(struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	struct lruvec *lruvec;
+
+	spin_lock_irq(&zone->lru_lock);
+	lruvec = mem_cgroup_page_lruvec(page, zone);
+	if (lru_gen_lruvec_enabled(lruvec))
+		lruvec->lrugen.protected[page_is_file_cache(page)]++;
+	spin_unlock_irq(&zone->lru_lock);
+}
+
+static int get_nr_gens(struct lruvec *lruvec, int type)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+
+	return lrugen->max_seq - lrugen->min_seq[type] + 1;
+}
+
+static long get_nr_type_pages(struct lruvec *lruvec, int type)
+{
+	long nr = 0;
+	int gen;
+
+	for (gen = 0; gen < MAX_NR_GENS; gen++)
+		nr += ACCESS_ONCE(lruvec->lrugen.nr_pages[gen][type]);
+	return nr;
+}
+
+/* retire the oldest generation of @type, its list must be empty */
+static void advance_min_seq(struct lruvec *lruvec, int type)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+
+	lrugen->avg_evicted[type] =
+		(lrugen->avg_evicted[type] + lrugen->evicted[type]) / 2;
+	lrugen->avg_protected[type] =
+		(lrugen->avg_protected[type] + lrugen->protected[type]) / 2;
+	lrugen->evicted[type] = 0;
+	lrugen->protected[type] = 0;
+	lrugen->min_seq[type]++;
+}
+
+static void try_to_inc_min_seq(struct lruvec *lruvec, int type)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+
+	while (get_nr_gens(lruvec, type) > MIN_NR_GENS) {
+		int gen = lru_gen_from_seq(lrugen->min_seq[type]);
+
+		if (!list_empty(&lrugen->lists[gen][type]))
+			break;
+		WARN_ON_ONCE(lrugen->nr_pages[gen][type]);
+		advance_min_seq(lruvec, type);
+	}
+}
+
+/*
+ * Fold the oldest generation of @type into the next one to make room for
+ * a new youngest generation. Pages aging has already promoted are sorted
+ * onto their own lists on the way. Returns false if it stopped early so
+ * that the caller can drop zone->lru_lock for a while.
+ */
+static bool inc_min_seq(struct lruvec *lruvec, int type)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int old_gen = lru_gen_from_seq(lrugen->min_seq[type]);
+	int new_gen = lru_gen_from_seq(lrugen->min_seq[type] + 1);
+	struct list_head *head = &lrugen->lists[old_gen][type];
+	int remaining = LRU_GEN_BATCH;
+
+	while (!list_empty(head)) {
+		struct page *page = list_first_entry(head, struct page, lru);
+		int gen = page_lru_gen(page);
+
+		VM_BUG_ON(!PageLRU(page));
+		if (gen == old_gen) {
+			set_page_lru_gen(page, new_gen);
+			lru_gen_update_size(lruvec, page, old_gen, new_gen);
+			gen = new_gen;
+		}
+		list_move_tail(&page->lru, &lrugen->lists[gen][type]);
+		if (!--remaining)
+			return false;
+	}
+
+	advance_min_seq(lruvec, type);
+	return true;
+}
+
+static void inc_max_seq(struct lruvec *lruvec, unsigned long max_seq)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	struct zone *zone = lruvec_zone(lruvec);
+	int prev, type;
+
+	spin_lock_irq(&zone->lru_lock);
+	for (type = 0; type < 2; type++) {
+		while (max_seq == lrugen->max_seq &&
+		       get_nr_gens(lruvec, type) == MAX_NR_GENS &&
+		       !inc_min_seq(lruvec, type)) {
+			spin_unlock_irq(&zone->lru_lock);
+			cond_resched();
+			spin_lock_irq(&zone->lru_lock);
+		}
+	}
+
+	/* somebody else got here first */
+	if (max_seq != lrugen->max_seq)
+		goto unlock;
+
+	/* the second youngest generation is about to become inactive */
+	prev = lru_gen_from_seq(max_seq - 1);
+	for (type = 0; type < 2; type++) {
+		enum lru_list lru = type ? LRU_INACTIVE_FILE : LRU_INACTIVE_ANON;
+		long nr_pages = lrugen->nr_pages[prev][type];
+
+		if (!nr_pages)
+			continue;
+		lru_gen_update_lru_size(lruvec, lru + LRU_ACTIVE, -nr_pages);
+		lru_gen_update_lru_size(lruvec, lru, nr_pages);
+	}
+	ACCESS_ONCE(lrugen->max_seq) = max_seq + 1;
+	__count_vm_event(LRU_GEN_AGING);
+unlock:
+	spin_unlock_irq(&zone->lru_lock);
+}
+
+struct lru_gen_walk {
+	struct lruvec *lruvec;
+	struct vm_area_struct *vma;
+	unsigned long nr_pte;
+	unsigned long nr_young;
+	bool flush;
+};
+
+static int lru_gen_walk_pmd(pmd_t *pmd, unsigned long addr,
+			    unsigned long end, struct mm_walk *mm_walk)
+{
+	struct lru_gen_walk *walk = mm_walk->private;
+	struct vm_area_struct *vma = walk->vma;
+	struct lruvec *lruvec = walk->lruvec;
+	struct zone *zone = lruvec_zone(lruvec);
+	bool locked = false;
+	pte_t *pte, *orig_pte;
+	spinlock_t *ptl;
+
+	if (pmd_trans_unstable(pmd))
+		return 0;
+
+	orig_pte = pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		pte_t ptent = *pte;
+		struct page *page;
+		int gen, new_gen;
+
+		walk->nr_pte++;
+		if (!pte_present(ptent) || !pte_young(ptent))
+			continue;
+
+		page = vm_normal_page(vma, addr, ptent);
+		if (!page || page_zone(page) != zone)
+			continue;
+
+		/* one lock hold for all the young pages of this table */
+		if (!locked) {
+			spin_lock_irq(&zone->lru_lock);
+			locked = true;
+		}
+		if (!PageLRU(page) ||
+		    mem_cgroup_page_lruvec(page, zone) != lruvec)
+			continue;
+		gen = page_lru_gen(page);
+		if (gen < 0 || !ptep_test_and_clear_young(vma, addr, pte))
+			continue;
+
+		walk->flush = true;
+		new_gen = lru_gen_from_seq(lruvec->lrugen.max_seq);
+		if (gen != new_gen) {
+			set_page_lru_gen(page, new_gen);
+			lru_gen_update_size(lruvec, page, gen, new_gen);
+			walk->nr_young++;
+		}
+	}
+	if (locked)
+		spin_unlock_irq(&zone->lru_lock);
+	pte_unmap_unlock(orig_pte, ptl);
+	cond_resched();
+	return 0;
+}
+
+static void lru_gen_walk_mm(struct mm_struct *mm, struct lru_gen_walk *walk)
+{
+	struct mm_walk mm_walk = {
+		.pmd_entry = lru_gen_walk_pmd,
+		.mm = mm,
+		.private = walk,
+	};
+	struct vm_area_struct *vma;
+
+	/* never wait for mmap_sem from reclaim */
+	if (!down_read_trylock(&mm->mmap_sem))
+		return;
+
+	walk->flush = false;
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (is_vm_hugetlb_page(vma) ||
+		    (vma->vm_flags & (VM_LOCKED | VM_IO | VM_PFNMAP |
+				      VM_SEQ_READ)))
+			continue;
+		walk->vma = vma;
+		walk_page_range(vma->vm_start, vma->vm_end, &mm_walk);
+	}
+	if (walk->flush)
+		flush_tlb_mm(mm);
+	up_read(&mm->mmap_sem);
+}
+
+/*
+ * Visit every mm on lru_gen_mm_list. The mm being walked is pinned, which
+ * keeps it on the list, so it doubles as the cursor.
+ */
+static void lru_gen_walk_mm_list(struct lruvec *lruvec)
+{
+	struct lru_gen_walk walk = {
+		.lruvec = lruvec,
+	};
+	struct mm_struct *mm, *prev = NULL;
+	struct list_head *pos;
+
+	spin_lock(&lru_gen_mm_lock);
+	pos = lru_gen_mm_list.next;
+	while (pos != &lru_gen_mm_list) {
+		mm = list_entry(pos, struct mm_struct, lru_gen_list);
+		if (!atomic_inc_not_zero(&mm->mm_users)) {
+			pos = pos->next;
+			continue;
+		}
+		spin_unlock(&lru_gen_mm_lock);
+
+		if (prev)
+			mmput(prev);
+		prev = mm;
+		lru_gen_walk_mm(mm, &walk);
+
+		spin_lock(&lru_gen_mm_lock);
+		pos = mm->lru_gen_list.next;
+	}
+	spin_unlock(&lru_gen_mm_lock);
+	if (prev)
+		mmput(prev);
+
+	count_vm_events(LRU_GEN_WALK_PTE, walk.nr_pte);
+	count_vm_events(LRU_GEN_WALK_YOUNG, walk.nr_young);
+}
+
+static void lru_gen_age(struct lruvec *lruvec, struct scan_control *sc)
+{
+	unsigned long max_seq = ACCESS_ONCE(lruvec->lrugen.max_seq);
+
+	/*
+	 * Dropping the last reference to an mm can end up in the filesystem,
+	 * so only walk when reclaim is allowed to.
+	 */
+	if (sc->gfp_mask & __GFP_FS)
+		lru_gen_walk_mm_list(lruvec);
+	inc_max_seq(lruvec, max_seq);
+}
+
+/*
+ * Pick the type to evict from: file unless the file pages evicted lately
+ * were found in use more often than the anon ones, after scaling both by
+ * the weight swappiness gives them. Returns -1 if there is nothing to do.
+ */
+static int get_type_to_scan(struct lruvec *lruvec, struct scan_control *sc)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int swappiness = vmscan_swappiness(sc);
+	bool has_anon = get_nr_type_pages(lruvec, 0) > 0;
+	bool has_file = get_nr_type_pages(lruvec, 1) > 0;
+	u64 anon_prot, anon_total, file_prot, file_total;
+
+	if (!sc->may_swap || get_nr_swap_pages() <= 0)
+		has_anon = false;
+	if (!has_anon)
+		return has_file ? 1 : -1;
+	if (!has_file)
+		return 0;
+
+	anon_prot = lrugen->avg_protected[0] + lrugen->protected[0];
+	anon_total = anon_prot + lrugen->avg_evicted[0] + lrugen->evicted[0];
+	file_prot = lrugen->avg_protected[1] + lrugen->protected[1];
+	file_total = file_prot + lrugen->avg_evicted[1] + lrugen->evicted[1];
+
+	if (file_prot < SWAP_CLUSTER_MAX)
+		return 1;
+	return file_prot * (anon_total + SWAP_CLUSTER_MAX) * swappiness <=
+	       (anon_prot + 1) * file_total * (max_swappiness - swappiness);
+}
+
+/*
+ * Reclaim up to @nr_to_scan pages from the oldest generation of @type.
+ * *nr_scanned is left at zero if that generation is one of the two
+ * youngest and the lruvec has to age first.
+ */
+static unsigned long lru_gen_evict(struct lruvec *lruvec,
+				   struct scan_control *sc, int type,
+				   unsigned long nr_to_scan,
+				   unsigned long *nr_scanned)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	struct zone *zone = lruvec_zone(lruvec);
+	LIST_HEAD(page_list);
+	isolate_mode_t isolate_mode = 0;
+	unsigned long scanned = 0, taken = 0, protected = 0;
+	unsigned long nr_reclaimed;
+	unsigned long nr_dirty = 0;
+	unsigned long nr_writeback = 0;
+	struct list_head *head;
+	struct page *page;
+	int safe = 0;
+	int gen;
+
+	*nr_scanned = 0;
+	while (unlikely(too_many_isolated(zone, type, sc, safe))) {
+		congestion_wait(BLK_RW_ASYNC, HZ/10);
+
+		/* We are about to die and free our memory. Return now. */
+		if (fatal_signal_pending(current))
+			return SWAP_CLUSTER_MAX;
+
+		safe = 1;
+	}
+
+	lru_add_drain();
+
+	if (!sc->may_unmap)
+		isolate_mode |= ISOLATE_UNMAPPED;
+	if (!sc->may_writepage)
+		isolate_mode |= ISOLATE_CLEAN;
+
+	spin_lock_irq(&zone->lru_lock);
+
+	try_to_inc_min_seq(lruvec, type);
+	if (get_nr_gens(lruvec, type) <= MIN_NR_GENS) {
+		spin_unlock_irq(&zone->lru_lock);
+		return 0;
+	}
+
+	gen = lru_gen_from_seq(lrugen->min_seq[type]);
+	head = &lrugen->lists[gen][type];
+	while (scanned < nr_to_scan && !list_empty(head)) {
+		int page_gen;
+
+		page = lru_to_page(head);
+		page_gen = page_lru_gen(page);
+		scanned++;
+
+		VM_BUG_ON(!PageLRU(page));
+		if (page_gen != gen) {
+			/* promoted by aging after it was queued here */
+			list_move(&page->lru, &lrugen->lists[page_gen][type]);
+			continue;
+		}
+		if (__isolate_lru_page(page, isolate_mode)) {
+			list_move(&page->lru, head);
+			continue;
+		}
+		lru_gen_del_page(lruvec, page);
+		list_add(&page->lru, &page_list);
+		taken += hpage_nr_pages(page);
+	}
+	try_to_inc_min_seq(lruvec, type);
+
+	__mod_zone_page_state(zone, NR_ISOLATED_ANON + type, taken);
+	if (global_reclaim(sc)) {
+		zone->pages_scanned += scanned;
+		if (current_is_kswapd())
+			__count_zone_vm_events(PGSCAN_KSWAPD, zone, scanned);
+		else
+			__count_zone_vm_events(PGSCAN_DIRECT, zone, scanned);
+	}
+	spin_unlock_irq(&zone->lru_lock);
+
+	*nr_scanned = scanned;
+	if (!taken)
+		return 0;
+
+	nr_reclaimed = shrink_page_list(&page_list, zone, sc, TTU_UNMAP,
+					&nr_dirty, &nr_writeback, false);
+
+	list_for_each_entry(page, &page_list, lru)
+		if (PageActive(page))
+			protected += hpage_nr_pages(page);
+
+	spin_lock_irq(&zone->lru_lock);
+
+	lrugen->evicted[type] += nr_reclaimed;
+	lrugen->protected[type] += protected;
+	lruvec->reclaim_stat.recent_scanned[type] += taken;
+	__count_vm_events(type ? LRU_GEN_EVICT_FILE : LRU_GEN_EVICT_ANON,
+			  nr_reclaimed);
+	__count_vm_events(LRU_GEN_PROTECTED, protected);
+
+	if (global_reclaim(sc)) {
+		if (current_is_kswapd())
+			__count_zone_vm_events(PGSTEAL_KSWAPD, zone,
+					       nr_reclaimed);
+		else
+			__count_zone_vm_events(PGSTEAL_DIRECT, zone,
+					       nr_reclaimed);
+	}
+
+	putback_inactive_pages(lruvec, &page_list);
+
+	__mod_zone_page_state(zone, NR_ISOLATED_ANON + type, -taken);
+
+	spin_unlock_irq(&zone->lru_lock);
+
+	free_hot_cold_page_list(&page_list, 1);
+
+	return nr_reclaimed;
+}
+
+static bool lru_gen_shrink_lruvec(struct lruvec *lruvec,
+				  struct scan_control *sc)
+{
+	unsigned long nr_to_scan, total;
+	unsigned long nr_reclaimed = 0;
+	struct blk_plug plug;
+	bool aged = false;
+
+	if (!lru_gen_lruvec_enabled(lruvec))
+		return false;
+
+	total = max(get_nr_type_pages(lruvec, 0), 0L) +
+		max(get_nr_type_pages(lruvec, 1), 0L);
+	nr_to_scan = total >> sc->priority;
+	if (!nr_to_scan && (!global_reclaim(sc) || !sc->priority))
+		nr_to_scan = min(total, SWAP_CLUSTER_MAX);
+
+	blk_start_plug(&plug);
+	while (nr_to_scan) {
+		unsigned long scanned;
+		int type = get_type_to_scan(lruvec, sc);
+
+		if (type < 0)
+			break;
+
+		nr_reclaimed += lru_gen_evict(lruvec, sc, type,
+					      min(nr_to_scan, SWAP_CLUSTER_MAX),
+					      &scanned);
+		if (!scanned) {
+			/* one round of aging per call is plenty */
+			if (aged)
+				break;
+			lru_gen_age(lruvec, sc);
+			aged = true;
+			continue;
+		}
+		nr_to_scan -= min(nr_to_scan, scanned);
+
+		if (nr_reclaimed >= sc->nr_to_reclaim &&
+		    sc->priority < DEF_PRIORITY)
+			break;
+	}
+	blk_finish_plug(&plug);
+	sc->nr_reclaimed += nr_reclaimed;
+
+	throttle_vm_writeout(sc->gfp_mask);
+	return true;
+}
+
+#ifdef CONFIG_SYSFS
+/* move the pages of the active/inactive lists into generations */
+static bool lru_gen_fill_lruvec(struct lruvec *lruvec)
+{
+	int remaining = LRU_GEN_BATCH;
+	enum lru_list lru;
+
+	for_each_evictable_lru(lru) {
+		struct list_head *head = &lruvec->lists[lru];
+
+		while (!list_empty(head)) {
+			struct page *page = lru_to_page(head);
+
+			VM_BUG_ON(!PageLRU(page));
+			del_page_from_lru_list(page, lruvec, lru);
+			add_page_to_lru_list(page, lruvec, lru);
+			if (!--remaining)
+				return false;
+		}
+	}
+	return true;
+}
+
+/* and back, the two youngest generations becoming the active lists */
+static bool lru_gen_drain_lruvec(struct lruvec *lruvec)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int remaining = LRU_GEN_BATCH;
+	int type, i;
+
+	for (type = 0; type < 2; type++) {
+		for (i = 0; i < MAX_NR_GENS; i++) {
+			int gen = lru_gen_from_seq(lrugen->min_seq[type] + i);
+			struct list_head *head = &lrugen->lists[gen][type];
+
+			while (!list_empty(head)) {
+				struct page *page = lru_to_page(head);
+				bool active;
+
+				VM_BUG_ON(!PageLRU(page));
+				active = lru_gen_is_active(lruvec,
+							   page_lru_gen(page));
+				del_page_from_lru_list(page, lruvec,
+						       page_lru(page));
+				if (active)
+					SetPageActive(page);
+				add_page_to_lru_list(page, lruvec,
+						     page_lru(page));
+				if (!--remaining)
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+static DEFINE_MUTEX(lru_gen_state_mutex);
+
+static void lru_gen_change_state(bool enabled)
+{
+	struct zone *zone;
+
+	mutex_lock(&lru_gen_state_mutex);
+	if (enabled == lru_gen_state)
+		goto unlock;
+
+	ACCESS_ONCE(lru_gen_state) = enabled;
+	lru_add_drain_all();
+
+	for_each_populated_zone(zone) {
+		struct mem_cgroup *memcg = mem_cgroup_iter(NULL, NULL, NULL);
+
+		do {
+			struct lruvec *lruvec = mem_cgroup_zone_lruvec(zone, memcg);
+
+			spin_lock_irq(&zone->lru_lock);
+			lruvec->lrugen.enabled = enabled;
+			while (!(enabled ? lru_gen_fill_lruvec(lruvec) :
+					   lru_gen_drain_lruvec(lruvec))) {
+				spin_unlock_irq(&zone->lru_lock);
+				cond_resched();
+				spin_lock_irq(&zone->lru_lock);
+			}
+			spin_unlock_irq(&zone->lru_lock);
+
+			memcg = mem_cgroup_iter(NULL, memcg, NULL);
+		} while (memcg);
+	}
+unlock:
+	mutex_unlock(&lru_gen_state_mutex);
+}
+
+static ssize_t lru_gen_enabled_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", lru_gen_state);
+}
+
+static ssize_t lru_gen_enabled_store(struct kobject *kobj,
+				     struct kobj_attribute *attr,
+				     const char *buf, size_t count)
+{
+	bool enabled;
+
+	if (strtobool(buf, &enabled))
+		return -EINVAL;
+
+	lru_gen_change_state(enabled);
+	return count;
+}
+static struct kobj_attribute lru_gen_enabled_attr =
+	__ATTR(enabled, 0644, lru_gen_enabled_show, lru_gen_enabled_store);
+
+static struct attribute *lru_gen_attrs[] = {
+	&lru_gen_enabled_attr.attr,
+	NULL,
+};
+
+static struct attribute_group lru_gen_attr_group = {
+	.attrs = lru_gen_attrs,
+};
+
+static int __init lru_gen_init_sysfs(void)
+{
+	struct kobject *lru_gen_kobj;
+	int err;
+
+	lru_gen_kobj = kobject_create_and_add("lru_gen", mm_kobj);
+	if (!lru_gen_kobj) {
+		pr_err("failed to create lru_gen kobject\n");
+		return -ENOMEM;
+	}
+	err = sysfs_create_group(lru_gen_kobj, &lru_gen_attr_group);
+	if (err) {
+		pr_err("failed to register lru_gen group\n");
+		kobject_put(lru_gen_kobj);
+		return err;
+	}
+	return 0;
+}
+subsys_initcall(lru_gen_init_sysfs);
+#endif /* CONFIG_SYSFS */
+
+#else /* CONFIG_LRU_GEN */
+
+static bool lru_gen_lruvec_enabled(struct lruvec *lruvec)
+{
+	return false;
+}
+
+static bool lru_gen_shrink_lruvec(struct lruvec *lruvec,
+				  struct scan_control *sc)
+{
+	return false;
+}
+
+#endif /* CONFIG_LRU_GEN */
+
 /*
  * This is a basic per-zone page freer.  Used by both kswapd and direct reclaim.
  */
@@ -1958,6 +2728,9 @@ static void shrink_lruvec(struct lruvec *lruvec, struct scan_control *sc)
 	unsigned long nr_to_reclaim = sc->nr_to_reclaim;
 	struct blk_plug plug;
 
+	if (lru_gen_shrink_lruvec(lruvec, sc))
+		return;
+
 	get_scan_count(lruvec, sc, nr);
 
 	blk_start_plug(&plug);
@@ -2657,7 +3430,8 @@ static void age_active_anon(struct zone *zone, struct scan_control *sc)
 	do {
 		struct lruvec *lruvec = mem_cgroup_zone_lruvec(zone, memcg);
 
-		if (inactive_anon_is_low(lruvec))
+		if (!lru_gen_lruvec_enabled(lruvec) &&
+		    inactive_anon_is_low(lruvec))
 			shrink_active_list(SWAP_CLUSTER_MAX, lruvec,
 					   sc, LRU_ACTIVE_ANON);
 
@@ -3294,6 +4068,22 @@ unsigned long shrink_all_memory(unsigned long nr_to_reclaim)
 }
 #endif /* CONFIG_HIBERNATION */
 
+/*
+ * Number of kswapd threads per node. They share the node's wait queue and
+ * all run balance_pgdat(); isolation from the LRU lists is done in small
+ * batches and the memcg iterator hands each reclaimer a different group,
+ * so the scanning work spreads over the threads.
+ *
+ * The threads also share the node's kswapd_max_order and classzone_idx:
+ * whichever thread wakes first takes the requested order, the others
+ * balance the node for order 0. Extra threads therefore only add order-0
+ * reclaim throughput, high-order requests are still served by one thread.
+ */
+int kswapd_threads = 1;
+
+/* serializes starting and stopping of the threads in pgdat->kswapd[] */
+static DEFINE_MUTEX(kswapd_threads_lock);
+
 /* It's optimal to keep kswapds on the same CPUs as their memory, but
    not required for correctness.  So if the last cpu in a node goes
    away, we get changed to run anywhere: as the first one comes back,
@@ -3304,55 +4094,113 @@ static int cpu_callback(struct notifier_block *nfb, unsigned long action,
 	int nid;
 
 	if (action == CPU_ONLINE || action == CPU_ONLINE_FROZEN) {
+		mutex_lock(&kswapd_threads_lock);
 		for_each_node_state(nid, N_MEMORY) {
 			pg_data_t *pgdat = NODE_DATA(nid);
 			const struct cpumask *mask;
+			int i;
 
 			mask = cpumask_of_node(pgdat->node_id);
 
-			if (cpumask_any_and(cpu_online_mask, mask) < nr_cpu_ids)
-				/* One of our CPUs online: restore mask */
-				set_cpus_allowed_ptr(pgdat->kswapd, mask);
+			if (cpumask_any_and(cpu_online_mask, mask) >= nr_cpu_ids)
+				continue;
+			/* One of our CPUs online: restore mask */
+			for (i = 0; i < MAX_KSWAPD_THREADS; i++)
+				if (pgdat->kswapd[i])
+					set_cpus_allowed_ptr(pgdat->kswapd[i],
+							     mask);
 		}
+		mutex_unlock(&kswapd_threads_lock);
 	}
 	return NOTIFY_OK;
 }
 
-/*
- * This kswapd start function will be called by init and node-hot-add.
- * On node-hot-add, kswapd will moved to proper cpus if cpus are hot-added.
- */
-int kswapd_run(int nid)
+/* start and stop threads of @nid to match kswapd_threads */
+static int kswapd_update_threads(int nid)
 {
 	pg_data_t *pgdat = NODE_DATA(nid);
-	int ret = 0;
+	int nr;
+	int i, ret = 0;
 
-	if (pgdat->kswapd)
-		return 0;
+	mutex_lock(&kswapd_threads_lock);
+	nr = kswapd_threads;
+	for (i = 0; i < nr; i++) {
+		struct task_struct *tsk;
 
-	pgdat->kswapd = kthread_run(kswapd, pgdat, "kswapd%d", nid);
-	if (IS_ERR(pgdat->kswapd)) {
-		/* failure at boot is fatal */
-		BUG_ON(system_state == SYSTEM_BOOTING);
-		pr_err("Failed to start kswapd on node %d\n", nid);
-		ret = PTR_ERR(pgdat->kswapd);
-		pgdat->kswapd = NULL;
+		if (pgdat->kswapd[i])
+			continue;
+		/* the first thread keeps the name tools expect */
+		if (i)
+			tsk = kthread_run(kswapd, pgdat, "kswapd%d:%d", nid, i);
+		else
+			tsk = kthread_run(kswapd, pgdat, "kswapd%d", nid);
+		if (IS_ERR(tsk)) {
+			/* failure at boot is fatal */
+			BUG_ON(system_state == SYSTEM_BOOTING);
+			pr_err("Failed to start kswapd%d:%d\n", nid, i);
+			ret = PTR_ERR(tsk);
+			break;
+		}
+		pgdat->kswapd[i] = tsk;
+	}
+	for (i = nr; i < MAX_KSWAPD_THREADS; i++) {
+		if (!pgdat->kswapd[i])
+			continue;
+		kthread_stop(pgdat->kswapd[i]);
+		pgdat->kswapd[i] = NULL;
 	}
+	mutex_unlock(&kswapd_threads_lock);
 	return ret;
 }
 
+/*
+ * This kswapd start function will be called by init and node-hot-add.
+ * On node-hot-add, kswapd will moved to proper cpus if cpus are hot-added.
+ */
+int kswapd_run(int nid)
+{
+	return kswapd_update_threads(nid);
+}
+
 /*
  * Called by memory hotplug when all memory in a node is offlined.  Caller must
  * hold lock_memory_hotplug().
  */
 void kswapd_stop(int nid)
 {
-	struct task_struct *kswapd = NODE_DATA(nid)->kswapd;
+	pg_data_t *pgdat = NODE_DATA(nid);
+	int i;
+
+	mutex_lock(&kswapd_threads_lock);
+	for (i = 0; i < MAX_KSWAPD_THREADS; i++) {
+		if (pgdat->kswapd[i]) {
+			kthread_stop(pgdat->kswapd[i]);
+			pgdat->kswapd[i] = NULL;
+		}
+	}
+	mutex_unlock(&kswapd_threads_lock);
+}
 
-	if (kswapd) {
-		kthread_stop(kswapd);
-		NODE_DATA(nid)->kswapd = NULL;
+int kswapd_threads_sysctl_handler(ctl_table *table, int write,
+				  void __user *buffer, size_t *length,
+				  loff_t *ppos)
+{
+	int old = kswapd_threads;
+	int nid, ret;
+
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (ret || !write || kswapd_threads == old)
+		return ret;
+
+	/* keeps the set of nodes stable, the threads have their own lock */
+	lock_memory_hotplug();
+	for_each_node_state(nid, N_MEMORY) {
+		ret = kswapd_update_threads(nid);
+		if (ret)
+			break;
 	}
+	unlock_memory_hotplug();
+	return ret;
 }
 
 static int __init kswapd_init(void)
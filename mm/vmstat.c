@@ -740,6 +740,8 @@ const char * const vmstat_text[] = {
 	"numa_local",
 	"numa_other",
 #endif
+	"workingset_refault",
+	"workingset_activate",
 	"nr_anon_transparent_hugepages",
 	"nr_free_cma",
 #if defined(CONFIG_CMA_PAGE_COUNTING)
@@ -776,6 +778,18 @@ const char * const vmstat_text[] = {
 
 #ifdef CONFIG_NUMA
 	"zone_reclaim_failed",
+#endif
+#ifdef CONFIG_PROCESS_RECLAIM
+	"pgscan_process",
+	"pgsteal_process",
+#endif
+#ifdef CONFIG_LRU_GEN
+	"lru_gen_aging",
+	"lru_gen_walk_pte",
+	"lru_gen_walk_young",
+	"lru_gen_evict_anon",
+	"lru_gen_evict_file",
+	"lru_gen_protected",
 #endif
 	"pginodesteal",
 	"slabs_scanned",
@@ -805,6 +819,9 @@ const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_daemon_wake",
+	"compact_proactive",
+	"compact_proactive_success",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -828,6 +845,20 @@ const char * const vmstat_text[] = {
 	"thp_zero_page_alloc",
 	"thp_zero_page_alloc_failed",
 #endif
+#ifdef CONFIG_SWAP
+	"swap_ra",
+	"swap_ra_hit",
+#endif
+	"vmap_purge",
+	"vmap_purge_pages",
+	"vmap_purge_flush",
+	"vmap_purge_flush_ranged",
+	"vmap_purge_flush_pages",
+	"vmap_cache_hit",
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	"speculative_pgfault",
+	"speculative_pgfault_abort",
+#endif
 
 #endif /* CONFIG_VM_EVENTS_COUNTERS */
 };
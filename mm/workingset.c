@@ -0,0 +1,272 @@
+/*
+ * Workingset detection
+ *
+ * Per zone, the file LRU is split into an inactive and an active list.
+ * Faulted pages start out inactive and get promoted on a second access;
+ * reclaim takes pages from the tail of the inactive list and deactivates
+ * active pages to keep it from shrinking below the active list.  A page
+ * used twice in short succession is protected, one used once is not.
+ *
+ * The weakness is that a page accessed again only after it has been
+ * evicted looks exactly like one that is never used again: when the
+ * frequently used set is bigger than the inactive list but smaller than
+ * memory, it thrashes through the inactive list while the active list
+ * keeps protecting pages that may be long out of use.
+ *
+ * To catch this, every eviction leaves a shadow entry behind in the page
+ * cache slot of the page, recording the zone's inactive_age: a counter
+ * bumped on every eviction and every activation, i.e. on every page that
+ * leaves the inactive list.  When the page is faulted back in, the
+ * difference between the current counter and the one in its shadow is
+ * the refault distance: the number of pages that went through the
+ * inactive list while the page was out, which is the minimum number of
+ * additional inactive slots it would have needed to stay resident.
+ *
+ * Those slots can only come from the active list.  So if the refault
+ * distance is no larger than the active list, the page is activated
+ * right away and competes with the active pages for residency, which
+ * lets a new working set push out a stale one.  The active pages it
+ * displaces are deactivated as usual and get their own chance on the
+ * inactive list.
+ *
+ * Shadow entries are removed when their slot is refaulted or truncated,
+ * and when the inode is evicted; see truncate_inode_pages_final().
+ *
+ * Long-lived mappings, such as the block device mapping or files that
+ * stay open, would otherwise collect shadows and the radix tree nodes
+ * holding them without bound.  A shadow older than the number of file
+ * pages on the LRU has a refault distance no active list can match, so
+ * whenever there are more shadows than that, a shrinker prunes the
+ * surplus.  Mappings holding shadows sit on a list in the order they
+ * got their first one; the shrinker takes them from the head, drops a
+ * batch of shadows from where it left off in each, and rotates them to
+ * the tail.
+ */
+
+#include <linux/atomic.h>
+#include <linux/fs.h>
+#include <linux/init.h>
+#include <linux/mm.h>
+#include <linux/mm_inline.h>
+#include <linux/mmzone.h>
+#include <linux/pagemap.h>
+#include <linux/pagevec.h>
+#include <linux/shrinker.h>
+#include <linux/spinlock.h>
+#include <linux/swap.h>
+#include <linux/vmstat.h>
+
+/*
+ * Mappings with shadow entries.  Nests inside mapping->tree_lock; the
+ * shrinker, which takes it first, only trylocks the tree_lock.
+ */
+static DEFINE_SPINLOCK(shadow_mappings_lock);
+static LIST_HEAD(shadow_mappings);
+static atomic_long_t nr_shadows;
+
+static void *pack_shadow(unsigned long eviction, struct zone *zone)
+{
+	eviction = (eviction << NODES_SHIFT) | zone_to_nid(zone);
+	eviction = (eviction << ZONES_SHIFT) | zone_idx(zone);
+	eviction = (eviction << RADIX_TREE_EXCEPTIONAL_SHIFT);
+
+	return (void *)(eviction | RADIX_TREE_EXCEPTIONAL_ENTRY);
+}
+
+static void unpack_shadow(void *shadow, struct zone **zone,
+			  unsigned long *distance)
+{
+	unsigned long entry = (unsigned long)shadow;
+	unsigned long eviction;
+	unsigned long refault;
+	unsigned long mask;
+	int zid, nid;
+
+	entry >>= RADIX_TREE_EXCEPTIONAL_SHIFT;
+	zid = entry & ((1UL << ZONES_SHIFT) - 1);
+	entry >>= ZONES_SHIFT;
+	nid = entry & ((1UL << NODES_SHIFT) - 1);
+	entry >>= NODES_SHIFT;
+	eviction = entry;
+
+	*zone = NODE_DATA(nid)->node_zones + zid;
+
+	refault = atomic_long_read(&(*zone)->inactive_age);
+	mask = ~0UL >> (NODES_SHIFT + ZONES_SHIFT +
+			RADIX_TREE_EXCEPTIONAL_SHIFT);
+	/*
+	 * The counter in the shadow is truncated to the bits left over,
+	 * so the unsigned subtraction gives the right distance across a
+	 * wrap of inactive_age as long as the page was out for less than
+	 * a full cycle of the truncated counter.  A page that stayed out
+	 * longer may look like a recent eviction and get activated once
+	 * for nothing; that is cheap enough not to bother.
+	 */
+	*distance = (refault - eviction) & mask;
+}
+
+/**
+ * workingset_eviction - note the eviction of a page from memory
+ * @mapping: address space the page was backing
+ * @page: the page being evicted
+ *
+ * Returns a shadow entry to be stored in @mapping->page_tree in place
+ * of the evicted @page so that a later refault can be detected.
+ */
+void *workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	unsigned long eviction;
+
+	eviction = atomic_long_inc_return(&zone->inactive_age);
+	return pack_shadow(eviction, zone);
+}
+
+/**
+ * workingset_refault - evaluate the refault of a previously evicted page
+ * @shadow: shadow entry of the evicted page
+ *
+ * Calculates and evaluates the refault distance of the previously
+ * evicted page in the context of the zone it was allocated in.
+ *
+ * Returns %true if the page should be activated, %false otherwise.
+ */
+bool workingset_refault(void *shadow)
+{
+	unsigned long refault_distance;
+	struct zone *zone;
+
+	unpack_shadow(shadow, &zone, &refault_distance);
+	inc_zone_state(zone, WORKINGSET_REFAULT);
+
+	if (refault_distance <= zone_page_state(zone, NR_ACTIVE_FILE)) {
+		inc_zone_state(zone, WORKINGSET_ACTIVATE);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * workingset_activation - note a page activation
+ * @page: page that is being activated
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_long_inc(&page_zone(page)->inactive_age);
+}
+
+/**
+ * workingset_shadow_added - account a shadow entry stored in @mapping
+ * @mapping: address space whose nrshadows was just incremented
+ *
+ * Must be called with @mapping->tree_lock held.
+ */
+void workingset_shadow_added(struct address_space *mapping)
+{
+	atomic_long_inc(&nr_shadows);
+	if (mapping->nrshadows == 1) {
+		spin_lock(&shadow_mappings_lock);
+		list_add_tail(&mapping->shadow_list, &shadow_mappings);
+		spin_unlock(&shadow_mappings_lock);
+	}
+}
+
+/**
+ * workingset_shadow_removed - account a shadow entry gone from @mapping
+ * @mapping: address space whose nrshadows was just decremented
+ *
+ * Must be called with @mapping->tree_lock held.
+ */
+void workingset_shadow_removed(struct address_space *mapping)
+{
+	atomic_long_dec(&nr_shadows);
+	if (!mapping->nrshadows) {
+		spin_lock(&shadow_mappings_lock);
+		list_del_init(&mapping->shadow_list);
+		spin_unlock(&shadow_mappings_lock);
+	}
+}
+
+/*
+ * Drops the shadows among the next PAGEVEC_SIZE entries of @mapping,
+ * under its tree_lock, and returns the number of entries looked at.
+ */
+static unsigned long prune_mapping_shadows(struct address_space *mapping)
+{
+	void **slots[PAGEVEC_SIZE];
+	unsigned long indices[PAGEVEC_SIZE];
+	unsigned int i, n, nr = 0;
+
+	n = radix_tree_gang_lookup_slot(&mapping->page_tree, slots, indices,
+					mapping->shadow_index, PAGEVEC_SIZE);
+	if (!n) {
+		/* start over from the beginning on the next visit */
+		mapping->shadow_index = 0;
+		return 1;
+	}
+	mapping->shadow_index = indices[n - 1] + 1;
+
+	/* deleting may free nodes the other slots are in, so look first */
+	for (i = 0; i < n; i++) {
+		void *entry = radix_tree_deref_slot_protected(slots[i],
+						&mapping->tree_lock);
+
+		if (radix_tree_exceptional_entry(entry))
+			indices[nr++] = indices[i];
+	}
+	for (i = 0; i < nr; i++)
+		radix_tree_delete(&mapping->page_tree, indices[i]);
+
+	mapping->nrshadows -= nr;
+	atomic_long_sub(nr, &nr_shadows);
+	if (!mapping->nrshadows)
+		list_del_init(&mapping->shadow_list);
+	return n;
+}
+
+static long shadow_surplus(void)
+{
+	long lru = global_page_state(NR_ACTIVE_FILE) +
+		   global_page_state(NR_INACTIVE_FILE);
+
+	return max(atomic_long_read(&nr_shadows) - lru, 0L);
+}
+
+static int shrink_shadows(struct shrinker *shrink, struct shrink_control *sc)
+{
+	unsigned long nr_to_scan = sc->nr_to_scan;
+	struct address_space *mapping;
+
+	if (!nr_to_scan)
+		return min_t(long, shadow_surplus(), INT_MAX);
+
+	spin_lock_irq(&shadow_mappings_lock);
+	while (nr_to_scan && shadow_surplus() &&
+	       !list_empty(&shadow_mappings)) {
+		unsigned long scanned = 1;
+
+		mapping = list_first_entry(&shadow_mappings,
+					   struct address_space, shadow_list);
+		list_move_tail(&mapping->shadow_list, &shadow_mappings);
+		if (spin_trylock(&mapping->tree_lock)) {
+			scanned = prune_mapping_shadows(mapping);
+			spin_unlock(&mapping->tree_lock);
+		}
+		nr_to_scan -= min(scanned, nr_to_scan);
+	}
+	spin_unlock_irq(&shadow_mappings_lock);
+
+	return min_t(long, shadow_surplus(), INT_MAX);
+}
+
+static struct shrinker shadow_shrinker = {
+	.shrink = shrink_shadows,
+	.seeks = DEFAULT_SEEKS,
+};
+
+static int __init workingset_init(void)
+{
+	register_shrinker(&shadow_shrinker);
+	return 0;
+}
+module_init(workingset_init);
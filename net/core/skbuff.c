@@ -40,6 +40,7 @@
 
 #include <linux/module.h>
 #include <linux/types.h>
+#include <linux/cpu.h>
 #include <linux/kernel.h>
 #include <linux/kmemcheck.h>
 #include <linux/mm.h>
@@ -279,6 +280,85 @@ nodata:
 }
 EXPORT_SYMBOL(__alloc_skb);
 
+/*
+ * Per-cpu cache of skb heads. build_skb() runs for every received frame,
+ * usually from NAPI poll in softirq context, and a good share of skbs is
+ * freed from softirq context too (tx completion, GRO merges, drops).
+ * There the cache is refilled and drained with the slab bulk API, so the
+ * slab fast path is paid once per batch instead of once per packet.
+ */
+#define SKB_HEAD_CACHE_SIZE	64
+#define SKB_HEAD_CACHE_BULK	16
+
+struct skb_head_cache {
+	unsigned int	count;
+	void		*heads[SKB_HEAD_CACHE_SIZE];
+};
+static DEFINE_PER_CPU(struct skb_head_cache, skb_head_cache);
+
+/* softirq context with interrupts enabled, as the bulk API requires */
+static inline bool skb_head_cache_usable(void)
+{
+	return in_serving_softirq() && !in_irq() && !irqs_disabled();
+}
+
+static struct sk_buff *skb_head_alloc(void)
+{
+	struct skb_head_cache *nc;
+
+	if (!skb_head_cache_usable())
+		return kmem_cache_alloc(skbuff_head_cache, GFP_ATOMIC);
+
+	nc = &__get_cpu_var(skb_head_cache);
+	if (unlikely(!nc->count)) {
+		nc->count = kmem_cache_alloc_bulk(skbuff_head_cache,
+						  GFP_ATOMIC,
+						  SKB_HEAD_CACHE_BULK,
+						  nc->heads);
+		if (unlikely(!nc->count))
+			return NULL;
+	}
+	return nc->heads[--nc->count];
+}
+
+static void skb_head_free(struct sk_buff *skb)
+{
+	struct skb_head_cache *nc;
+
+	if (!skb_head_cache_usable()) {
+		kmem_cache_free(skbuff_head_cache, skb);
+		return;
+	}
+
+	nc = &__get_cpu_var(skb_head_cache);
+	if (unlikely(nc->count == SKB_HEAD_CACHE_SIZE)) {
+		/* keep the most recently freed, cache hot half */
+		kmem_cache_free_bulk(skbuff_head_cache,
+				     SKB_HEAD_CACHE_SIZE / 2, nc->heads);
+		memmove(nc->heads, nc->heads + SKB_HEAD_CACHE_SIZE / 2,
+			SKB_HEAD_CACHE_SIZE / 2 * sizeof(nc->heads[0]));
+		nc->count = SKB_HEAD_CACHE_SIZE / 2;
+	}
+	nc->heads[nc->count++] = skb;
+}
+
+/* the cache of a dead cpu is no longer reachable, give its heads back */
+static int skb_head_cache_callback(struct notifier_block *nfb,
+				   unsigned long action, void *hcpu)
+{
+	struct skb_head_cache *nc;
+
+	if (action != CPU_DEAD && action != CPU_DEAD_FROZEN)
+		return NOTIFY_OK;
+
+	nc = &per_cpu(skb_head_cache, (unsigned long)hcpu);
+	if (nc->count) {
+		kmem_cache_free_bulk(skbuff_head_cache, nc->count, nc->heads);
+		nc->count = 0;
+	}
+	return NOTIFY_OK;
+}
+
 /**
  * build_skb - build a network buffer
  * @data: data buffer provided by caller
@@ -302,7 +382,7 @@ struct sk_buff *build_skb(void *data, unsigned int frag_size)
 	struct sk_buff *skb;
 	unsigned int size = frag_size ? : ksize(data);
 
-	skb = kmem_cache_alloc(skbuff_head_cache, GFP_ATOMIC);
+	skb = skb_head_alloc();
 	if (!skb)
 		return NULL;
 
@@ -520,7 +600,7 @@ static void kfree_skbmem(struct sk_buff *skb)
 
 	switch (skb->fclone) {
 	case SKB_FCLONE_UNAVAILABLE:
-		kmem_cache_free(skbuff_head_cache, skb);
+		skb_head_free(skb);
 		break;
 
 	case SKB_FCLONE_ORIG:
@@ -712,6 +792,10 @@ static void __copy_skb_header(struct sk_buff *new, const struct sk_buff *old)
 	new->vlan_tci		= old->vlan_tci;
 
 	skb_copy_secmark(new, old);
+
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	new->napi_id	= old->napi_id;
+#endif
 }
 
 /*
@@ -3068,6 +3152,7 @@ void __init skb_init(void)
 						0,
 						SLAB_HWCACHE_ALIGN|SLAB_PANIC,
 						NULL);
+	hotcpu_notifier(skb_head_cache_callback, 0);
 }
 
 /**
@@ -3390,7 +3475,7 @@ void kfree_skb_partial(struct sk_buff *skb, bool head_stolen)
 {
 	if (head_stolen) {
 		skb_release_head_state(skb);
-		kmem_cache_free(skbuff_head_cache, skb);
+		skb_head_free(skb);
 	} else {
 		__kfree_skb(skb);
 	}
@@ -0,0 +1,296 @@
+/*
+ * Wakeup-aware receive batching
+ *
+ * Every frame that reaches the host while the screen is off normally
+ * costs a resume plus a wakeup source hold long enough for userspace to
+ * read it. Participating drivers hand such frames to net_wake_batch_rx()
+ * instead of netif_rx(). Frames below net.core.wake_batch_prio are parked
+ * and the driver is told not to keep the system awake for them; the
+ * parked frames of all devices are delivered together when the
+ * net.core.wake_batch_ms window expires (an ALARM_BOOTTIME alarm, so it
+ * also fires from suspend), when a device parks net.core.wake_batch_pkts
+ * frames, when a high priority frame arrives or when the screen comes
+ * back on.
+ *
+ * The first frame delivered for each wakeup while the screen is off is
+ * tagged so that the socket it is charged to can be reported through
+ * wakeup_reason, giving a per-UID count of who is waking the device.
+ * Frames that follow while the system is still held up for it did not
+ * wake anything and are not tagged.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/alarmtimer.h>
+#include <linux/init.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/netdevice.h>
+#include <linux/pkt_sched.h>
+#include <linux/pm_wakeup.h>
+#include <linux/powersuspend.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/skbuff.h>
+#include <linux/suspend.h>
+#include <linux/wakeup_reason.h>
+#include <linux/workqueue.h>
+#include <net/net_namespace.h>
+#include <net/sock.h>
+#include <net/wake_batch.h>
+
+/* how long a flushed batch keeps the system up for its receivers */
+#define NWB_HOLD_MS	500
+
+unsigned int sysctl_net_wake_batch_ms __read_mostly;
+unsigned int sysctl_net_wake_batch_pkts __read_mostly = 64;
+unsigned int sysctl_net_wake_batch_prio __read_mostly = TC_PRIO_INTERACTIVE;
+
+static bool nwb_screen_off;
+static unsigned long nwb_armed;
+static unsigned long nwb_tag_until = INITIAL_JIFFIES;
+static struct alarm nwb_alarm;
+static struct wakeup_source *nwb_ws;
+static LIST_HEAD(nwb_list);
+static DEFINE_MUTEX(nwb_mutex);
+
+static void nwb_deliver(struct sk_buff *skb)
+{
+	if (in_interrupt())
+		netif_rx(skb);
+	else
+		netif_rx_ni(skb);
+}
+
+/*
+ * Claims the current wakeup for one frame, unless a frame delivered less
+ * than NWB_HOLD_MS ago already has it. A resume starts a new wakeup.
+ */
+static bool nwb_claim_wakeup(void)
+{
+	unsigned long until = ACCESS_ONCE(nwb_tag_until);
+	unsigned long next = jiffies + msecs_to_jiffies(NWB_HOLD_MS);
+
+	if (time_before(jiffies, until))
+		return false;
+	return cmpxchg(&nwb_tag_until, until, next) == until;
+}
+
+/* tags the first frame delivered if @tag, returns @tag if none was */
+static bool nwb_flush_one(struct net_wake_batch *wb, bool tag)
+{
+	struct sk_buff_head list;
+	struct sk_buff *skb;
+	unsigned long flags;
+
+	__skb_queue_head_init(&list);
+	spin_lock_irqsave(&wb->queue.lock, flags);
+	if (!skb_queue_empty(&wb->queue)) {
+		skb_queue_splice_init(&wb->queue, &list);
+		wb->flushes++;
+	}
+	spin_unlock_irqrestore(&wb->queue.lock, flags);
+
+	while ((skb = __skb_dequeue(&list)) != NULL) {
+		skb->wake_batch = tag;
+		tag = false;
+		nwb_deliver(skb);
+	}
+	return tag;
+}
+
+static void nwb_flush_workfn(struct work_struct *work)
+{
+	struct net_wake_batch *wb;
+	/* with the screen off, the window alarm may have woken the system */
+	bool tag = ACCESS_ONCE(nwb_screen_off) && nwb_claim_wakeup();
+
+	/* frames parked from here on arm a new window */
+	clear_bit(0, &nwb_armed);
+	smp_mb__after_clear_bit();
+
+	mutex_lock(&nwb_mutex);
+	list_for_each_entry(wb, &nwb_list, list)
+		tag = nwb_flush_one(wb, tag);
+	mutex_unlock(&nwb_mutex);
+
+	__pm_wakeup_event(nwb_ws, NWB_HOLD_MS);
+}
+
+static DECLARE_WORK(nwb_flush_work, nwb_flush_workfn);
+
+static enum alarmtimer_restart nwb_alarm_fn(struct alarm *alarm, ktime_t now)
+{
+	/* hold the system up until the flush work has run */
+	__pm_stay_awake(nwb_ws);
+	schedule_work(&nwb_flush_work);
+	return ALARMTIMER_NORESTART;
+}
+
+/**
+ * net_wake_batch_rx - hand a received frame to the stack, maybe later
+ * @wb: the device's batching state
+ * @skb: the frame, with protocol and priority already set
+ *
+ * Must be used instead of netif_rx()/netif_rx_ni() by drivers taking part
+ * in batching. Returns true if @skb (and anything parked before it) was
+ * delivered now, in which case the driver should keep the system awake
+ * for it as usual; false if it was parked and the driver should let the
+ * system go back to sleep.
+ */
+bool net_wake_batch_rx(struct net_wake_batch *wb, struct sk_buff *skb)
+{
+	unsigned int window = ACCESS_ONCE(sysctl_net_wake_batch_ms);
+	bool screen_off = ACCESS_ONCE(nwb_screen_off);
+	unsigned long flags;
+	bool full, tag;
+
+	if (!window || !screen_off ||
+	    skb->priority >= ACCESS_ONCE(sysctl_net_wake_batch_prio)) {
+		tag = screen_off && nwb_claim_wakeup();
+		/* keep ordering with anything already parked */
+		if (!skb_queue_empty(&wb->queue))
+			tag = nwb_flush_one(wb, tag);
+		skb->wake_batch = tag;
+		wb->direct++;
+		nwb_deliver(skb);
+		return true;
+	}
+
+	skb->wake_batch = 0;
+	spin_lock_irqsave(&wb->queue.lock, flags);
+	__skb_queue_tail(&wb->queue, skb);
+	wb->queued++;
+	full = skb_queue_len(&wb->queue) >=
+	       ACCESS_ONCE(sysctl_net_wake_batch_pkts);
+	spin_unlock_irqrestore(&wb->queue.lock, flags);
+
+	if (full) {
+		nwb_flush_one(wb, nwb_claim_wakeup());
+		return true;
+	}
+
+	if (!test_and_set_bit(0, &nwb_armed))
+		alarm_start_relative(&nwb_alarm, ms_to_ktime(window));
+	return false;
+}
+EXPORT_SYMBOL_GPL(net_wake_batch_rx);
+
+void __net_wake_batch_attribute(struct sock *sk, struct sk_buff *skb)
+{
+	struct net_device *dev;
+
+	skb->wake_batch = 0;
+
+	rcu_read_lock();
+	dev = dev_get_by_index_rcu(sock_net(sk), skb->skb_iif);
+	log_wakeup_reason_uid(dev ? dev->name : "net", sock_i_uid(sk));
+	rcu_read_unlock();
+}
+EXPORT_SYMBOL(__net_wake_batch_attribute);
+
+void net_wake_batch_register(struct net_wake_batch *wb, struct net_device *dev)
+{
+	skb_queue_head_init(&wb->queue);
+	wb->dev = dev;
+	wb->queued = 0;
+	wb->direct = 0;
+	wb->flushes = 0;
+
+	mutex_lock(&nwb_mutex);
+	list_add_tail(&wb->list, &nwb_list);
+	mutex_unlock(&nwb_mutex);
+}
+EXPORT_SYMBOL_GPL(net_wake_batch_register);
+
+/* drops anything still parked; the driver must have stopped its rx path */
+void net_wake_batch_unregister(struct net_wake_batch *wb)
+{
+	mutex_lock(&nwb_mutex);
+	list_del(&wb->list);
+	mutex_unlock(&nwb_mutex);
+
+	skb_queue_purge(&wb->queue);
+}
+EXPORT_SYMBOL_GPL(net_wake_batch_unregister);
+
+static void nwb_power_suspend(struct power_suspend *h)
+{
+	ACCESS_ONCE(nwb_screen_off) = true;
+}
+
+static void nwb_power_resume(struct power_suspend *h)
+{
+	ACCESS_ONCE(nwb_screen_off) = false;
+	alarm_try_to_cancel(&nwb_alarm);
+	schedule_work(&nwb_flush_work);
+}
+
+static int nwb_pm_notify(struct notifier_block *nb, unsigned long event,
+			 void *unused)
+{
+	/* whatever arrives first after a resume is what woke the system */
+	if (event == PM_POST_SUSPEND)
+		ACCESS_ONCE(nwb_tag_until) = jiffies;
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block nwb_pm_nb = {
+	.notifier_call = nwb_pm_notify,
+};
+
+static struct power_suspend nwb_power_handler = {
+	.name = "net_wake_batch",
+	.parallel = true,
+	.suspend = nwb_power_suspend,
+	.resume = nwb_power_resume,
+};
+
+#ifdef CONFIG_PROC_FS
+static int nwb_seq_show(struct seq_file *seq, void *v)
+{
+	struct net_wake_batch *wb;
+
+	seq_printf(seq, "%-16s %10s %10s %10s %8s\n", "device", "queued",
+		   "direct", "flushes", "backlog");
+	mutex_lock(&nwb_mutex);
+	list_for_each_entry(wb, &nwb_list, list)
+		seq_printf(seq, "%-16s %10lu %10lu %10lu %8u\n",
+			   wb->dev->name, wb->queued, wb->direct,
+			   wb->flushes, skb_queue_len(&wb->queue));
+	mutex_unlock(&nwb_mutex);
+	return 0;
+}
+
+static int nwb_seq_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nwb_seq_show, NULL);
+}
+
+static const struct file_operations nwb_seq_fops = {
+	.owner		= THIS_MODULE,
+	.open		= nwb_seq_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
+static int __init net_wake_batch_init(void)
+{
+	nwb_ws = wakeup_source_register("net_wake_batch");
+	if (!nwb_ws)
+		return -ENOMEM;
+
+	alarm_init(&nwb_alarm, ALARM_BOOTTIME, nwb_alarm_fn);
+	register_power_suspend(&nwb_power_handler);
+	register_pm_notifier(&nwb_pm_nb);
+#ifdef CONFIG_PROC_FS
+	proc_create("wake_batch", S_IRUGO, init_net.proc_net, &nwb_seq_fops);
+#endif
+	return 0;
+}
+subsys_initcall(net_wake_batch_init);
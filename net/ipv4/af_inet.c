@@ -1302,7 +1302,7 @@ static struct sk_buff *inet_gso_segment(struct sk_buff *skb,
 	int ihl;
 	int id;
 	unsigned int offset = 0;
-	bool tunnel;
+	bool tunnel, udpfrag;
 
 	if (unlikely(skb_shinfo(skb)->gso_type &
 		     ~(SKB_GSO_TCPV4 |
@@ -1312,6 +1312,7 @@ static struct sk_buff *inet_gso_segment(struct sk_buff *skb,
 		       SKB_GSO_GRE |
 		       SKB_GSO_TCPV6 |
 		       SKB_GSO_UDP_TUNNEL |
+		       SKB_GSO_UDP_L4 |
 		       0)))
 		goto out;
 
@@ -1327,6 +1328,7 @@ static struct sk_buff *inet_gso_segment(struct sk_buff *skb,
 		goto out;
 
 	tunnel = !!skb->encapsulation;
+	udpfrag = !tunnel && !(skb_shinfo(skb)->gso_type & SKB_GSO_UDP_L4);
 
 	__skb_pull(skb, ihl);
 	skb_reset_transport_header(skb);
@@ -1347,7 +1349,7 @@ static struct sk_buff *inet_gso_segment(struct sk_buff *skb,
 	skb = segs;
 	do {
 		iph = ip_hdr(skb);
-		if (!tunnel && proto == IPPROTO_UDP) {
+		if (udpfrag && proto == IPPROTO_UDP) {
 			iph->id = htons(id);
 			iph->frag_off = htons(offset >> 3);
 			if (skb->next != NULL)
@@ -1594,6 +1596,8 @@ static const struct net_offload udp_offload = {
 	.callbacks = {
 		.gso_send_check = udp4_ufo_send_check,
 		.gso_segment = udp4_ufo_fragment,
+		.gro_receive = udp4_gro_receive,
+		.gro_complete = udp4_gro_complete,
 	},
 };
 
@@ -387,7 +387,7 @@ static unsigned int nattype_forward(struct sk_buff *skb,
 			 * found the entry.
 			 */
 			if (!nattype_refresh_timer((unsigned long)nte,
-					ct->timeout.expires))
+					jiffies + nf_ct_expires(ct)))
 				break;
 			/*
 			 * The entry is found and refreshed, the
@@ -462,9 +462,9 @@ static unsigned int nattype_forward(struct sk_buff *skb,
 		 * entry as this one is timed out and will be removed
 		 * from the list shortly.
 		 */
-		nte2->timeout_value = ct->timeout.expires - jiffies;
+		nte2->timeout_value = nf_ct_expires(ct);
 		if (!nattype_refresh_timer((unsigned long)nte2,
-				ct->timeout.expires))
+				jiffies + nte2->timeout_value))
 			break;
 		/*
 		 * Found and refreshed an existing entry.  Its values
@@ -480,8 +480,8 @@ static unsigned int nattype_forward(struct sk_buff *skb,
 	/*
 	 * Add the new entry to the list.
 	 */
-	nte->timeout_value = ct->timeout.expires - jiffies;
-	nte->timeout.expires = ct->timeout.expires;
+	nte->timeout_value = nf_ct_expires(ct);
+	nte->timeout.expires = jiffies + nte->timeout_value;
 	add_timer(&nte->timeout);
 	list_add(&nte->list, &nattype_list);
 	ct->nattype_entry = (unsigned long)nte;
@@ -503,7 +503,7 @@ static int nf_nat_proto_clean(struct nf_conn *ct, void *data)
 	 * Else, when the conntrack is destoyed, nf_nat_cleanup_conntrack()
 	 * will delete entry from already-freed table.
 	 */
-	if (!del_timer(&ct->timeout))
+	if (nf_ct_is_dying(ct))
 		return 1;
 
 	spin_lock_bh(&nf_nat_lock);
@@ -512,8 +512,6 @@ static int nf_nat_proto_clean(struct nf_conn *ct, void *data)
 	nat->ct = NULL;
 	spin_unlock_bh(&nf_nat_lock);
 
-	add_timer(&ct->timeout);
-
 	/* don't delete conntrack.  Although that would make things a lot
 	 * simpler, we'd end up flushing all conntracks on nat rmmod.
 	 */
@@ -0,0 +1,168 @@
+/*
+ * Short-lived TCP connection rate used by run_natbench to exercise
+ * conntrack insertion, confirmation and teardown through a NAT router.
+ *
+ * Usage: nat_connrate -s <port> <seconds>
+ *        nat_connrate -c <addr> <port> <seconds> <threads>
+ *
+ * The server accepts and immediately closes every connection. Each client
+ * thread connects, reads the EOF and closes, in a loop, using SO_LINGER
+ * with a zero timeout so that no socket is left in TIME_WAIT and the
+ * source port space is not exhausted. The client prints connections/s.
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define MAX_THREADS	64
+
+static struct sockaddr_in dst;
+static double deadline;
+static unsigned long conns[MAX_THREADS];
+static unsigned long fails[MAX_THREADS];
+
+static double now_sec(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int do_server(int port, int secs)
+{
+	struct sockaddr_in addr;
+	struct timeval tv = { .tv_sec = 1 };
+	unsigned long accepted = 0;
+	double end;
+	int fd, cfd, one = 1;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		return 1;
+	}
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		perror("bind");
+		return 1;
+	}
+	if (listen(fd, 1024)) {
+		perror("listen");
+		return 1;
+	}
+
+	end = now_sec() + secs;
+	while (now_sec() < end) {
+		cfd = accept(fd, NULL, NULL);
+		if (cfd < 0) {
+			if (errno == EAGAIN || errno == EINTR ||
+			    errno == ECONNABORTED)
+				continue;
+			perror("accept");
+			return 1;
+		}
+		close(cfd);
+		accepted++;
+	}
+
+	printf("server    %10lu accepted\n", accepted);
+	close(fd);
+	return 0;
+}
+
+static void *client_thread(void *arg)
+{
+	struct linger lin = { .l_onoff = 1, .l_linger = 0 };
+	long id = (long)arg;
+	char c;
+	int fd;
+
+	while (now_sec() < deadline) {
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd < 0) {
+			perror("socket");
+			break;
+		}
+		setsockopt(fd, SOL_SOCKET, SO_LINGER, &lin, sizeof(lin));
+		if (connect(fd, (struct sockaddr *)&dst, sizeof(dst))) {
+			fails[id]++;
+		} else {
+			/* Wait for the server side close. */
+			if (read(fd, &c, 1) >= 0)
+				conns[id]++;
+			else
+				fails[id]++;
+		}
+		close(fd);
+	}
+	return NULL;
+}
+
+static int do_client(const char *host, int port, int secs, int nthreads)
+{
+	pthread_t tids[MAX_THREADS];
+	unsigned long total = 0, failed = 0;
+	double start;
+	long i;
+
+	if (nthreads <= 0 || nthreads > MAX_THREADS) {
+		fprintf(stderr, "bad thread count %d\n", nthreads);
+		return 1;
+	}
+
+	memset(&dst, 0, sizeof(dst));
+	dst.sin_family = AF_INET;
+	dst.sin_port = htons(port);
+	if (inet_pton(AF_INET, host, &dst.sin_addr) != 1) {
+		fprintf(stderr, "bad address %s\n", host);
+		return 1;
+	}
+
+	start = now_sec();
+	deadline = start + secs;
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&tids[i], NULL, client_thread, (void *)i)) {
+			fprintf(stderr, "pthread_create failed\n");
+			return 1;
+		}
+	}
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(tids[i], NULL);
+		total += conns[i];
+		failed += fails[i];
+	}
+
+	printf("%2d thr    %10.0f conn/s %10lu failed\n", nthreads,
+	       total / (now_sec() - start), failed);
+	return total ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc == 4 && !strcmp(argv[1], "-s"))
+		return do_server(atoi(argv[2]), atoi(argv[3]));
+	if (argc == 6 && !strcmp(argv[1], "-c"))
+		return do_client(argv[2], atoi(argv[3]), atoi(argv[4]),
+				 atoi(argv[5]));
+
+	fprintf(stderr, "usage: %s -s <port> <seconds>\n"
+			"       %s -c <addr> <port> <seconds> <threads>\n",
+		argv[0], argv[0]);
+	return 1;
+}
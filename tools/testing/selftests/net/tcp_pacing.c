@@ -0,0 +1,128 @@
+/*
+ * Bulk TCP transfer used by run_bbrtests to compare congestion control
+ * modules and pacing setups (sch_fq or TCP internal pacing).
+ *
+ * Usage: tcp_pacing -s <port>
+ *        tcp_pacing -c <addr> <port> <cc> <seconds>
+ *
+ * The client prints one line: cc, goodput in Mbit/s, smoothed RTT in usec
+ * and the number of retransmitted segments.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define BUFLEN	(64 * 1024)
+
+static char buf[BUFLEN];
+
+static double now_sec(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int do_server(int port)
+{
+	struct sockaddr_in addr;
+	int fd, cfd, one = 1;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		return 1;
+	}
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    listen(fd, 8)) {
+		perror("bind/listen");
+		return 1;
+	}
+
+	for (;;) {
+		cfd = accept(fd, NULL, NULL);
+		if (cfd < 0) {
+			perror("accept");
+			return 1;
+		}
+		while (read(cfd, buf, sizeof(buf)) > 0)
+			;
+		close(cfd);
+	}
+	return 0;
+}
+
+static int do_client(const char *host, int port, const char *cc, int secs)
+{
+	struct sockaddr_in addr;
+	struct tcp_info info;
+	socklen_t len = sizeof(info);
+	unsigned long long bytes = 0;
+	double start, elapsed;
+	int fd;
+	ssize_t ret;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		return 1;
+	}
+	if (setsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, cc, strlen(cc))) {
+		perror("TCP_CONGESTION");
+		return 1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	if (inet_pton(AF_INET, host, &addr.sin_addr) != 1 ||
+	    connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		perror("connect");
+		return 1;
+	}
+
+	start = now_sec();
+	while ((elapsed = now_sec() - start) < secs) {
+		ret = write(fd, buf, sizeof(buf));
+		if (ret < 0) {
+			perror("write");
+			return 1;
+		}
+		bytes += ret;
+	}
+
+	if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len)) {
+		perror("TCP_INFO");
+		return 1;
+	}
+	printf("%-8s %10.2f Mbit/s  srtt %7u us  retrans %u\n", cc,
+	       bytes * 8 / elapsed / 1e6, info.tcpi_rtt,
+	       info.tcpi_total_retrans);
+	close(fd);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc == 3 && !strcmp(argv[1], "-s"))
+		return do_server(atoi(argv[2]));
+	if (argc == 6 && !strcmp(argv[1], "-c"))
+		return do_client(argv[2], atoi(argv[3]), argv[4], atoi(argv[5]));
+
+	fprintf(stderr, "usage: %s -s <port> | -c <addr> <port> <cc> <secs>\n",
+		argv[0]);
+	return 1;
+}
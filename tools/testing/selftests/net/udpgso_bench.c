@@ -0,0 +1,242 @@
+/*
+ * UDP send/receive throughput used by run_udpgsotests to compare the
+ * syscall batching interfaces with UDP segmentation offload and UDP GRO.
+ *
+ * Usage: udpgso_bench -s <port> <seconds> [gro]
+ *        udpgso_bench -c <addr> <port> <mode> <seconds> <size>
+ *
+ * Sender modes are "send" (one datagram per call), "sendmmsg" (a batch of
+ * datagrams per call) and "gso" (one UDP_SEGMENT buffer per call). The
+ * receiver uses recvmmsg() and, with "gro", also enables UDP_GRO.
+ * Both sides print one line: mode, datagrams/s, MB/s and syscalls/s.
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifndef SOL_UDP
+#define SOL_UDP		17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT	103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO		104
+#endif
+
+#define MAX_SEGS	64
+#define MAX_PAYLOAD	(65535 - 20 - 8)
+#define BATCH		64
+#define RCVLEN		(64 * 1024)
+
+static char sbuf[MAX_PAYLOAD];
+static char rbuf[BATCH][RCVLEN];
+
+static double now_sec(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void report(const char *mode, double secs, unsigned long dgrams,
+		   unsigned long bytes, unsigned long calls)
+{
+	printf("%-9s %10.0f dgram/s %9.1f MB/s %10.0f calls/s\n", mode,
+	       dgrams / secs, bytes / secs / 1e6, calls / secs);
+}
+
+static int do_server(int port, int secs, int gro)
+{
+	struct mmsghdr msgs[BATCH];
+	struct iovec iov[BATCH];
+	char ctrl[BATCH][CMSG_SPACE(sizeof(int))];
+	unsigned long dgrams = 0, bytes = 0, calls = 0;
+	struct sockaddr_in addr;
+	struct timeval tv = { .tv_sec = 1 };
+	double start, end;
+	int fd, i, n, one = 1;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		return 1;
+	}
+	if (gro && setsockopt(fd, SOL_UDP, UDP_GRO, &one, sizeof(one))) {
+		perror("setsockopt UDP_GRO");
+		return 1;
+	}
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		perror("bind");
+		return 1;
+	}
+
+	start = now_sec();
+	end = start + secs;
+	while (now_sec() < end) {
+		memset(msgs, 0, sizeof(msgs));
+		for (i = 0; i < BATCH; i++) {
+			iov[i].iov_base = rbuf[i];
+			iov[i].iov_len = RCVLEN;
+			msgs[i].msg_hdr.msg_iov = &iov[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_control = ctrl[i];
+			msgs[i].msg_hdr.msg_controllen = sizeof(ctrl[i]);
+		}
+
+		n = recvmmsg(fd, msgs, BATCH, MSG_WAITFORONE, NULL);
+		calls++;
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			perror("recvmmsg");
+			return 1;
+		}
+
+		for (i = 0; i < n; i++) {
+			struct msghdr *mh = &msgs[i].msg_hdr;
+			struct cmsghdr *cmsg;
+			int gso_size = 0;
+
+			bytes += msgs[i].msg_len;
+			for (cmsg = CMSG_FIRSTHDR(mh); cmsg;
+			     cmsg = CMSG_NXTHDR(mh, cmsg))
+				if (cmsg->cmsg_level == SOL_UDP &&
+				    cmsg->cmsg_type == UDP_GRO)
+					memcpy(&gso_size, CMSG_DATA(cmsg),
+					       sizeof(gso_size));
+
+			if (gso_size)
+				dgrams += (msgs[i].msg_len + gso_size - 1) /
+					  gso_size;
+			else
+				dgrams++;
+		}
+	}
+
+	report(gro ? "rx-gro" : "rx-mmsg", now_sec() - start, dgrams, bytes,
+	       calls);
+	close(fd);
+	return 0;
+}
+
+static int do_client(const char *host, int port, const char *mode, int secs,
+		     int size)
+{
+	struct mmsghdr msgs[BATCH];
+	struct iovec iov[BATCH];
+	unsigned long dgrams = 0, bytes = 0, calls = 0;
+	struct sockaddr_in addr;
+	double start, end;
+	int fd, i, n, segs, len;
+
+	if (size <= 0 || size > MAX_PAYLOAD) {
+		fprintf(stderr, "bad size %d\n", size);
+		return 1;
+	}
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		return 1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+		fprintf(stderr, "bad address %s\n", host);
+		return 1;
+	}
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		perror("connect");
+		return 1;
+	}
+
+	/* As many segments as fit in one 64K datagram. */
+	segs = MAX_PAYLOAD / size;
+	if (segs > MAX_SEGS)
+		segs = MAX_SEGS;
+	len = segs * size;
+
+	if (!strcmp(mode, "gso") &&
+	    setsockopt(fd, SOL_UDP, UDP_SEGMENT, &size, sizeof(size))) {
+		perror("setsockopt UDP_SEGMENT");
+		return 1;
+	}
+
+	memset(msgs, 0, sizeof(msgs));
+	for (i = 0; i < BATCH; i++) {
+		iov[i].iov_base = sbuf;
+		iov[i].iov_len = size;
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	start = now_sec();
+	end = start + secs;
+	while (now_sec() < end) {
+		if (!strcmp(mode, "send")) {
+			n = send(fd, sbuf, size, 0);
+			if (n > 0) {
+				dgrams++;
+				bytes += n;
+			}
+		} else if (!strcmp(mode, "sendmmsg")) {
+			n = sendmmsg(fd, msgs, segs, 0);
+			if (n > 0) {
+				dgrams += n;
+				bytes += (unsigned long)n * size;
+			}
+		} else if (!strcmp(mode, "gso")) {
+			n = send(fd, sbuf, len, 0);
+			if (n > 0) {
+				dgrams += segs;
+				bytes += n;
+			}
+		} else {
+			fprintf(stderr, "unknown mode %s\n", mode);
+			return 1;
+		}
+		calls++;
+
+		/* The receiver may not be up yet. */
+		if (n < 0 && errno != ECONNREFUSED && errno != ENOBUFS) {
+			perror(mode);
+			return 1;
+		}
+	}
+
+	report(mode, now_sec() - start, dgrams, bytes, calls);
+	close(fd);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc >= 4 && !strcmp(argv[1], "-s"))
+		return do_server(atoi(argv[2]), atoi(argv[3]),
+				 argc > 4 && !strcmp(argv[4], "gro"));
+	if (argc == 7 && !strcmp(argv[1], "-c"))
+		return do_client(argv[2], atoi(argv[3]), argv[4],
+				 atoi(argv[5]), atoi(argv[6]));
+
+	fprintf(stderr, "usage: %s -s <port> <seconds> [gro]\n"
+			"       %s -c <addr> <port> <send|sendmmsg|gso> "
+			"<seconds> <size>\n", argv[0], argv[0]);
+	return 1;
+}
@@ -0,0 +1,219 @@
+/*
+ * Reclaim microbenchmark for the multi-generational LRU.
+ *
+ * Usage: lru_gen_bench [-m <MB>] [-h <hot percent>] [-t <seconds>]
+ *
+ * Maps an anonymous region larger than memory (by default 5/4 of
+ * MemTotal, so swap is required) and keeps touching it: nine accesses out
+ * of ten go to random pages of a hot subset, the tenth continues a
+ * sequential sweep of the rest. A good reclaim policy keeps the hot pages
+ * resident and evicts the cold ones, so it shows up as more accesses per
+ * second and fewer major faults.
+ *
+ * When /sys/kernel/mm/lru_gen/enabled is writable the run is done once
+ * with the classic LRU and once with the multi-generational one, and the
+ * original setting is restored afterwards. The reclaim counters from
+ * /proc/vmstat are printed for every run.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define LRU_GEN_ENABLED	"/sys/kernel/mm/lru_gen/enabled"
+
+static const char *counters[] = {
+	"pgscan_kswapd", "pgscan_direct", "pgsteal_kswapd", "pgsteal_direct",
+	"pswpin", "pswpout", "lru_gen_aging", "lru_gen_walk_young",
+	"lru_gen_protected",
+};
+#define NR_COUNTERS	(sizeof(counters) / sizeof(counters[0]))
+
+static long page_size;
+
+static double now_sec(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static unsigned long meminfo_kb(const char *key)
+{
+	char line[256];
+	unsigned long val = 0;
+	size_t len = strlen(key);
+	FILE *f = fopen("/proc/meminfo", "r");
+
+	if (!f)
+		return 0;
+	while (fgets(line, sizeof(line), f)) {
+		if (!strncmp(line, key, len) && line[len] == ':') {
+			val = strtoul(line + len + 1, NULL, 10);
+			break;
+		}
+	}
+	fclose(f);
+	return val;
+}
+
+/* sums the per-zone counters sharing a prefix, e.g. pgscan_kswapd_normal */
+static void read_vmstat(unsigned long long *vals)
+{
+	char name[64];
+	unsigned long long val;
+	unsigned int i;
+	FILE *f = fopen("/proc/vmstat", "r");
+
+	memset(vals, 0, NR_COUNTERS * sizeof(*vals));
+	if (!f)
+		return;
+	while (fscanf(f, "%63s %llu", name, &val) == 2) {
+		for (i = 0; i < NR_COUNTERS; i++) {
+			size_t len = strlen(counters[i]);
+
+			if (!strncmp(name, counters[i], len) &&
+			    (name[len] == '\0' || name[len] == '_'))
+				vals[i] += val;
+		}
+	}
+	fclose(f);
+}
+
+static int read_lru_gen(void)
+{
+	FILE *f = fopen(LRU_GEN_ENABLED, "r");
+	int val = -1;
+
+	if (!f)
+		return -1;
+	if (fscanf(f, "%d", &val) != 1)
+		val = -1;
+	fclose(f);
+	return val;
+}
+
+static int write_lru_gen(int val)
+{
+	FILE *f = fopen(LRU_GEN_ENABLED, "w");
+
+	if (!f)
+		return -1;
+	fprintf(f, "%d\n", val);
+	return fclose(f);
+}
+
+static void run(unsigned long size_mb, int hot_pct, int secs, int lru_gen)
+{
+	unsigned long nr_pages = (size_mb << 20) / page_size;
+	unsigned long nr_hot = nr_pages * hot_pct / 100;
+	unsigned long long before[NR_COUNTERS], after[NR_COUNTERS];
+	unsigned long cold = nr_hot, accesses = 0;
+	struct rusage ru0, ru1;
+	double start, end;
+	unsigned int i, seed = 1;
+	char *buf;
+
+	buf = mmap(NULL, nr_pages * page_size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+
+	/* populate everything once, then measure the steady state */
+	for (i = 0; i < nr_pages; i++)
+		buf[(unsigned long)i * page_size] = 1;
+
+	read_vmstat(before);
+	getrusage(RUSAGE_SELF, &ru0);
+	start = now_sec();
+	end = start + secs;
+	while (now_sec() < end) {
+		for (i = 0; i < 1000; i++, accesses++) {
+			unsigned long idx;
+
+			if (accesses % 10) {
+				idx = rand_r(&seed) % nr_hot;
+			} else {
+				idx = cold++;
+				if (cold == nr_pages)
+					cold = nr_hot;
+			}
+			buf[idx * page_size]++;
+		}
+	}
+	end = now_sec();
+	getrusage(RUSAGE_SELF, &ru1);
+	read_vmstat(after);
+
+	printf("lru_gen %-3s %10.0f accesses/s %10ld majflt\n",
+	       lru_gen < 0 ? "n/a" : lru_gen ? "on" : "off",
+	       accesses / (end - start), ru1.ru_majflt - ru0.ru_majflt);
+	for (i = 0; i < NR_COUNTERS; i++)
+		printf("  %-20s %llu\n", counters[i], after[i] - before[i]);
+
+	munmap(buf, nr_pages * page_size);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long size_mb = 0;
+	int hot_pct = 25, secs = 10;
+	int opt, orig;
+
+	page_size = sysconf(_SC_PAGESIZE);
+
+	while ((opt = getopt(argc, argv, "m:h:t:")) != -1) {
+		switch (opt) {
+		case 'm':
+			size_mb = strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+			hot_pct = atoi(optarg);
+			break;
+		case 't':
+			secs = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-m <MB>] [-h <hot %%>] "
+				"[-t <seconds>]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (hot_pct <= 0 || hot_pct >= 100 || secs <= 0) {
+		fprintf(stderr, "bad hot percentage or duration\n");
+		return 1;
+	}
+
+	if (!size_mb) {
+		unsigned long mem_kb = meminfo_kb("MemTotal");
+
+		if (meminfo_kb("SwapTotal") < mem_kb / 2) {
+			printf("lru_gen_bench: needs swap of at least half "
+			       "of memory, skipping\n");
+			return 0;
+		}
+		size_mb = mem_kb * 5 / 4 / 1024;
+	}
+
+	orig = read_lru_gen();
+	if (orig < 0 || write_lru_gen(0)) {
+		/* no switch, just measure whatever the kernel does */
+		run(size_mb, hot_pct, secs, orig);
+		return 0;
+	}
+
+	run(size_mb, hot_pct, secs, 0);
+	write_lru_gen(1);
+	run(size_mb, hot_pct, secs, 1);
+	write_lru_gen(orig);
+	return 0;
+}